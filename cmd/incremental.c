@@ -0,0 +1,265 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) pappadf
+
+// incremental.c
+// Skipping unchanged archive members for the `peeler` CLI (`--incremental`).
+//
+// Every extraction leaves a manifest in its output directory: one line per
+// archive member with the fork lengths, stored checksums and Finder info the
+// catalog gave for it.  On the next run each member's catalog entry is
+// compared with its line before anything is decoded.  When they agree, and
+// the files on disk still have the sizes that member produces and are no
+// newer than the manifest, the member is skipped.  A re-run over an
+// unchanged archive therefore costs only the catalog walk.  A member with a
+// non-empty fork that has no stored checksum (0) is always extracted: its
+// length alone does not show that its contents are unchanged.
+//
+// The manifest is replaced only when a run writes every file it meant to;
+// after a failure it is removed, so the next run extracts everything.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "output.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+// ============================================================================
+// Constants and Macros
+// ============================================================================
+
+// Manifest file name within the output directory, and its first line
+#define MANIFEST_NAME  ".peeler-manifest"
+#define MANIFEST_MAGIC "peeler-manifest 1"
+
+// ============================================================================
+// Type Definitions (Private)
+// ============================================================================
+
+// One manifest line.
+typedef struct {
+    peel_entry_info_t info;
+    bool ambiguous; // The name occurs more than once; never skipped
+} manifest_entry_t;
+
+// A growable array of manifest lines.
+typedef struct {
+    manifest_entry_t *items;
+    size_t count;
+    size_t cap;
+} manifest_t;
+
+// Manifest of the previous run (sorted by name) and the one being built.
+struct incr_state {
+    char *dir;
+    bool xattrs;
+    time_t written; // When the previous manifest was written
+    manifest_t old;
+    manifest_t now;
+    bool broken; // Out of memory recording; the new manifest is incomplete
+};
+
+// ============================================================================
+// Static Helpers
+// ============================================================================
+
+// Append info to m.  Returns false when out of memory.
+static bool manifest_push(manifest_t *m, const peel_entry_info_t *info) {
+    if (m->count == m->cap) {
+        size_t cap = m->cap ? m->cap * 2 : 64;
+        manifest_entry_t *tmp = realloc(m->items, cap * sizeof(*tmp));
+        if (!tmp) {
+            return false;
+        }
+        m->items = tmp;
+        m->cap = cap;
+    }
+    m->items[m->count++] = (manifest_entry_t){.info = *info};
+    return true;
+}
+
+// Order manifest lines by member name.
+static int entry_cmp(const void *a, const void *b) {
+    return strcmp(((const manifest_entry_t *)a)->info.meta.name,
+                  ((const manifest_entry_t *)b)->info.meta.name);
+}
+
+// Read the manifest at path into m, sorted by name, with repeated names
+// marked ambiguous.  A missing or unreadable manifest leaves m empty.
+static bool manifest_load(manifest_t *m, const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return true;
+    }
+    char line[512];
+    bool ok = fgets(line, sizeof(line), fp) && strcmp(line, MANIFEST_MAGIC "\n") == 0;
+    while (ok && fgets(line, sizeof(line), fp)) {
+        peel_entry_info_t info;
+        memset(&info, 0, sizeof(info));
+        unsigned long long data_len, rsrc_len;
+        unsigned long data_crc, rsrc_crc, type, creator, flags;
+        int name_at = 0;
+        if (sscanf(line, "%llu %llu %lx %lx %lx %lx %lx %n", &data_len, &rsrc_len, &data_crc,
+                   &rsrc_crc, &type, &creator, &flags, &name_at) != 7 ||
+            name_at == 0) {
+            continue; // Damaged line: that member is simply extracted again
+        }
+        size_t n = strcspn(line + name_at, "\n");
+        if (n == 0 || n >= sizeof(info.meta.name)) {
+            continue;
+        }
+        memcpy(info.meta.name, line + name_at, n);
+        info.data_len = data_len;
+        info.rsrc_len = rsrc_len;
+        info.data_crc = (uint32_t)data_crc;
+        info.rsrc_crc = (uint32_t)rsrc_crc;
+        info.meta.mac_type = (uint32_t)type;
+        info.meta.mac_creator = (uint32_t)creator;
+        info.meta.finder_flags = (uint16_t)flags;
+        ok = manifest_push(m, &info);
+    }
+    fclose(fp);
+
+    qsort(m->items, m->count, sizeof(*m->items), entry_cmp);
+    for (size_t i = 1; i < m->count; i++) {
+        if (entry_cmp(&m->items[i - 1], &m->items[i]) == 0) {
+            m->items[i - 1].ambiguous = m->items[i].ambiguous = true;
+        }
+    }
+    return ok;
+}
+
+// True if the catalog facts in a and b agree.
+static bool same_entry(const peel_entry_info_t *a, const peel_entry_info_t *b) {
+    return a->data_len == b->data_len && a->rsrc_len == b->rsrc_len &&
+           a->data_crc == b->data_crc && a->rsrc_crc == b->rsrc_crc &&
+           a->meta.mac_type == b->meta.mac_type && a->meta.mac_creator == b->meta.mac_creator &&
+           a->meta.finder_flags == b->meta.finder_flags;
+}
+
+// True if path is a regular file of exactly size bytes, last modified no
+// later than the manifest.
+static bool file_matches(const char *path, uint64_t size, time_t written) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode) && (uint64_t)st.st_size == size &&
+           st.st_mtime <= written;
+}
+
+// True if every non-empty fork of info has a stored checksum to compare.
+static bool checksummed(const peel_entry_info_t *info) {
+    return (info->data_len == 0 || info->data_crc != 0) &&
+           (info->rsrc_len == 0 || info->rsrc_crc != 0);
+}
+
+// True if the files extracting info would produce are all on disk, with
+// the sizes it implies.  With xattrs, Finder info and the resource fork
+// may live in attributes, which are not inspected; a sidecar is then only
+// checked when one exists.
+static bool outputs_intact(const incr_state_t *st, const peel_entry_info_t *info) {
+    char path[CLI_PATH_MAX];
+    const char *name = info->meta.name[0] ? info->meta.name : "unnamed";
+    if (!build_path(path, sizeof(path), st->dir, name) ||
+        !file_matches(path, info->data_len, st->written)) {
+        return false;
+    }
+
+    // The sidecar is the AppleDouble header followed by the resource fork
+    peel_file_t f = {.meta = info->meta, .resource_fork = {.size = (size_t)info->rsrc_len}};
+    if (!has_mac_metadata(&f)) {
+        return true;
+    }
+    uint8_t hdr[AD_MAX_HEADER];
+    size_t sidecar_len = appledouble_header(&f, hdr) + (size_t)info->rsrc_len;
+    char *slash = strrchr(path, '/');
+    char sidecar[CLI_PATH_MAX];
+    int n = snprintf(sidecar, sizeof(sidecar), "%.*s/._%s", (int)(slash - path), path, slash + 1);
+    if (n <= 0 || (size_t)n >= sizeof(sidecar)) {
+        return false;
+    }
+    struct stat sb;
+    if (st->xattrs && stat(sidecar, &sb) != 0) {
+        return true;
+    }
+    return file_matches(sidecar, sidecar_len, st->written);
+}
+
+// ============================================================================
+// Operations
+// ============================================================================
+
+// Load the manifest left in dir by the previous run.
+incr_state_t *incr_open(const char *dir, bool xattrs) {
+    incr_state_t *st = calloc(1, sizeof(*st));
+    if (!st) {
+        return NULL;
+    }
+    st->dir = malloc(strlen(dir) + 1);
+    char path[CLI_PATH_MAX];
+    if (!st->dir || !build_path(path, sizeof(path), dir, MANIFEST_NAME)) {
+        incr_close(st, false);
+        return NULL;
+    }
+    strcpy(st->dir, dir);
+    st->xattrs = xattrs;
+
+    struct stat sb;
+    if (stat(path, &sb) == 0) {
+        st->written = sb.st_mtime;
+        if (!manifest_load(&st->old, path)) {
+            st->old.count = 0; // Truncated or foreign: trust none of it
+        }
+    }
+    return st;
+}
+
+// Record entry for the new manifest, then decide whether it can be skipped.
+bool incr_check(incr_state_t *st, const peel_entry_info_t *entry) {
+    if (strchr(entry->meta.name, '\n') == NULL && !manifest_push(&st->now, entry)) {
+        st->broken = true;
+    }
+    manifest_entry_t key = {.info = *entry};
+    const manifest_entry_t *old =
+        bsearch(&key, st->old.items, st->old.count, sizeof(*st->old.items), entry_cmp);
+    return old && !old->ambiguous && checksummed(entry) && same_entry(&old->info, entry) &&
+           outputs_intact(st, entry);
+}
+
+// Replace the manifest with this run's (ok) or remove it, then free st.
+void incr_close(incr_state_t *st, bool ok) {
+    if (!st) {
+        return;
+    }
+    char path[CLI_PATH_MAX], temp[CLI_PATH_MAX];
+    if (st->dir && build_path(path, sizeof(path), st->dir, MANIFEST_NAME) &&
+        build_path(temp, sizeof(temp), st->dir, MANIFEST_NAME ".tmp")) {
+        FILE *fp = ok && !st->broken ? fopen(temp, "w") : NULL;
+        if (fp) {
+            fprintf(fp, "%s\n", MANIFEST_MAGIC);
+            for (size_t i = 0; i < st->now.count; i++) {
+                const peel_entry_info_t *e = &st->now.items[i].info;
+                fprintf(fp, "%llu %llu %lx %lx %lx %lx %lx %s\n",
+                        (unsigned long long)e->data_len, (unsigned long long)e->rsrc_len,
+                        (unsigned long)e->data_crc, (unsigned long)e->rsrc_crc,
+                        (unsigned long)e->meta.mac_type, (unsigned long)e->meta.mac_creator,
+                        (unsigned long)e->meta.finder_flags, e->meta.name);
+            }
+            ok = fclose(fp) == 0 && rename(temp, path) == 0;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            remove(temp);
+            if (remove(path) != 0 && errno != ENOENT) {
+                fprintf(stderr, "peeler: cannot remove stale '%s': %s\n", path, strerror(errno));
+            }
+        }
+    }
+    free(st->old.items);
+    free(st->now.items);
+    free(st->dir);
+    free(st);
+}
@@ -4,204 +4,679 @@
 // main.c
 // CLI entry point for the `peeler` tool.
 //
-// Usage:  peeler <archive> [<output-dir>]
+// Usage:  peeler [-r] [-j <n>] [-o <output-dir>] [--xattr] [--incremental]
+//                [--durable] [--manifest=json] [--tar <file> | --verify] <input>...
+//         peeler <archive> [<output-dir>]
+//         peeler watch [-j <n>] [--xattr] [--incremental] <indir> <outdir>
+//         peeler serve [-j <n>] [--xattr] [--incremental] <socket>
 //
-// Reads the archive, peels all layers, and writes each extracted file to
-// the output directory.  Resource forks are emitted as AppleDouble (._)
-// sidecar files.
-
+// Reads each archive, peels all layers, and writes the extracted files to
+// the output directory.  An input of `-` is standard input, and FIFOs are
+// accepted too; both are read to end of file without a temporary copy.
+// Resource forks and Finder info are emitted as AppleDouble (._) sidecar
+// files, or with --xattr as extended attributes of the data file.  With
+// --tar (`-` for stdout) the same layout is written as one tar stream
+// instead, and nothing touches the filesystem.  A single archive is
+// extracted straight into the output directory; with several inputs, or a
+// directory walked with -r, each input gets its own subdirectory named
+// after it.  Inputs are processed by -j worker threads inside this one
+// process, and the run ends with a summary of how many inputs failed.  With
+// --verify nothing is written: every member is decoded and checked against
+// its stored checksum.  With --incremental, members whose catalog entry and
+// output files are unchanged since the previous run (incremental.c) are
+// skipped without being decoded.  With --durable, each input's files appear
+// under their names only once all of them are safely on disk (output.c).
+// With --manifest=json, a JSON array describing every file written (its
+// layers with their decode times, compression methods and checksum status)
+// is printed to stdout at the end (report.c).
+// `peeler watch` stays running and extracts every archive that lands in
+// indir into outdir/<name>, durably, on a warm set of workers (watch.c).
+// `peeler serve` answers list, get, extract and verify requests on a Unix
+// domain socket, keeping archives it has opened parsed between requests
+// (serve.c).
+
+#define _POSIX_C_SOURCE 200809L // open_memstream, strdup, pthreads
+
+#include "output.h"
 #include "peeler.h"
 
+#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 // ============================================================================
 // Constants and Macros
 // ============================================================================
 
-// AppleDouble magic and version — appledouble.md § "File Identification"
-#define APPLEDOUBLE_MAGIC   0x00051607
-#define APPLEDOUBLE_VERSION 0x00020000
+// Writer threads, and the most decoded fork data queued for them
+#define CLI_WRITERS       4
+#define CLI_WRITE_BACKLOG (64u << 20)
+
+// Smallest data fork decoded straight into a mapping of its output file;
+// below this, creating and mapping the file costs more than the copy saved.
+// PEELER_MAP_MIN overrides it, so the test suite's small archives can take
+// that path too.
+#define CLI_MAP_MIN (1u << 20)
+
+// First buffer for an input of `-`; it grows by half each time it fills
+#define CLI_STDIN_CHUNK (256u << 10)
 
-// AppleDouble entry IDs — appledouble.md § "Standard Entry IDs"
-#define AD_ENTRY_FINDER_INFO 9
-#define AD_ENTRY_RSRC_FORK   2
+// ============================================================================
+// Type Definitions
+// ============================================================================
 
-// Fixed sizes within the AppleDouble header
-#define AD_HEADER_SIZE 26 // magic(4) + version(4) + filler(16) + count(2)
-#define AD_ENTRY_SIZE  12 // id(4) + offset(4) + length(4)
-#define AD_FINDER_LEN  32 // FinderInfo(16) + ExtendedFinderInfo(16)
+// Command-line options shared by every job.
+typedef struct {
+    const char *output_dir; // Output root
+    bool recursive; // Walk directory inputs
+    bool verify; // Check members instead of extracting them
+    bool incremental; // Skip members unchanged since the last run
+    bool manifest_json; // Report every file written on stdout
+    bool whole; // Read every input into memory: no extents or mapped outputs
+    size_t map_min; // Smallest data fork decoded into a mapping (CLI_MAP_MIN)
+    long workers; // Worker threads (-j)
+    output_opts_t output; // How files are stored
+} cli_opts_t;
+
+// One input file and the directory its output goes to.
+typedef struct {
+    char *input;
+    char *out_dir;
+    bool ok;
+    write_batch_t writes; // Updated by the writer pool
+    incr_state_t *incr; // --incremental: manifests, settled once all writes are done
+    report_t *report; // --manifest=json: the files written, printed at the end
+} job_t;
+
+// Growable array of jobs, in the order they were named or found.
+typedef struct {
+    job_t *items;
+    size_t count;
+    size_t cap;
+} job_list_t;
+
+// State shared by the worker threads.
+typedef struct {
+    job_list_t *jobs;
+    const cli_opts_t *opts;
+    bool labelled; // Prefix verify output with the input path
+    writer_pool_t *writers; // Extraction only
+    size_t next; // Next unclaimed job
+    pthread_mutex_t lock; // Guards next and stdout
+} worker_pool_t;
 
 // ============================================================================
 // Static Helpers
 // ============================================================================
 
-// Write a 32-bit big-endian value to a byte pointer.
-static void put_be32(uint8_t *p, uint32_t v) {
-    p[0] = (uint8_t)(v >> 24);
-    p[1] = (uint8_t)(v >> 16);
-    p[2] = (uint8_t)(v >> 8);
-    p[3] = (uint8_t)(v);
+// Print usage text and exit.
+static void usage(const char *progname) {
+    fprintf(stderr,
+            "usage: %s [-r] [-j <n>] [-o <output-dir>] [--xattr] [--incremental]\n"
+            "              [--durable] [--manifest=json] [--tar <file> | --verify] <input>...\n",
+            progname);
+    fprintf(stderr, "       %s <archive> [<output-dir>]\n", progname);
+    fprintf(stderr, "       %s watch [-j <n>] [--xattr] [--incremental] <indir> <outdir>\n",
+            progname);
+    fprintf(stderr, "       %s serve [-j <n>] [--xattr] [--incremental] <socket>\n", progname);
+}
+
+// Copy the last component of path (ignoring trailing slashes) into buf.
+static void base_name(const char *path, char *buf, size_t buf_size) {
+    size_t end = strlen(path);
+    while (end > 1 && path[end - 1] == '/') {
+        end--;
+    }
+    size_t start = end;
+    while (start > 0 && path[start - 1] != '/') {
+        start--;
+    }
+    snprintf(buf, buf_size, "%.*s", (int)(end - start), path + start);
 }
 
-// Write a 16-bit big-endian value to a byte pointer.
-static void put_be16(uint8_t *p, uint16_t v) {
-    p[0] = (uint8_t)(v >> 8);
-    p[1] = (uint8_t)(v);
+// Append a job, copying both paths.
+static bool add_job(job_list_t *list, const char *input, const char *out_dir) {
+    if (list->count == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 16;
+        job_t *tmp = realloc(list->items, cap * sizeof(*tmp));
+        if (!tmp) {
+            return false;
+        }
+        list->items = tmp;
+        list->cap = cap;
+    }
+    job_t *j = &list->items[list->count];
+    *j = (job_t){.input = strdup(input), .out_dir = strdup(out_dir)};
+    if (!j->input || !j->out_dir) {
+        free(j->input);
+        free(j->out_dir);
+        return false;
+    }
+    list->count++;
+    return true;
 }
 
-// Build a file path from directory and filename, writing into buf.
-// Returns false if the combined path would overflow the buffer.
-static bool build_path(char *buf, size_t buf_size, const char *dir, const char *name) {
-    int n = snprintf(buf, buf_size, "%s/%s", dir, name);
-    return n > 0 && (size_t)n < buf_size;
+// Order jobs by input path so a directory walk is reproducible.
+static int job_cmp(const void *a, const void *b) {
+    return strcmp(((const job_t *)a)->input, ((const job_t *)b)->input);
 }
 
-// Recursively create all parent directories for the given file path.
-// Similar to `mkdir -p` on the parent directory.
-static bool ensure_parent_dirs(const char *path) {
-    char tmp[1024];
-    size_t len = strlen(path);
-    if (len >= sizeof(tmp)) {
+// Queue every regular file below dir; out_dir mirrors its layout.
+// Symlinks to files are followed, symlinks to directories are not.
+static bool collect_dir(job_list_t *list, const char *dir, const char *out_dir) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "peeler: %s: %s\n", dir, strerror(errno));
         return false;
     }
-    memcpy(tmp, path, len + 1);
+    bool ok = true;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+            continue;
+        }
+        char in_path[CLI_PATH_MAX], sub_out[CLI_PATH_MAX];
+        if (!build_path(in_path, sizeof(in_path), dir, de->d_name) ||
+            !build_path(sub_out, sizeof(sub_out), out_dir, de->d_name)) {
+            fprintf(stderr, "peeler: path too long under '%s'\n", dir);
+            ok = false;
+            continue;
+        }
+        struct stat st;
+        if (lstat(in_path, &st) != 0) {
+            continue; // Vanished while walking
+        }
+        if (S_ISDIR(st.st_mode)) {
+            ok = collect_dir(list, in_path, sub_out) && ok;
+        } else if ((S_ISREG(st.st_mode) || (S_ISLNK(st.st_mode) && stat(in_path, &st) == 0 &&
+                                            S_ISREG(st.st_mode))) &&
+                   !add_job(list, in_path, sub_out)) {
+            ok = false;
+        }
+    }
+    closedir(d);
+    return ok;
+}
+
+// True if out_dir is already the output directory of a job, or a parent of
+// one.
+static bool out_dir_taken(const job_list_t *list, const char *out_dir) {
+    size_t len = strlen(out_dir);
+    for (size_t i = 0; i < list->count; i++) {
+        const char *o = list->items[i].out_dir;
+        if (strncmp(o, out_dir, len) == 0 && (o[len] == '\0' || o[len] == '/')) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    // Walk the path and create each directory component
-    for (size_t i = 1; i < len; i++) {
-        if (tmp[i] == '/') {
-            tmp[i] = '\0';
-            if (mkdir(tmp, 0755) != 0 && errno != EEXIST) {
-                return false;
+// Turn the positional arguments into jobs.  A lone file argument is
+// extracted straight into the output root; anything else gets a
+// subdirectory named after the argument ("stdin" for "-").  Arguments that
+// share a name get "<name>-2", "<name>-3" and so on, so that no two inputs
+// write into the same directory.
+static bool collect_inputs(job_list_t *list, char **args, int count, const cli_opts_t *opts) {
+    bool ok = true;
+    bool used_stdin = false;
+    for (int i = 0; i < count; i++) {
+        struct stat st;
+        bool is_stdin = strcmp(args[i], "-") == 0;
+        bool is_dir = !is_stdin && stat(args[i], &st) == 0 && S_ISDIR(st.st_mode);
+        char name[CLI_PATH_MAX], out_dir[CLI_PATH_MAX];
+        base_name(args[i], name, sizeof(name));
+        if (is_stdin) {
+            // Standard input can only be read once
+            if (used_stdin) {
+                fprintf(stderr, "peeler: '-' given more than once\n");
+                ok = false;
+                continue;
             }
-            tmp[i] = '/';
+            used_stdin = true;
+            snprintf(name, sizeof(name), "stdin");
+        }
+        bool flat = count == 1 && !is_dir;
+        if (!flat && !build_path(out_dir, sizeof(out_dir), opts->output_dir, name)) {
+            fprintf(stderr, "peeler: path too long for '%s'\n", args[i]);
+            ok = false;
+            continue;
+        }
+        if (!flat && out_dir_taken(list, out_dir)) {
+            size_t len = strlen(out_dir);
+            for (int n = 2; out_dir_taken(list, out_dir); n++) {
+                if (snprintf(out_dir + len, sizeof(out_dir) - len, "-%d", n) >=
+                    (int)(sizeof(out_dir) - len)) {
+                    break; // Left taken; reported below
+                }
+            }
+            if (out_dir_taken(list, out_dir)) {
+                fprintf(stderr, "peeler: path too long for '%s'\n", args[i]);
+                ok = false;
+                continue;
+            }
+            fprintf(stderr, "peeler: %s: name already used, extracting into '%s'\n", args[i],
+                    out_dir);
+        }
+
+        if (!is_dir) {
+            // Missing files still become jobs so they show up as failures
+            ok = add_job(list, args[i], flat ? opts->output_dir : out_dir) && ok;
+        } else if (!opts->recursive) {
+            fprintf(stderr, "peeler: %s: is a directory (use -r)\n", args[i]);
+            ok = false;
+        } else {
+            size_t first = list->count;
+            ok = collect_dir(list, args[i], out_dir) && ok;
+            qsort(list->items + first, list->count - first, sizeof(job_t), job_cmp);
         }
     }
-    return true;
+    return ok;
+}
+
+// Where the library hands decoded files: the writers, the job, the input
+// its extent forks are copied from, the output file its current data fork
+// is being decoded into, if any, and how the file was produced.
+typedef struct {
+    writer_pool_t *writers;
+    job_t *job;
+    write_source_t *src;
+    size_t map_min; // Smaller data forks are decoded into memory
+    mapped_out_t mapped;
+    peel_trace_t trace;
+    bool traced; // trace describes the file about to be submitted
+    bool report_failed; // Out of memory recording it; the run stopped there
+} submit_ctx_t;
+
+// peel_each_fn that queues each decoded file for writing.
+static bool submit_file(peel_file_t *file, void *ctx) {
+    submit_ctx_t *sc = ctx;
+    bool more = true;
+    if (sc->job->report) {
+        more = report_add(sc->job->report, file, sc->traced ? &sc->trace : NULL);
+        sc->report_failed = !more;
+        sc->traced = false;
+    }
+    writer_pool_submit(sc->writers, file, sc->job->out_dir, sc->job->input, sc->src,
+                       file->data_fork.sunk ? &sc->mapped : NULL, &sc->job->writes);
+    return more;
+}
+
+// peel_sink_t trace(): keep it for submit_file() to record.
+static void record_trace(void *ctx, const peel_file_t *file, const peel_trace_t *trace) {
+    (void)file;
+    submit_ctx_t *sc = ctx;
+    sc->trace = *trace;
+    sc->traced = true;
+}
+
+// peel_sink_t acquire(): a large data fork is decoded into a mapping of its
+// output file.  The library decodes one fork at a time, so one slot will do.
+static uint8_t *map_output(void *ctx, const peel_file_meta_t *meta, size_t size) {
+    submit_ctx_t *sc = ctx;
+    uint8_t *data = NULL;
+    if (size < sc->map_min ||
+        !mapped_out_create(&sc->mapped, sc->job->out_dir, meta->name[0] ? meta->name : "unnamed",
+                           size, &data)) {
+        return NULL; // Decoded into memory and written as usual
+    }
+    return data;
+}
+
+// peel_sink_t discard(): the fork failed or was peeled further.
+static void unmap_output(void *ctx, uint8_t *data, size_t size) {
+    submit_ctx_t *sc = ctx;
+    mapped_out_discard(&sc->mapped, data, size);
+}
+
+// peel_sink_t skip(): --incremental leaves out members already extracted.
+static bool skip_unchanged(void *ctx, const peel_entry_info_t *entry) {
+    submit_ctx_t *sc = ctx;
+    return incr_check(sc->job->incr, entry);
+}
+
+// Read standard input to end of file into an owned buffer.  Returns false,
+// with errno set, on a read error or out of memory.
+static bool read_stdin(peel_buf_t *out) {
+    size_t cap = CLI_STDIN_CHUNK, len = 0;
+    uint8_t *data = malloc(cap);
+    while (data) {
+        if (len == cap) {
+            uint8_t *tmp = cap <= SIZE_MAX / 3 ? realloc(data, cap + cap / 2) : NULL;
+            if (!tmp) {
+                errno = ENOMEM;
+                break;
+            }
+            data = tmp;
+            cap += cap / 2;
+        }
+        ssize_t n = read(STDIN_FILENO, data + len, cap - len);
+        if (n == 0) {
+            *out = (peel_buf_t){.data = data, .size = len, .owned = true, .cap = cap};
+            return true;
+        }
+        if (n < 0 && errno != EINTR) {
+            break;
+        }
+        len += n > 0 ? (size_t)n : 0;
+    }
+    free(data);
+    return false;
 }
 
-// Write raw bytes to a file.  Returns true on success.
-static bool write_blob(const char *path, const uint8_t *data, size_t len) {
-    FILE *fp = fopen(path, "wb");
-    if (!fp) {
+// Read a whole input into memory: standard input for `-`, which the library
+// does not know about, otherwise the named file.  Failures are reported
+// here; returns false after one.
+static bool read_input(const char *input, peel_buf_t *out) {
+    if (strcmp(input, "-") == 0) {
+        if (!read_stdin(out)) {
+            fprintf(stderr, "peeler: reading standard input: %s\n", strerror(errno));
+            return false;
+        }
+        return true;
+    }
+    peel_err_t *err = NULL;
+    *out = peel_read_file(input, &err);
+    if (err) {
+        fprintf(stderr, "peeler: %s\n", peel_err_msg(err));
+        peel_err_free(err);
         return false;
     }
-    bool ok = (fwrite(data, 1, len, fp) == len);
-    fclose(fp);
-    return ok;
+    return true;
 }
 
-// Write the data fork of a file to the output directory.
-static bool write_data_fork(const char *dir, const peel_file_t *f) {
-    const char *name = f->meta.name[0] ? f->meta.name : "unnamed";
-    char path[1024];
-    if (!build_path(path, sizeof(path), dir, name)) {
-        fprintf(stderr, "peeler: path too long for '%s'\n", name);
+// Peel a regular input file with stored forks left in place as extents,
+// which the writers copy file-to-file, and large data forks decoded
+// straight into their output files.  Returns false, having done nothing,
+// if the input is not a regular file that could be opened.
+static bool peel_extents(submit_ctx_t *sc, peel_err_t **err) {
+    struct stat st;
+    if (strcmp(sc->job->input, "-") == 0 || stat(sc->job->input, &st) != 0 ||
+        !S_ISREG(st.st_mode)) {
+        return false; // Standard input, FIFOs, missing files
+    }
+    int fd = open(sc->job->input, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    sc->src = write_source_new(fd);
+    if (!sc->src) {
+        close(fd);
         return false;
     }
-    if (!ensure_parent_dirs(path)) {
-        fprintf(stderr, "peeler: cannot create directories for '%s'\n", name);
+    peel_sink_t sink = {.acquire = map_output, .discard = unmap_output,
+                        .skip = sc->job->incr ? skip_unchanged : NULL,
+                        .trace = sc->job->report ? record_trace : NULL, .ctx = sc};
+    peel_fd_each_into(fd, &sink, submit_file, sc, err);
+    write_source_release(sc->writers, sc->src);
+    sc->src = NULL;
+    return true;
+}
+
+// Read the whole input into memory and peel it: for tar output, standard
+// input, FIFOs and the daemons.  Returns false, having reported it, if the
+// input could not be read; peeling errors are left in *err.
+static bool peel_whole(submit_ctx_t *sc, peel_err_t **err) {
+    peel_buf_t in;
+    if (!read_input(sc->job->input, &in)) {
         return false;
     }
-    return write_blob(path, f->data_fork.data, f->data_fork.size);
+    peel_sink_t sink = {.skip = sc->job->incr ? skip_unchanged : NULL,
+                        .trace = sc->job->report ? record_trace : NULL, .ctx = sc};
+    peel_each_into(in.data, in.size, &sink, submit_file, sc, err);
+    peel_free(&in);
+    return true;
 }
 
-// Build an AppleDouble header file containing Finder info and the resource
-// fork.  Layout: [header][finder_entry_desc][rsrc_entry_desc][finder_data][rsrc_data]
-// appledouble.md § "Writing & Updating Rules"
-static bool write_appledouble(const char *dir, const peel_file_t *f) {
-    const char *name = f->meta.name[0] ? f->meta.name : "unnamed";
-
-    // Build ._<name> sidecar path, inserting ._ before the filename
-    // component (e.g. "dir/subdir/._file" not "dir/._ subdir/file").
-    char path[1024];
-    const char *slash = strrchr(name, '/');
-    int n;
-    if (slash) {
-        // name contains a directory component
-        n = snprintf(path, sizeof(path), "%s/%.*s/._%s", dir,
-                     (int)(slash - name), name, slash + 1);
-    } else {
-        n = snprintf(path, sizeof(path), "%s/._%s", dir, name);
-    }
-    if (n <= 0 || (size_t)n >= sizeof(path)) {
-        fprintf(stderr, "peeler: path too long for '._%s'\n", name);
+// Peel one archive, queueing its files for the writers as they are decoded.
+// Returns false if the input could not be peeled; write failures are
+// counted in the job separately.  Regular files are peeled in place, with
+// extents and mapped outputs, unless opts->whole; other inputs are read
+// whole.
+static bool extract_archive(job_t *job, writer_pool_t *writers, const cli_opts_t *opts) {
+    bool to_tar = opts->output.tar_fd >= 0;
+    // Create output directory if it does not exist
+    if (!to_tar && !make_dirs(job->out_dir)) {
+        fprintf(stderr, "peeler: cannot create '%s': %s\n", job->out_dir, strerror(errno));
         return false;
     }
-    if (!ensure_parent_dirs(path)) {
-        fprintf(stderr, "peeler: cannot create directories for '._%s'\n", name);
+    if ((opts->incremental && !(job->incr = incr_open(job->out_dir, opts->output.xattrs))) ||
+        (opts->manifest_json && !(job->report = report_new(job->input, job->out_dir)))) {
+        fprintf(stderr, "peeler: out of memory\n");
         return false;
     }
 
-    // Layout depends on whether resource fork data is present:
-    //   - With rsrc: header(26) + 2 descriptors(24) + FinderInfo(32) + rsrc data
-    //   - Without:   header(26) + 1 descriptor(12)  + FinderInfo(32)
-    bool has_rsrc = (f->resource_fork.size > 0);
-    size_t num_entries = has_rsrc ? 2 : 1;
-    uint32_t finder_offset = (uint32_t)(AD_HEADER_SIZE + num_entries * AD_ENTRY_SIZE);
-    uint32_t rsrc_offset = finder_offset + AD_FINDER_LEN;
-    size_t total = has_rsrc ? rsrc_offset + f->resource_fork.size
-                            : finder_offset + AD_FINDER_LEN;
+    // Files decoded before an error are still written, unless output is
+    // durable: then an input's files are published all together or not at all
+    peel_err_t *err = NULL;
+    submit_ctx_t sc = {.writers = writers, .job = job, .map_min = opts->map_min};
+    bool read = true;
+    if (to_tar || opts->whole || !peel_extents(&sc, &err)) {
+        read = peel_whole(&sc, &err);
+    }
+    if (opts->output.durable) {
+        writer_pool_publish(writers, &job->writes, job->out_dir,
+                            read && !err && !sc.report_failed);
+    }
+    if (!read) {
+        return false;
+    }
+    if (sc.report_failed) {
+        fprintf(stderr, "peeler: %s: out of memory\n", job->input);
+        peel_err_free(err);
+        return false;
+    }
+    if (err) {
+        fprintf(stderr, "peeler: %s: %s\n", job->input, peel_err_msg(err));
+        peel_err_free(err);
+        return false;
+    }
+    return true;
+}
 
-    uint8_t *buf = calloc(1, total);
-    if (!buf) {
+// Check every member of an archive, printing one status line each to out.
+// label, when set, prefixes every line.  Returns false if anything failed.
+static bool verify_archive(const char *input_path, FILE *out, const char *label) {
+    peel_buf_t src;
+    if (!read_input(input_path, &src)) {
+        return false;
+    }
+
+    peel_err_t *err = NULL;
+    peel_verify_report_t report;
+    bool ok = peel_verify(src.data, src.size, &report, &err);
+    peel_free(&src);
+    if (!ok) {
+        fprintf(stderr, "peeler: %s: %s\n", input_path, peel_err_msg(err));
+        peel_err_free(err);
         return false;
     }
 
-    // Fixed header — appledouble.md § "Fixed Header"
-    uint8_t *p = buf;
-    put_be32(p, APPLEDOUBLE_MAGIC);
-    p += 4;
-    put_be32(p, APPLEDOUBLE_VERSION);
-    p += 4;
-    // 16 bytes filler (already zero from calloc)
-    p += 16;
-    put_be16(p, (uint16_t)num_entries);
-    p += 2;
-
-    // Entry descriptor 1: Finder Info — appledouble.md § "Entry Descriptors"
-    put_be32(p, AD_ENTRY_FINDER_INFO);
-    p += 4;
-    put_be32(p, finder_offset);
-    p += 4;
-    put_be32(p, AD_FINDER_LEN);
-    p += 4;
-
-    // Entry descriptor 2: Resource Fork (only if present)
-    if (has_rsrc) {
-        put_be32(p, AD_ENTRY_RSRC_FORK);
-        p += 4;
-        put_be32(p, rsrc_offset);
-        p += 4;
-        put_be32(p, (uint32_t)f->resource_fork.size);
-        p += 4;
-    }
-
-    // Finder Info payload: type(4) + creator(4) + flags(2) + padding(22)
-    // appledouble.md § "Finder Info"
-    uint8_t *finder = buf + finder_offset;
-    put_be32(finder, f->meta.mac_type);
-    put_be32(finder + 4, f->meta.mac_creator);
-    put_be16(finder + 8, f->meta.finder_flags);
-    // Remaining 22 bytes are zero (from calloc)
-
-    // Resource fork payload (only if present)
-    if (has_rsrc) {
-        memcpy(buf + rsrc_offset, f->resource_fork.data, f->resource_fork.size);
-    }
-
-    bool ok = write_blob(path, buf, total);
-    free(buf);
+    static const char *const labels[] = {
+        [PEEL_VERIFY_OK] = "ok",
+        [PEEL_VERIFY_UNCHECKED] = "unchecked",
+        [PEEL_VERIFY_FAILED] = "FAILED",
+    };
+    const char *sep = label ? ": " : "";
+    label = label ? label : "";
+    for (size_t i = 0; i < report.count; i++) {
+        const peel_verify_entry_t *e = &report.entries[i];
+        if (e->status == PEEL_VERIFY_FAILED) {
+            fprintf(out, "%s%s%-9s %s: %s\n", label, sep, labels[e->status], e->meta.name,
+                    e->message);
+        } else {
+            fprintf(out, "%s%s%-9s %s\n", label, sep, labels[e->status], e->meta.name);
+        }
+    }
+    fprintf(out, "%s%s%zu checked, %zu failed\n", label, sep, report.count, report.failed);
+
+    ok = report.failed == 0;
+    peel_verify_free(&report);
     return ok;
 }
 
-// Print usage text and exit.
-static void usage(const char *progname) {
-    fprintf(stderr, "usage: %s <archive> [<output-dir>]\n", progname);
+// Run one job.  Verify output is buffered and printed in one piece so
+// parallel jobs do not interleave their lines.
+static void run_job(worker_pool_t *pool, job_t *job) {
+    if (!pool->opts->verify) {
+        job->ok = extract_archive(job, pool->writers, pool->opts);
+        return;
+    }
+    char *text = NULL;
+    size_t text_len = 0;
+    FILE *mem = open_memstream(&text, &text_len);
+    if (!mem) {
+        fprintf(stderr, "peeler: %s: %s\n", job->input, strerror(errno));
+        return;
+    }
+    job->ok = verify_archive(job->input, mem, pool->labelled ? job->input : NULL);
+    fclose(mem);
+    pthread_mutex_lock(&pool->lock);
+    fwrite(text, 1, text_len, stdout);
+    fflush(stdout);
+    pthread_mutex_unlock(&pool->lock);
+    free(text);
+}
+
+// Worker thread: claim jobs until none are left.
+static void *worker_main(void *arg) {
+    worker_pool_t *pool = arg;
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        size_t i = pool->next < pool->jobs->count ? pool->next++ : SIZE_MAX;
+        pthread_mutex_unlock(&pool->lock);
+        if (i == SIZE_MAX) {
+            return NULL;
+        }
+        run_job(pool, &pool->jobs->items[i]);
+    }
+}
+
+// Process every job on opts->workers threads (the caller's included).
+static void run_jobs(job_list_t *jobs, const cli_opts_t *opts) {
+    worker_pool_t pool = {.jobs = jobs, .opts = opts, .labelled = jobs->count > 1};
+    pthread_mutex_init(&pool.lock, NULL);
+    if (!opts->verify) {
+        pool.writers = writer_pool_start(CLI_WRITERS, CLI_WRITE_BACKLOG, &opts->output);
+        if (!pool.writers) {
+            fprintf(stderr, "peeler: out of memory\n");
+            pthread_mutex_destroy(&pool.lock);
+            return;
+        }
+    }
+
+    size_t extra = (size_t)opts->workers - 1;
+    if (extra > jobs->count - 1) {
+        extra = jobs->count - 1;
+    }
+    pthread_t *threads = extra ? calloc(extra, sizeof(*threads)) : NULL;
+    size_t started = 0;
+    while (threads && started < extra &&
+           pthread_create(&threads[started], NULL, worker_main, &pool) == 0) {
+        started++; // On failure the threads already running pick up the slack
+    }
+    worker_main(&pool);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    pthread_mutex_destroy(&pool.lock);
+
+    // An input only succeeded once all of its files are on disk, and only
+    // then does its manifest record them
+    writer_pool_finish(pool.writers);
+    for (size_t i = 0; i < jobs->count; i++) {
+        job_t *j = &jobs->items[i];
+        j->ok = j->ok && j->writes.failures == 0;
+        incr_close(j->incr, j->ok);
+        j->incr = NULL;
+    }
+}
+
+// Writers and options shared by every archive `peeler watch` or `peeler
+// serve` extracts.
+typedef struct {
+    writer_pool_t *writers;
+    const cli_opts_t *opts;
+} daemon_ctx_t;
+
+// extract_fn: extract one archive as a job of its own.  Output is durable,
+// so by the time extract_archive() returns its files are written and
+// published.
+static bool extract_one(const char *input, const char *out_dir, void *ctx) {
+    daemon_ctx_t *dc = ctx;
+    job_t job = {.input = (char *)input, .out_dir = (char *)out_dir};
+    bool ok = extract_archive(&job, dc->writers, dc->opts) && job.writes.failures == 0;
+    incr_close(job.incr, ok);
+    writer_pool_forget_dirs(dc->writers); // out_dir may be removed before the next archive
+    return ok;
+}
+
+// verify_fn: check one archive for `peeler serve`.
+static bool verify_one(const char *input, FILE *out, void *ctx) {
+    (void)ctx;
+    return verify_archive(input, out, NULL);
+}
+
+// Run `peeler watch <in> <out>` or `peeler serve <socket>` (out NULL) until
+// stopped.  Returns the exit status.
+static int run_daemon(const cli_opts_t *opts, const char *in, const char *out) {
+    block_stop_signals(); // Before the writers start, so they never take them
+    writer_pool_t *writers = writer_pool_start(CLI_WRITERS, CLI_WRITE_BACKLOG, &opts->output);
+    if (!writers) {
+        fprintf(stderr, "peeler: out of memory\n");
+        return 1;
+    }
+    daemon_ctx_t dc = {.writers = writers, .opts = opts};
+    serve_ops_t ops = {.extract = extract_one, .verify = verify_one, .ctx = &dc};
+    bool ok = out ? watch_run(in, out, (size_t)opts->workers, extract_one, &dc)
+                  : serve_run(in, (size_t)opts->workers, &ops);
+    writer_pool_finish(writers);
+    return ok ? 0 : 1;
+}
+
+// Open the --tar destination ("-" is stdout) and record it in opts.
+static bool open_tar(const char *path, cli_opts_t *opts) {
+    if (opts->verify) {
+        fprintf(stderr, "peeler: --tar and --verify cannot be combined\n");
+        return false;
+    }
+    int fd = STDOUT_FILENO;
+    if (strcmp(path, "-") != 0) {
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            fprintf(stderr, "peeler: cannot create '%s': %s\n", path, strerror(errno));
+            return false;
+        }
+    } else if (isatty(fd)) {
+        fprintf(stderr, "peeler: refusing to write a tar stream to a terminal\n");
+        return false;
+    }
+    opts->output.tar_fd = fd;
+    opts->output.tar_mtime = (int64_t)time(NULL);
+    return true;
+}
+
+// Parse a -j value; returns 0 if it is not a positive integer.
+static long parse_workers(const char *s) {
+    char *end;
+    long n = strtol(s, &end, 10);
+    return (*s && !*end && n > 0 && n <= 1024) ? n : 0;
+}
+
+// Parse a PEELER_MAP_MIN value; returns 0 if it is not a positive integer.
+static size_t parse_map_min(const char *s) {
+    char *end;
+    errno = 0;
+    unsigned long long n = strtoull(s, &end, 10);
+    return (*s >= '0' && *s <= '9' && !*end && !errno && n <= SIZE_MAX) ? (size_t)n : 0;
 }
 
 // ============================================================================
@@ -209,54 +684,153 @@ static void usage(const char *progname) {
 // ============================================================================
 
 int main(int argc, char **argv) {
-    if (argc < 2 || argc > 3) {
+    cli_opts_t opts = {.map_min = CLI_MAP_MIN, .workers = 1, .output = {.tar_fd = -1}};
+    const char *tar_path = NULL;
+    char **args = calloc((size_t)argc, sizeof(*args));
+    int nargs = 0;
+    if (!args) {
+        return 1;
+    }
+    // Long-running modes: `peeler watch` and `peeler serve`
+    bool watching = argc > 1 && strcmp(argv[1], "watch") == 0;
+    bool serving = argc > 1 && strcmp(argv[1], "serve") == 0;
+
+    // Options may appear anywhere; "--" ends them
+    bool options_done = false;
+    for (int i = watching || serving ? 2 : 1; i < argc; i++) {
+        const char *a = argv[i];
+        bool bad = false;
+        if (options_done || a[0] != '-' || a[1] == '\0') {
+            args[nargs++] = argv[i];
+        } else if (strcmp(a, "--") == 0) {
+            options_done = true;
+        } else if (strcmp(a, "-r") == 0) {
+            opts.recursive = true;
+        } else if (strcmp(a, "--verify") == 0) {
+            opts.verify = true;
+        } else if (strcmp(a, "--xattr") == 0) {
+            opts.output.xattrs = true;
+        } else if (strcmp(a, "--incremental") == 0) {
+            opts.incremental = true;
+        } else if (strcmp(a, "--durable") == 0) {
+            opts.output.durable = true;
+        } else if (strcmp(a, "--manifest=json") == 0) {
+            opts.manifest_json = true;
+        } else if (strcmp(a, "--tar") == 0 && i + 1 < argc) {
+            tar_path = argv[++i];
+        } else if (strcmp(a, "-o") == 0 && i + 1 < argc) {
+            opts.output_dir = argv[++i];
+        } else if (strncmp(a, "-j", 2) == 0) {
+            // Both "-j 8" and "-j8"
+            const char *v = a[2] ? a + 2 : (i + 1 < argc ? argv[++i] : "");
+            opts.workers = parse_workers(v);
+            bad = opts.workers == 0;
+        } else {
+            bad = true;
+        }
+        if (bad) {
+            fprintf(stderr, "peeler: bad option '%s'\n", a);
+            usage(argv[0]);
+            free(args);
+            return 1;
+        }
+    }
+    const char *map_min = getenv("PEELER_MAP_MIN");
+    if (map_min && !(opts.map_min = parse_map_min(map_min))) {
+        fprintf(stderr, "peeler: bad PEELER_MAP_MIN '%s'\n", map_min);
+        free(args);
+        return 1;
+    }
+    bool daemon = watching || serving;
+    if (nargs == 0 || (daemon && (nargs != (watching ? 2 : 1) || opts.output_dir ||
+                                  opts.recursive || opts.verify || tar_path ||
+                                  opts.manifest_json))) {
         usage(argv[0]);
+        free(args);
         return 1;
     }
+    if (daemon) {
+        // A long-running daemon must not die of SIGBUS: an output file
+        // truncated under its mapping would raise one
+        opts.output.durable = true;
+        opts.whole = true;
+        int status = run_daemon(&opts, args[0], watching ? args[1] : NULL);
+        free(args);
+        return status;
+    }
 
-    const char *input_path = argv[1];
-    const char *output_dir = (argc == 3) ? argv[2] : ".";
-
-    // Create output directory if it does not exist (ignore EEXIST)
-    if (mkdir(output_dir, 0755) != 0 && errno != EEXIST) {
-        fprintf(stderr, "peeler: cannot create '%s': %s\n", output_dir, strerror(errno));
+    // Original form: `peeler <archive> <output-dir>`, recognised when the
+    // second argument is not an existing file
+    struct stat st;
+    if (!opts.output_dir && !opts.verify && !tar_path && nargs == 2 && strcmp(args[1], "-") != 0 &&
+        (stat(args[1], &st) != 0 || S_ISDIR(st.st_mode))) {
+        opts.output_dir = args[1];
+        nargs = 1;
+    }
+    if (!opts.output_dir) {
+        opts.output_dir = ".";
+    }
+    if ((opts.incremental || opts.output.durable) && (opts.verify || tar_path)) {
+        fprintf(stderr, "peeler: --%s needs an output directory\n",
+                opts.incremental ? "incremental" : "durable");
+        free(args);
         return 1;
     }
-
-    // Peel the archive
-    peel_err_t *err = NULL;
-    peel_file_list_t files = peel_path(input_path, &err);
-    if (err) {
-        fprintf(stderr, "peeler: %s\n", peel_err_msg(err));
-        peel_err_free(err);
+    if (opts.manifest_json && (opts.verify || (tar_path && strcmp(tar_path, "-") == 0))) {
+        fprintf(stderr, "peeler: --manifest=json cannot be combined with %s\n",
+                opts.verify ? "--verify" : "--tar -");
+        free(args);
+        return 1;
+    }
+    if (tar_path && !open_tar(tar_path, &opts)) {
+        free(args);
         return 1;
     }
 
-    // Write each extracted file to disk
-    int failures = 0;
-    for (int i = 0; i < files.count; i++) {
-        const peel_file_t *f = &files.files[i];
-
-        // Write data fork (always, even if empty — Mac archives track
-        // files that have only a resource fork or metadata).
-        if (!write_data_fork(output_dir, f)) {
-            fprintf(stderr, "peeler: failed to write '%s'\n", f->meta.name);
-            failures++;
+    job_list_t jobs = {0};
+    bool ok = collect_inputs(&jobs, args, nargs, &opts);
+    free(args);
+    if (jobs.count > 0) {
+        run_jobs(&jobs, &opts);
+    }
+    if (opts.manifest_json) {
+        bool first = true;
+        fputs("[", stdout);
+        for (size_t i = 0; i < jobs.count; i++) {
+            report_write(jobs.items[i].report, stdout, &first);
         }
+        fputs("\n]\n", stdout);
+        fflush(stdout);
+    }
 
-        // Write resource fork as AppleDouble sidecar.  Create a sidecar
-        // whenever there is resource fork data OR Finder metadata
-        // (type/creator/flags), since the sidecar carries both.
-        if (f->resource_fork.size > 0 ||
-            f->meta.mac_type != 0 || f->meta.mac_creator != 0 ||
-            f->meta.finder_flags != 0) {
-            if (!write_appledouble(output_dir, f)) {
-                fprintf(stderr, "peeler: failed to write '._%s'\n", f->meta.name);
-                failures++;
+    // Summary: only worth printing when there was more than one input
+    size_t failed = 0;
+    for (size_t i = 0; i < jobs.count; i++) {
+        failed += !jobs.items[i].ok;
+    }
+    if (jobs.count > 1) {
+        for (size_t i = 0; i < jobs.count; i++) {
+            if (!jobs.items[i].ok) {
+                fprintf(stderr, "peeler: FAILED %s\n", jobs.items[i].input);
             }
         }
+        fprintf(stderr, "peeler: %zu inputs, %zu ok, %zu failed\n", jobs.count,
+                jobs.count - failed, failed);
     }
 
-    peel_file_list_free(&files);
-    return failures > 0 ? 1 : 0;
+    if (opts.output.tar_fd >= 0) {
+        if (!tar_write_end(opts.output.tar_fd) ||
+            (opts.output.tar_fd != STDOUT_FILENO && close(opts.output.tar_fd) != 0)) {
+            fprintf(stderr, "peeler: cannot finish tar stream: %s\n", strerror(errno));
+            ok = false;
+        }
+    }
+
+    for (size_t i = 0; i < jobs.count; i++) {
+        free(jobs.items[i].input);
+        free(jobs.items[i].out_dir);
+        report_free(jobs.items[i].report);
+    }
+    free(jobs.items);
+    return (ok && failed == 0) ? 0 : 1;
 }
@@ -0,0 +1,1117 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) pappadf
+
+// output.c
+// Writing extracted files to disk (or a tar stream, tar.c) for the
+// `peeler` CLI.
+//
+// Each file becomes its data fork plus, when it has a resource fork or
+// Finder metadata, an AppleDouble (._) sidecar.  Decoding and writing are
+// pipelined: decode threads hand finished files to a writer pool and go
+// straight on to the next member, so extraction costs roughly
+// max(decode, I/O) rather than their sum.  Every file is routed to a writer
+// by a hash of its output path, so two members with the same name are
+// still written in archive order and the later one wins, as before.  The
+// pool bounds the bytes queued but not yet written; decoders block when the
+// bound is reached.
+//
+// Forks the library hands out as extents (stored verbatim in a regular
+// input file) are never loaded: they are copied file-to-file inside the
+// kernel with copy_file_range(), which can reflink on filesystems that
+// share extents, or sendfile() where that is refused.
+//
+// Large compressed data forks are not written at all: the decoder fills a
+// shared mapping of the output file, created under a temporary name and
+// reserved at its final size, and the writer only renames it into place.
+// The kernel writes the pages back as they fill, so the fork never passes
+// through a heap buffer or a write() copy.
+//
+// With durable output (--durable) every file is written under a temporary
+// name instead.  Once all of an input's files are written they are synced
+// in one sweep (syncfs() on Linux, fdatasync() per file elsewhere), renamed
+// into place and their directories synced.  A crash leaves either the old
+// files or complete new ones, and no file pays for an fsync of its own.
+
+#ifdef __linux__
+#define _GNU_SOURCE // fallocate, copy_file_range, syncfs
+#else
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "output.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/xattr.h>
+#endif
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+// ============================================================================
+// Constants and Macros
+// ============================================================================
+
+// AppleDouble magic and version — appledouble.md § "File Identification"
+#define APPLEDOUBLE_MAGIC   0x00051607
+#define APPLEDOUBLE_VERSION 0x00020000
+
+// AppleDouble entry IDs — appledouble.md § "Standard Entry IDs"
+#define AD_ENTRY_FINDER_INFO 9
+#define AD_ENTRY_RSRC_FORK   2
+
+// Fixed sizes within the AppleDouble header (AD_FINDER_LEN is in output.h)
+#define AD_HEADER_SIZE 26 // magic(4) + version(4) + filler(16) + count(2)
+#define AD_ENTRY_SIZE  12 // id(4) + offset(4) + length(4)
+
+// Directory descriptors each writer keeps open (hash slots, and the most
+// held before the cache is emptied and refilled)
+#define DIR_CACHE_SLOTS 128
+#define DIR_CACHE_MAX   64
+
+// Extended attribute names for --xattr; Linux only lets unprivileged
+// processes set attributes in the user namespace
+#ifdef __linux__
+#define XATTR_FINDER_INFO   "user.com.apple.FinderInfo"
+#define XATTR_RESOURCE_FORK "user.com.apple.ResourceFork"
+#define mac_setxattr(fd, name, value, size) fsetxattr(fd, name, value, size, 0)
+#define mac_removexattr(fd, name)           fremovexattr(fd, name)
+#elif defined(__APPLE__)
+#define XATTR_FINDER_INFO   "com.apple.FinderInfo"
+#define XATTR_RESOURCE_FORK "com.apple.ResourceFork"
+#define mac_setxattr(fd, name, value, size) fsetxattr(fd, name, value, size, 0, 0)
+#define mac_removexattr(fd, name)           fremovexattr(fd, name, 0)
+#endif
+
+// Buffer for copying an extent when the kernel cannot do it in place
+#define COPY_CHUNK (64 * 1024)
+
+// Attempts at a free temporary name for a mapped output file
+#define TEMP_TRIES 100
+
+// FNV-1a parameters
+#define FNV_OFFSET 0xcbf29ce484222325u
+#define FNV_PRIME  0x100000001b3u
+
+// ============================================================================
+// Type Definitions (Private)
+// ============================================================================
+
+// Files write_forks() left under temporary names, for the caller to stage.
+typedef struct {
+    staged_file_t files[2]; // Data file and sidecar
+    size_t count;
+} staged_out_t;
+
+// One extracted file waiting to be written.
+typedef struct write_item {
+    struct write_item *next;
+    peel_file_t file; // Owned; released once written
+    const char *dir;
+    const char *input; // For error messages
+    write_source_t *src; // Referenced while the file has an extent fork
+    mapped_out_t mapped; // Where a sunk data fork lives (dfd -1 otherwise)
+    write_batch_t *batch; // Failures and staged files (under the pool lock)
+    size_t bytes; // Fork bytes in memory, counted against the backlog bound
+} write_item_t;
+
+// Input descriptor shared by the files queued from it.  refs is changed
+// under the pool lock.
+struct write_source {
+    int fd;
+    size_t refs;
+};
+
+// Output directories a writer has already created and opened, keyed by
+// path.  Files are then opened relative to these descriptors, so each
+// directory costs one mkdirat() per cache lifetime rather than a mkdir()
+// per path component per file.
+typedef struct {
+    char *path[DIR_CACHE_SLOTS];
+    int fd[DIR_CACHE_SLOTS];
+    size_t count;
+} dir_cache_t;
+
+// A writer thread and its FIFO of pending files.
+typedef struct {
+    pthread_t thread;
+    dir_cache_t dirs; // Used only by this thread
+    unsigned dir_epoch; // The pool's dir_epoch when dirs was last emptied
+    pthread_cond_t ready; // Signalled when the queue gains an item
+    write_item_t *head;
+    write_item_t *tail;
+    writer_pool_t *pool;
+} writer_t;
+
+// Writer threads plus the backlog accounting shared with submitters.
+struct writer_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t space; // Signalled when queued bytes drop
+    writer_t *writers;
+    size_t count; // Writer threads actually running
+    size_t queued_bytes;
+    size_t max_bytes;
+    bool closing;
+    dir_cache_t sync_dirs; // For synchronous writes; guarded by lock
+    unsigned dir_epoch; // Bumped by writer_pool_forget_dirs()
+    output_opts_t opts;
+};
+
+// Sequence number for temporary names of mapped output files
+static unsigned g_temp_seq;
+static pthread_mutex_t g_temp_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// ============================================================================
+// Static Helpers
+// ============================================================================
+
+// Write a 32-bit big-endian value to a byte pointer.
+static void put_be32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)(v);
+}
+
+// Write a 16-bit big-endian value to a byte pointer.
+static void put_be16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)(v);
+}
+
+// Recursively create all parent directories for the given file path.
+// Similar to `mkdir -p` on the parent directory.
+static bool ensure_parent_dirs(const char *path) {
+    char tmp[1024];
+    size_t len = strlen(path);
+    if (len >= sizeof(tmp)) {
+        return false;
+    }
+    memcpy(tmp, path, len + 1);
+
+    // Walk the path and create each directory component
+    for (size_t i = 1; i < len; i++) {
+        if (tmp[i] == '/') {
+            tmp[i] = '\0';
+            if (mkdir(tmp, 0755) != 0 && errno != EEXIST) {
+                return false;
+            }
+            tmp[i] = '/';
+        }
+    }
+    return true;
+}
+
+// FNV-1a over len bytes of p, continuing from h.
+static uint64_t fnv1a(uint64_t h, const char *p, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)p[i]) * FNV_PRIME;
+    }
+    return h;
+}
+
+// Close every cached directory descriptor.
+static void dir_cache_clear(dir_cache_t *c) {
+    for (size_t i = 0; i < DIR_CACHE_SLOTS; i++) {
+        if (c->path[i]) {
+            close(c->fd[i]);
+            free(c->path[i]);
+            c->path[i] = NULL;
+        }
+    }
+    c->count = 0;
+}
+
+// Return a descriptor for the directory named by the first len bytes of
+// path, creating it if needed.  The first root_len bytes name a directory
+// that already exists; components below it are created one at a time,
+// each relative to its parent's cached descriptor.  Returns -1 on failure.
+static int dir_cache_open(dir_cache_t *c, const char *path, size_t len, size_t root_len) {
+    size_t slot = (size_t)(fnv1a(FNV_OFFSET, path, len) % DIR_CACHE_SLOTS);
+    for (; c->path[slot]; slot = (slot + 1) % DIR_CACHE_SLOTS) {
+        if (strlen(c->path[slot]) == len && memcmp(c->path[slot], path, len) == 0) {
+            return c->fd[slot];
+        }
+    }
+
+    int fd;
+    if (len <= root_len) {
+        char root[CLI_PATH_MAX];
+        snprintf(root, sizeof(root), "%.*s", (int)len, path);
+        fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    } else {
+        // Split off the last component; its parent is opened (and cached) first
+        size_t slash = len;
+        while (slash > root_len && path[slash - 1] != '/') {
+            slash--;
+        }
+        int parent = dir_cache_open(c, path, slash > root_len ? slash - 1 : root_len, root_len);
+        if (parent < 0 || slash == len) {
+            return parent; // An empty component ("a//b") names the parent
+        }
+        char leaf[CLI_PATH_MAX];
+        snprintf(leaf, sizeof(leaf), "%.*s", (int)(len - slash), path + slash);
+        if (mkdirat(parent, leaf, 0755) != 0 && errno != EEXIST) {
+            return -1;
+        }
+        fd = openat(parent, leaf, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    if (fd < 0) {
+        return -1;
+    }
+
+    // A full cache is emptied; the parent descriptor is no longer needed.
+    // Caching the parents may have taken the slot found above, so probe again
+    if (c->count >= DIR_CACHE_MAX) {
+        dir_cache_clear(c);
+    }
+    slot = (size_t)(fnv1a(FNV_OFFSET, path, len) % DIR_CACHE_SLOTS);
+    while (c->path[slot]) {
+        slot = (slot + 1) % DIR_CACHE_SLOTS;
+    }
+    c->path[slot] = malloc(len + 1);
+    if (!c->path[slot]) {
+        close(fd);
+        return -1;
+    }
+    memcpy(c->path[slot], path, len);
+    c->path[slot][len] = '\0';
+    c->fd[slot] = fd;
+    c->count++;
+    return fd;
+}
+
+// Find the directory that dir/name goes into, creating it if needed.  The
+// joined path is left in path and *leaf points at its final component.
+// Returns the directory's descriptor, or -1 after printing why.
+static int open_parent(dir_cache_t *c, const char *dir, const char *name, char *path,
+                       size_t path_size, const char **leaf) {
+    if (!build_path(path, path_size, dir, name)) {
+        fprintf(stderr, "peeler: path too long for '%s'\n", name);
+        return -1;
+    }
+    const char *slash = strrchr(path, '/');
+    *leaf = slash + 1;
+    int dfd = dir_cache_open(c, path, (size_t)(slash - path), strlen(dir));
+    if (dfd < 0) {
+        fprintf(stderr, "peeler: cannot create directories for '%s'\n", name);
+    }
+    return dfd;
+}
+
+// Append the len bytes at offset off in src_fd to fd without passing them
+// through user space where the kernel allows it.
+static bool copy_extent(int src_fd, uint64_t off, uint64_t len, int fd) {
+    off_t pos = (off_t)off;
+#ifdef __linux__
+    while (len > 0) {
+        ssize_t n = copy_file_range(src_fd, &pos, fd, NULL, len, 0);
+        if (n <= 0) {
+            break; // Refused (e.g. EXDEV on old kernels): try sendfile()
+        }
+        len -= (uint64_t)n;
+    }
+    while (len > 0) {
+        ssize_t n = sendfile(fd, src_fd, &pos, len);
+        if (n <= 0) {
+            break;
+        }
+        len -= (uint64_t)n;
+    }
+#endif
+    // Last resort, and the only way elsewhere: through a bounce buffer
+    uint8_t buf[COPY_CHUNK];
+    while (len > 0) {
+        ssize_t n = pread(src_fd, buf, len < sizeof(buf) ? (size_t)len : sizeof(buf), pos);
+        if (n <= 0) {
+            return false;
+        }
+        struct iovec iov = {.iov_base = buf, .iov_len = (size_t)n};
+        if (!write_all(fd, &iov, 1)) {
+            return false;
+        }
+        pos += n;
+        len -= (uint64_t)n;
+    }
+    return true;
+}
+
+// Create a file with a free temporary name in directory dfd, leaving the
+// name in temp.  Returns its descriptor, or -1.
+static int open_temp(int dfd, char *temp, size_t temp_size) {
+    int fd = -1;
+    for (int i = 0; i < TEMP_TRIES && fd < 0; i++) {
+        pthread_mutex_lock(&g_temp_lock);
+        unsigned seq = g_temp_seq++;
+        pthread_mutex_unlock(&g_temp_lock);
+        snprintf(temp, temp_size, ".peeler-%ld-%u", (long)getpid(), seq);
+        fd = openat(dfd, temp, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd < 0 && errno != EEXIST) {
+            break;
+        }
+    }
+    if (fd < 0) {
+        temp[0] = '\0';
+    }
+    return fd;
+}
+
+// Record that path (in the same directory as parent_path's final
+// component) was written as temp, for publishing later.
+static void stage_file(staged_out_t *out, const char *parent_path, const char *leaf,
+                       const char *temp) {
+    const char *slash = strrchr(parent_path, '/');
+    int dir_len = (int)(slash - parent_path);
+    char buf[CLI_PATH_MAX];
+    staged_file_t *s = &out->files[out->count++];
+    snprintf(buf, sizeof(buf), "%.*s/%s", dir_len, parent_path, temp);
+    s->temp = strdup(buf);
+    snprintf(buf, sizeof(buf), "%.*s/%s", dir_len, parent_path, leaf);
+    s->path = strdup(buf);
+}
+
+// Create file leaf in directory dfd holding the concatenation of iov and,
+// if tail is an extent, its bytes copied from src_fd.  With temp, the file
+// is created under a fresh temporary name, left there, instead.  Returns
+// the still-open descriptor (-1 on failure, with nothing left behind under
+// a temporary name).  The final size is known up front, so it is reserved
+// first: the filesystem can lay the file out in one extent instead of
+// growing it write by write.
+static int create_file(int dfd, const char *leaf, char *temp, struct iovec *iov, int iovcnt,
+                       int src_fd, const peel_buf_t *tail) {
+    int fd = temp ? open_temp(dfd, temp, CLI_PATH_MAX)
+                  : openat(dfd, leaf, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    bool extent = tail && tail->extent && tail->size > 0;
+#ifdef __linux__
+    size_t len = extent ? tail->size : 0;
+    for (int i = 0; i < iovcnt; i++) {
+        len += iov[i].iov_len;
+    }
+    if (len > 0) {
+        fallocate(fd, 0, 0, (off_t)len); // Best-effort: unsupported filesystems just skip it
+    }
+#endif
+    if (!write_all(fd, iov, iovcnt) ||
+        (extent && (src_fd < 0 || !copy_extent(src_fd, tail->offset, tail->size, fd)))) {
+        close(fd);
+        if (temp) {
+            unlinkat(dfd, temp, 0);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+// Read an extent fork into memory, for the few writes that need its bytes
+// (extended attributes).  Returns false when it cannot be read.
+static bool load_extent(int src_fd, const peel_buf_t *b, peel_buf_t *out) {
+    uint8_t *data = malloc(b->size ? b->size : 1);
+    size_t got = 0;
+    while (data && src_fd >= 0 && got < b->size) {
+        ssize_t n = pread(src_fd, data + got, b->size - got, (off_t)(b->offset + got));
+        if (n <= 0) {
+            break;
+        }
+        got += (size_t)n;
+    }
+    if (!data || got < b->size) {
+        free(data);
+        return false;
+    }
+    *out = (peel_buf_t){.data = data, .size = b->size, .owned = true};
+    return true;
+}
+
+// Write an AppleDouble sidecar holding Finder info and the resource fork.
+// The sidecar is ._<leaf> beside the data fork (e.g. "dir/subdir/._file").
+// With staged, it is written under a temporary name and recorded there;
+// path is the data fork's path.
+static bool write_appledouble(int dfd, const char *path, const char *leaf, const peel_file_t *f,
+                              int src_fd, staged_out_t *staged) {
+    char sidecar[CLI_PATH_MAX];
+    int n = snprintf(sidecar, sizeof(sidecar), "._%s", leaf);
+    if (n <= 0 || (size_t)n >= sizeof(sidecar)) {
+        fprintf(stderr, "peeler: path too long for '._%s'\n", leaf);
+        return false;
+    }
+
+    // The header is built in place; the resource fork follows it straight
+    // from the decoded buffer
+    uint8_t hdr[AD_MAX_HEADER];
+    struct iovec iov[2];
+    iov[0] = (struct iovec){.iov_base = hdr, .iov_len = appledouble_header(f, hdr)};
+    iov[1] = (struct iovec){.iov_base = (void *)f->resource_fork.data,
+                            .iov_len = f->resource_fork.size};
+    bool inline_rsrc = f->resource_fork.size > 0 && !f->resource_fork.extent;
+    char temp[CLI_PATH_MAX];
+    int fd = create_file(dfd, sidecar, staged ? temp : NULL, iov, inline_rsrc ? 2 : 1, src_fd,
+                         &f->resource_fork);
+    if (fd < 0) {
+        return false;
+    }
+    if (close(fd) != 0) {
+        if (staged) {
+            unlinkat(dfd, temp, 0);
+        }
+        return false;
+    }
+    if (staged) {
+        stage_file(staged, path, sidecar, temp);
+    }
+    return true;
+}
+
+// Remove Finder info and resource fork attributes left on a reused output
+// file by an earlier run; O_TRUNC clears the data but not the attributes.
+static void clear_mac_xattrs(int fd) {
+#if defined(__linux__) || defined(__APPLE__)
+    mac_removexattr(fd, XATTR_FINDER_INFO);
+    mac_removexattr(fd, XATTR_RESOURCE_FORK);
+#else
+    (void)fd;
+#endif
+}
+
+// Attach Finder info and the resource fork to an open data file as
+// extended attributes.  Returns false, with nothing left attached, if the
+// platform or filesystem refuses either one (Linux caps a value at 64 KiB,
+// ext4 at about one block).
+static bool set_mac_xattrs(int fd, const peel_file_t *f) {
+#if defined(__linux__) || defined(__APPLE__)
+    uint8_t finder[AD_FINDER_LEN];
+    finder_info(f, finder);
+    if (mac_setxattr(fd, XATTR_FINDER_INFO, finder, sizeof(finder)) != 0) {
+        return false;
+    }
+    if (f->resource_fork.size > 0 &&
+        mac_setxattr(fd, XATTR_RESOURCE_FORK, f->resource_fork.data, f->resource_fork.size) != 0) {
+        mac_removexattr(fd, XATTR_FINDER_INFO);
+        return false;
+    }
+    return true;
+#else
+    (void)fd;
+    (void)f;
+    return false;
+#endif
+}
+
+// Put the mapped file behind a sunk data fork in place as dir entry leaf,
+// trimmed to the bytes actually decoded.  With temp, it is left under its
+// temporary name, which is copied there, for publishing later.  Returns its
+// descriptor, which the caller now owns, or -1 with the temporary file left
+// for discarding.
+static int place_mapped(mapped_out_t *m, const peel_buf_t *b, int dfd, const char *leaf,
+                        char *temp) {
+    int fd = m->fd;
+    m->fd = -1;
+    if ((b->size < b->cap && ftruncate(fd, (off_t)b->size) != 0) ||
+        (!temp && renameat(m->dfd, m->temp, dfd, leaf) != 0)) {
+        close(fd);
+        return -1;
+    }
+    if (temp) {
+        snprintf(temp, CLI_PATH_MAX, "%s", m->temp);
+    }
+    m->temp[0] = '\0'; // Renamed, or the caller's now: nothing left to remove
+    return fd;
+}
+
+// Write f into dir: the data fork always (even if empty — Mac archives
+// track files that have only a resource fork or metadata), and Finder info
+// plus resource fork either as extended attributes or in an AppleDouble
+// sidecar.  Extent forks are copied from src_fd; a sunk data fork is
+// already in the file mapped, which only needs renaming.  With durable
+// output the files stay under temporary names, recorded in staged.
+// Failures are reported against input; returns how many of the files could
+// not be written.
+static size_t write_forks(const output_opts_t *opts, dir_cache_t *dirs, const char *dir,
+                          const peel_file_t *f, int src_fd, mapped_out_t *mapped,
+                          const char *input, staged_out_t *staged) {
+    if (opts->tar_fd >= 0) {
+        if (!tar_write_file(opts->tar_fd, dir, f, opts->xattrs, opts->tar_mtime)) {
+            fprintf(stderr, "peeler: %s: failed to write '%s' to tar stream\n", input,
+                    f->meta.name);
+            return 1;
+        }
+        return 0;
+    }
+
+    const char *name = f->meta.name[0] ? f->meta.name : "unnamed";
+    bool meta = has_mac_metadata(f);
+    char path[CLI_PATH_MAX];
+    const char *leaf = NULL;
+    int dfd = open_parent(dirs, dir, name, path, sizeof(path), &leaf);
+
+    size_t failures = 0;
+    bool in_xattrs = false;
+    struct iovec iov = {.iov_base = (void *)f->data_fork.data, .iov_len = f->data_fork.size};
+    int iovcnt = iov.iov_len && !f->data_fork.extent ? 1 : 0;
+    char temp[CLI_PATH_MAX];
+    char *tempp = opts->durable ? temp : NULL;
+    int fd = -1;
+    if (dfd >= 0 && f->data_fork.sunk) {
+        fd = place_mapped(mapped, &f->data_fork, dfd, leaf, tempp);
+    } else if (dfd >= 0) {
+        fd = create_file(dfd, leaf, tempp, &iov, iovcnt, src_fd, &f->data_fork);
+    }
+    if (fd >= 0 && opts->xattrs) {
+        clear_mac_xattrs(fd);
+    }
+    if (fd >= 0 && meta && opts->xattrs) {
+        // An extended attribute needs the resource fork's bytes in hand
+        peel_file_t loaded = *f;
+        if (!f->resource_fork.extent ||
+            load_extent(src_fd, &f->resource_fork, &loaded.resource_fork)) {
+            in_xattrs = set_mac_xattrs(fd, &loaded);
+        }
+        if (f->resource_fork.extent) {
+            peel_free(&loaded.resource_fork);
+        }
+    }
+    if (fd < 0 || close(fd) != 0) {
+        fprintf(stderr, "peeler: %s: failed to write '%s'\n", input, f->meta.name);
+        failures++;
+        if (fd >= 0 && tempp) {
+            unlinkat(dfd, temp, 0);
+        }
+    } else if (tempp) {
+        stage_file(staged, path, leaf, temp);
+    }
+
+    // Files the xattrs could not hold fall back to a sidecar
+    if (meta && !in_xattrs &&
+        (dfd < 0 || !write_appledouble(dfd, path, leaf, f, src_fd, tempp ? staged : NULL))) {
+        fprintf(stderr, "peeler: %s: failed to write '._%s'\n", input, f->meta.name);
+        failures++;
+    }
+    return failures;
+}
+
+// Move the files in out to batch for publishing.  Returns how many could
+// not be recorded (out of memory); their temporary files are removed.
+// Called with the pool lock held.
+static size_t batch_stage(write_batch_t *batch, staged_out_t *out) {
+    size_t failures = 0;
+    for (size_t i = 0; i < out->count; i++) {
+        staged_file_t *s = &out->files[i];
+        if (s->temp && s->path && batch->staged_count == batch->staged_cap) {
+            size_t cap = batch->staged_cap ? batch->staged_cap * 2 : 64;
+            staged_file_t *tmp = realloc(batch->staged, cap * sizeof(*tmp));
+            if (tmp) {
+                batch->staged = tmp;
+                batch->staged_cap = cap;
+            }
+        }
+        if (!s->temp || !s->path || batch->staged_count == batch->staged_cap) {
+            if (s->temp) {
+                unlink(s->temp);
+            }
+            free(s->temp);
+            free(s->path);
+            failures++;
+            continue;
+        }
+        batch->staged[batch->staged_count++] = *s;
+    }
+    return failures;
+}
+
+// Order strings (for qsort).
+static int str_cmp(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Flush every staged file in batch to stable storage: the filesystem under
+// dir in one syncfs() where available, else each file's data in turn.
+// Returns false if any of it failed.
+static bool sync_staged(const write_batch_t *batch, const char *dir) {
+#ifdef __linux__
+    int root = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root >= 0) {
+        bool ok = syncfs(root) == 0;
+        close(root);
+        if (ok) {
+            return true;
+        }
+    }
+#endif
+    bool ok = true;
+    for (size_t i = 0; i < batch->staged_count; i++) {
+        int fd = open(batch->staged[i].temp, O_RDONLY | O_CLOEXEC);
+        if (fd < 0 || fdatasync(fd) != 0) {
+            ok = false;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    return ok;
+}
+
+// Sync the directories the staged files in batch were renamed into, and
+// their parents up to dir, so the new names survive a crash too.  Each
+// directory is synced once.  Returns false if any of it failed.
+static bool sync_parents(const write_batch_t *batch, const char *dir) {
+    size_t root_len = strlen(dir);
+    size_t count = 0, cap = 0;
+    char **dirs = NULL;
+    bool ok = true;
+    for (size_t i = 0; i < batch->staged_count && ok; i++) {
+        char *p = strdup(batch->staged[i].path);
+        for (char *slash = p ? strrchr(p, '/') : NULL; slash && ok; slash = strrchr(p, '/')) {
+            *slash = '\0';
+            if (strlen(p) < root_len) {
+                break;
+            }
+            if (count == cap) {
+                cap = cap ? cap * 2 : 64;
+                char **tmp = realloc(dirs, cap * sizeof(*tmp));
+                ok = tmp != NULL;
+                dirs = tmp ? tmp : dirs;
+            }
+            char *copy = ok ? strdup(p) : NULL;
+            ok = copy != NULL;
+            if (ok) {
+                dirs[count++] = copy;
+            }
+        }
+        ok = ok && p;
+        free(p);
+    }
+    qsort(dirs, count, sizeof(*dirs), str_cmp);
+    for (size_t i = 0; i < count; i++) {
+        if (ok && (i == 0 || strcmp(dirs[i], dirs[i - 1]) != 0)) {
+            int fd = open(dirs[i], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            ok = fd >= 0 && fsync(fd) == 0;
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        free(dirs[i]);
+    }
+    free(dirs);
+    return ok;
+}
+
+// Drop one reference to src (NULL is ignored), closing it with the last.
+// Called with the pool lock held.
+static void source_drop(write_source_t *src) {
+    if (src && --src->refs == 0) {
+        close(src->fd);
+        free(src);
+    }
+}
+
+// Hash the output directory and member name, to pick a writer.
+static size_t path_hash(const char *dir, const char *name) {
+    uint64_t h = fnv1a(FNV_OFFSET, dir, strlen(dir));
+    h = fnv1a(h, "/", 1);
+    return (size_t)fnv1a(h, name, strlen(name));
+}
+
+// Writer thread: write queued files until the pool closes and the queue is empty.
+static void *writer_main(void *arg) {
+    writer_t *w = arg;
+    writer_pool_t *pool = w->pool;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!w->head && !pool->closing) {
+            pthread_cond_wait(&w->ready, &pool->lock);
+        }
+        write_item_t *it = w->head;
+        if (!it) {
+            break; // Closing and drained
+        }
+        w->head = it->next;
+        if (!w->head) {
+            w->tail = NULL;
+        }
+        bool stale = w->dir_epoch != pool->dir_epoch;
+        w->dir_epoch = pool->dir_epoch;
+        pthread_mutex_unlock(&pool->lock);
+        if (stale) {
+            dir_cache_clear(&w->dirs);
+        }
+
+        staged_out_t staged = {0};
+        size_t failed = write_forks(&pool->opts, &w->dirs, it->dir, &it->file,
+                                    it->src ? it->src->fd : -1, &it->mapped, it->input, &staged);
+        if (it->file.data_fork.sunk) {
+            mapped_out_discard(&it->mapped, it->file.data_fork.data, it->file.data_fork.cap);
+        }
+        peel_free(&it->file.data_fork);
+        peel_free(&it->file.resource_fork);
+
+        pthread_mutex_lock(&pool->lock);
+        source_drop(it->src);
+        it->batch->failures += failed + batch_stage(it->batch, &staged);
+        it->batch->queued--;
+        pool->queued_bytes -= it->bytes;
+        pthread_cond_broadcast(&pool->space);
+        free(it);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    dir_cache_clear(&w->dirs);
+    return NULL;
+}
+
+// ============================================================================
+// Operations
+// ============================================================================
+
+// Write every iovec to fd with writev(), retrying short writes.  iov is
+// consumed in the process.
+bool write_all(int fd, struct iovec *iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t n = writev(fd, iov, iovcnt);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        // Skip the vectors written in full, then trim the partial one
+        size_t done = (size_t)n;
+        while (iovcnt > 0 && done >= iov->iov_len) {
+            done -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+    return true;
+}
+
+// True if f has anything beyond its data fork: a resource fork or Finder
+// metadata (type/creator/flags).
+bool has_mac_metadata(const peel_file_t *f) {
+    return f->resource_fork.size > 0 || f->meta.mac_type != 0 || f->meta.mac_creator != 0 ||
+           f->meta.finder_flags != 0;
+}
+
+// Fill the 32-byte Finder info block: type(4) + creator(4) + flags(2) +
+// padding(22).  appledouble.md § "Finder Info"
+void finder_info(const peel_file_t *f, uint8_t *out) {
+    memset(out, 0, AD_FINDER_LEN);
+    put_be32(out, f->meta.mac_type);
+    put_be32(out + 4, f->meta.mac_creator);
+    put_be16(out + 8, f->meta.finder_flags);
+}
+
+// Build everything in an AppleDouble file that precedes the resource fork
+// data into hdr (AD_MAX_HEADER bytes) and return its length.
+// Layout: [header][finder_entry_desc][rsrc_entry_desc][finder_data][rsrc_data]
+// appledouble.md § "Writing & Updating Rules"
+size_t appledouble_header(const peel_file_t *f, uint8_t *hdr) {
+    // Layout depends on whether resource fork data is present:
+    //   - With rsrc: header(26) + 2 descriptors(24) + FinderInfo(32) + rsrc data
+    //   - Without:   header(26) + 1 descriptor(12)  + FinderInfo(32)
+    bool has_rsrc = (f->resource_fork.size > 0);
+    size_t num_entries = has_rsrc ? 2 : 1;
+    uint32_t finder_offset = (uint32_t)(AD_HEADER_SIZE + num_entries * AD_ENTRY_SIZE);
+    uint32_t rsrc_offset = finder_offset + AD_FINDER_LEN;
+    memset(hdr, 0, finder_offset);
+
+    // Fixed header — appledouble.md § "Fixed Header"
+    uint8_t *p = hdr;
+    put_be32(p, APPLEDOUBLE_MAGIC);
+    p += 4;
+    put_be32(p, APPLEDOUBLE_VERSION);
+    p += 4;
+    // 16 bytes filler (already zero)
+    p += 16;
+    put_be16(p, (uint16_t)num_entries);
+    p += 2;
+
+    // Entry descriptor 1: Finder Info — appledouble.md § "Entry Descriptors"
+    put_be32(p, AD_ENTRY_FINDER_INFO);
+    p += 4;
+    put_be32(p, finder_offset);
+    p += 4;
+    put_be32(p, AD_FINDER_LEN);
+    p += 4;
+
+    // Entry descriptor 2: Resource Fork (only if present)
+    if (has_rsrc) {
+        put_be32(p, AD_ENTRY_RSRC_FORK);
+        p += 4;
+        put_be32(p, rsrc_offset);
+        p += 4;
+        put_be32(p, (uint32_t)f->resource_fork.size);
+        p += 4;
+    }
+
+    finder_info(f, hdr + finder_offset);
+    return rsrc_offset;
+}
+
+// Build a file path from directory and filename, writing into buf.
+// Returns false if the combined path would overflow the buffer.
+bool build_path(char *buf, size_t buf_size, const char *dir, const char *name) {
+    int n = snprintf(buf, buf_size, "%s/%s", dir, name);
+    return n > 0 && (size_t)n < buf_size;
+}
+
+// Create a directory and any missing parents.
+bool make_dirs(const char *dir) {
+    char path[CLI_PATH_MAX];
+    if (!build_path(path, sizeof(path), dir, ".") || !ensure_parent_dirs(path)) {
+        return false;
+    }
+    return mkdir(dir, 0755) == 0 || errno == EEXIST;
+}
+
+// Create name's file under dir as a temporary beside its final path,
+// reserve size bytes and map them.  Only a real reservation (fallocate) is
+// mapped, so running out of space fails here rather than as a fault while
+// the decoder writes into the mapping; without one this returns false and
+// the caller decodes into memory instead.
+bool mapped_out_create(mapped_out_t *m, const char *dir, const char *name, size_t size,
+                       uint8_t **data) {
+    char path[CLI_PATH_MAX];
+    if (!build_path(path, sizeof(path), dir, name)) {
+        return false;
+    }
+    *strrchr(path, '/') = '\0';
+    if (!make_dirs(path)) {
+        return false;
+    }
+    *m = (mapped_out_t){.dfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC), .fd = -1};
+    if (m->dfd < 0) {
+        return false;
+    }
+    m->fd = open_temp(m->dfd, m->temp, sizeof(m->temp));
+    if (m->fd < 0) {
+        mapped_out_discard(m, NULL, 0);
+        return false;
+    }
+
+    bool ok = false;
+#ifdef __linux__
+    ok = fallocate(m->fd, 0, 0, (off_t)size) == 0;
+#endif
+    void *p = MAP_FAILED;
+    if (ok && ftruncate(m->fd, (off_t)size) == 0) {
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, m->fd, 0);
+    }
+    if (p == MAP_FAILED) {
+        mapped_out_discard(m, NULL, 0);
+        return false;
+    }
+    *data = p;
+    return true;
+}
+
+// Unmap data, then close and (unless renamed into place) remove the file.
+void mapped_out_discard(mapped_out_t *m, uint8_t *data, size_t size) {
+    if (data) {
+        munmap(data, size);
+    }
+    if (m->fd >= 0) {
+        close(m->fd);
+    }
+    if (m->temp[0]) {
+        unlinkat(m->dfd, m->temp, 0);
+    }
+    if (m->dfd >= 0) {
+        close(m->dfd);
+    }
+    *m = (mapped_out_t){.dfd = -1, .fd = -1};
+}
+
+// Start up to `threads` writers.  A pool whose threads all fail to start
+// still works: submissions are then written on the caller's thread.
+writer_pool_t *writer_pool_start(size_t threads, size_t max_bytes, const output_opts_t *opts) {
+    writer_pool_t *pool = calloc(1, sizeof(*pool));
+    if (!pool) {
+        return NULL;
+    }
+    pool->writers = calloc(threads ? threads : 1, sizeof(writer_t));
+    if (!pool->writers) {
+        free(pool);
+        return NULL;
+    }
+    pool->max_bytes = max_bytes;
+    pool->opts = *opts;
+    if (opts->tar_fd >= 0) {
+        threads = 1; // One stream, written in order
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->space, NULL);
+    for (size_t i = 0; i < threads; i++) {
+        writer_t *w = &pool->writers[pool->count];
+        w->pool = pool;
+        pthread_cond_init(&w->ready, NULL);
+        if (pthread_create(&w->thread, NULL, writer_main, w) != 0) {
+            pthread_cond_destroy(&w->ready);
+            break;
+        }
+        pool->count++;
+    }
+    return pool;
+}
+
+// Wrap fd as an extent source holding one reference for its creator.
+write_source_t *write_source_new(int fd) {
+    write_source_t *src = malloc(sizeof(*src));
+    if (src) {
+        *src = (write_source_t){.fd = fd, .refs = 1};
+    }
+    return src;
+}
+
+// Drop the creator's reference; queued files may keep src open longer.
+void write_source_release(writer_pool_t *pool, write_source_t *src) {
+    pthread_mutex_lock(&pool->lock);
+    source_drop(src);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Queue *f for writing into dir, taking ownership of its forks.  Blocks
+// while the backlog is full; a file larger than the whole bound is still
+// accepted once the queue is empty.  Extents and sunk forks, already in
+// files rather than memory, cost nothing against the bound.
+void writer_pool_submit(writer_pool_t *pool, peel_file_t *f, const char *dir, const char *input,
+                        write_source_t *src, const mapped_out_t *mapped, write_batch_t *batch) {
+    mapped_out_t m = mapped ? *mapped : (mapped_out_t){.dfd = -1, .fd = -1};
+    write_item_t *it = pool->count ? malloc(sizeof(*it)) : NULL;
+    if (!it) {
+        // No writer threads (or no memory): write synchronously
+        staged_out_t staged = {0};
+        pthread_mutex_lock(&pool->lock);
+        batch->failures += write_forks(&pool->opts, &pool->sync_dirs, dir, f,
+                                       src ? src->fd : -1, &m, input, &staged);
+        batch->failures += batch_stage(batch, &staged);
+        pthread_mutex_unlock(&pool->lock);
+        if (f->data_fork.sunk) {
+            mapped_out_discard(&m, f->data_fork.data, f->data_fork.cap);
+        }
+        peel_free(&f->data_fork);
+        peel_free(&f->resource_fork);
+        return;
+    }
+    bool extent = f->data_fork.extent || f->resource_fork.extent;
+    bool in_file = f->data_fork.extent || f->data_fork.sunk;
+    *it = (write_item_t){.file = *f, .dir = dir, .input = input,
+                         .src = extent ? src : NULL, .mapped = m, .batch = batch,
+                         .bytes = (in_file ? 0 : f->data_fork.size) +
+                                  (f->resource_fork.extent ? 0 : f->resource_fork.size)};
+    memset(f, 0, sizeof(*f));
+
+    writer_t *w = &pool->writers[path_hash(dir, it->file.meta.name) % pool->count];
+    pthread_mutex_lock(&pool->lock);
+    while (pool->queued_bytes > 0 && pool->queued_bytes + it->bytes > pool->max_bytes) {
+        pthread_cond_wait(&pool->space, &pool->lock);
+    }
+    pool->queued_bytes += it->bytes;
+    batch->queued++;
+    if (it->src) {
+        it->src->refs++;
+    }
+    if (w->tail) {
+        w->tail->next = it;
+    } else {
+        w->head = it;
+    }
+    w->tail = it;
+    pthread_cond_signal(&w->ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Wait for batch's files, then (durable output) publish or delete them.  The
+// data goes to disk before any rename, so no new name can outlive a crash
+// without its contents; the renames then reach disk with their directories.
+void writer_pool_publish(writer_pool_t *pool, write_batch_t *batch, const char *dir, bool keep) {
+    pthread_mutex_lock(&pool->lock);
+    while (batch->queued > 0) {
+        pthread_cond_wait(&pool->space, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (batch->staged_count == 0) {
+        return;
+    }
+
+    // All or nothing: one file that could not be written discards the rest
+    keep = keep && batch->failures == 0;
+    if (keep && !sync_staged(batch, dir)) {
+        fprintf(stderr, "peeler: %s: cannot sync output files\n", dir);
+        batch->failures += batch->staged_count;
+        keep = false;
+    }
+    size_t renamed = 0;
+    for (size_t i = 0; i < batch->staged_count; i++) {
+        staged_file_t *s = &batch->staged[i];
+        if (keep && rename(s->temp, s->path) == 0) {
+            renamed++;
+        } else {
+            if (keep) {
+                fprintf(stderr, "peeler: cannot rename into '%s': %s\n", s->path,
+                        strerror(errno));
+                batch->failures++;
+            }
+            unlink(s->temp);
+        }
+    }
+    if (renamed > 0 && !sync_parents(batch, dir)) {
+        fprintf(stderr, "peeler: %s: cannot sync output directories\n", dir);
+        batch->failures++;
+    }
+    for (size_t i = 0; i < batch->staged_count; i++) {
+        free(batch->staged[i].temp);
+        free(batch->staged[i].path);
+    }
+    free(batch->staged);
+    batch->staged = NULL;
+    batch->staged_count = batch->staged_cap = 0;
+}
+
+// Have every writer drop its cached directory descriptors before its next
+// file, so directories removed and recreated since are looked up afresh.
+void writer_pool_forget_dirs(writer_pool_t *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->dir_epoch++;
+    dir_cache_clear(&pool->sync_dirs);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Write everything still queued, stop the writers and free the pool.
+void writer_pool_finish(writer_pool_t *pool) {
+    if (!pool) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->closing = true;
+    for (size_t i = 0; i < pool->count; i++) {
+        pthread_cond_signal(&pool->writers[i].ready);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = 0; i < pool->count; i++) {
+        pthread_join(pool->writers[i].thread, NULL);
+        pthread_cond_destroy(&pool->writers[i].ready);
+    }
+    dir_cache_clear(&pool->sync_dirs);
+    pthread_cond_destroy(&pool->space);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->writers);
+    free(pool);
+}
@@ -0,0 +1,242 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) pappadf
+
+// output.h
+// Writing extracted files to disk for the `peeler` CLI.
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "peeler.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/uio.h>
+
+// ============================================================================
+// Constants
+// ============================================================================
+
+// Longest path the CLI builds
+#define CLI_PATH_MAX 1024
+
+// Finder info block: FinderInfo(16) + ExtendedFinderInfo(16)
+#define AD_FINDER_LEN 32
+
+// Largest AppleDouble prefix before the resource fork data: header(26) +
+// two entry descriptors(24) + Finder info
+#define AD_MAX_HEADER (26 + 2 * 12 + AD_FINDER_LEN)
+
+// ============================================================================
+// Output Files — output.c
+// ============================================================================
+
+// How extracted files are stored.
+typedef struct {
+    // Finder info and resource fork as extended attributes of the data
+    // file (com.apple.FinderInfo / com.apple.ResourceFork) instead of an
+    // AppleDouble ._ sidecar.  Files the filesystem refuses still get one.
+    bool xattrs;
+    // >= 0: write one tar stream to this descriptor instead of files
+    int tar_fd;
+    // Modification time recorded for tar members (seconds since the epoch)
+    int64_t tar_mtime;
+    // Write files under temporary names and publish each input's files
+    // together with writer_pool_publish(): synced, then renamed into place
+    bool durable;
+} output_opts_t;
+
+// Writer threads that store extracted files while decoding continues.
+typedef struct writer_pool writer_pool_t;
+
+// An open input file that extent forks (peel_fd_each_extents()) are copied
+// from, kept open until every queued file referring to it is written.
+typedef struct write_source write_source_t;
+
+// A file written under a temporary name, waiting to be renamed to path.
+typedef struct {
+    char *temp;
+    char *path;
+} staged_file_t;
+
+// What happened to the files queued from one input.  Updated by the writers
+// under the pool lock; must stay valid until writer_pool_publish() or
+// writer_pool_finish().
+typedef struct {
+    size_t failures; // Files that could not be written
+    size_t queued; // Submitted but not yet written
+    staged_file_t *staged; // Durable output: written, not yet published
+    size_t staged_count;
+    size_t staged_cap;
+} write_batch_t;
+
+// An output file a data fork is decoded straight into (peel_fd_each_into()).
+// It is created under a temporary name beside its final path, sized and
+// mapped shared; the writer renames it into place once the file is queued.
+typedef struct {
+    int dfd; // Directory holding it
+    int fd; // The file itself (-1 once handed to a writer's close)
+    char temp[64]; // Its temporary name in dfd
+} mapped_out_t;
+
+// Write every iovec to fd with writev(), retrying short writes.  iov is
+// consumed in the process.
+bool write_all(int fd, struct iovec *iov, int iovcnt);
+
+// True if f has anything beyond its data fork: a resource fork or Finder
+// metadata (type/creator/flags).
+bool has_mac_metadata(const peel_file_t *f);
+
+// Fill the AD_FINDER_LEN-byte Finder info block for f.
+void finder_info(const peel_file_t *f, uint8_t *out);
+
+// Build the part of an AppleDouble file that precedes the resource fork
+// data into hdr (AD_MAX_HEADER bytes) and return its length.
+size_t appledouble_header(const peel_file_t *f, uint8_t *hdr);
+
+// Build a file path from directory and filename, writing into buf.
+// Returns false if the combined path would overflow the buffer.
+bool build_path(char *buf, size_t buf_size, const char *dir, const char *name);
+
+// Create a directory and any missing parents.
+bool make_dirs(const char *dir);
+
+// Create the file for member name under dir with room for size bytes and
+// map it writable into *data.  Returns false, leaving nothing behind, when
+// the file cannot be created, reserved or mapped.
+bool mapped_out_create(mapped_out_t *m, const char *dir, const char *name, size_t size,
+                       uint8_t **data);
+
+// Unmap the size bytes at data and drop the file if it was never renamed
+// into place.
+void mapped_out_discard(mapped_out_t *m, uint8_t *data, size_t size);
+
+// Start a pool of `threads` writers holding at most about max_bytes of
+// queued fork data.  Returns NULL when out of memory.
+writer_pool_t *writer_pool_start(size_t threads, size_t max_bytes, const output_opts_t *opts);
+
+// Wrap fd (ownership taken) as a source for extent forks.  Returns NULL,
+// leaving fd open, when out of memory.
+write_source_t *write_source_new(int fd);
+
+// Drop the creator's reference to src; its descriptor is closed once no
+// queued file still needs it.
+void write_source_release(writer_pool_t *pool, write_source_t *src);
+
+// Queue *f (ownership taken) for writing into dir.  Extent forks are copied
+// from src, which may be NULL when f has none; a sunk data fork is already
+// in the file mapped (NULL otherwise), which the writer renames into place.
+// Neither is supported in tar streams.  Write failures are reported on
+// stderr against input and counted in batch.
+void writer_pool_submit(writer_pool_t *pool, peel_file_t *f, const char *dir, const char *input,
+                        write_source_t *src, const mapped_out_t *mapped, write_batch_t *batch);
+
+// Wait until every file queued in batch is written.  With durable output,
+// then sync them to stable storage in one sweep and rename them into place
+// under dir, or with !keep (or if any file in batch failed) delete them
+// instead.  Failures are counted in batch.
+void writer_pool_publish(writer_pool_t *pool, write_batch_t *batch, const char *dir, bool keep);
+
+// Make every writer drop the directory descriptors it has cached before it
+// writes its next file.  Long-running callers call this between archives:
+// an output directory may be deleted and recreated meanwhile, and a cached
+// descriptor would keep pointing into the deleted one.
+void writer_pool_forget_dirs(writer_pool_t *pool);
+
+// Write everything still queued, stop the writers and free the pool.
+void writer_pool_finish(writer_pool_t *pool);
+
+// ============================================================================
+// Incremental Extraction — incremental.c
+// ============================================================================
+
+// The manifest a previous run left in an output directory, and the one this
+// run is building.
+typedef struct incr_state incr_state_t;
+
+// Load the manifest in dir (none yet is fine).  xattrs says how that run
+// stored Finder info.  Returns NULL when out of memory.
+incr_state_t *incr_open(const char *dir, bool xattrs);
+
+// Record entry for the new manifest and return true if it is unchanged
+// since the previous run and its output files are intact, so it need not be
+// decoded.
+bool incr_check(incr_state_t *st, const peel_entry_info_t *entry);
+
+// With ok, replace the manifest with this run's; otherwise remove it so the
+// next run extracts everything.  Frees st (NULL is ignored).
+void incr_close(incr_state_t *st, bool ok);
+
+// ============================================================================
+// Decode Reports — report.c
+// ============================================================================
+
+// What --manifest=json records about the files of one input.
+typedef struct report report_t;
+
+// Start an empty report for input, whose files go to out_dir.  Both strings
+// must outlive it.  Returns NULL when out of memory.
+report_t *report_new(const char *input, const char *out_dir);
+
+// Record f, produced as trace says (NULL if the library did not say).
+// Returns false when out of memory.
+bool report_add(report_t *r, const peel_file_t *f, const peel_trace_t *trace);
+
+// Write r's records (NULL: none) to out as JSON objects, each on a line of
+// its own and preceded by a comma unless *first, which is then cleared.
+// The caller writes the enclosing brackets.
+void report_write(const report_t *r, FILE *out, bool *first);
+
+// Free r (NULL is ignored).
+void report_free(report_t *r);
+
+// ============================================================================
+// Long-Running Modes — watch.c, serve.c
+// ============================================================================
+
+// Extract the archive at input into out_dir; returns true once all of its
+// files are in place.  Called on several threads at once.
+typedef bool (*extract_fn)(const char *input, const char *out_dir, void *ctx);
+
+// Check every member of the archive at input, writing one line per member
+// to out.  Returns false if anything failed.
+typedef bool (*verify_fn)(const char *input, FILE *out, void *ctx);
+
+// Block SIGINT and SIGTERM in the calling thread and every thread it starts
+// from now on, so that watch_run() and serve_run() receive them.  Call
+// before starting threads that will still be running then.
+void block_stop_signals(void);
+
+// Hand every regular file in in_dir, and each one later written or moved
+// there, to fn with out_dir/<name> as its output directory, on `workers`
+// threads.  Runs until SIGINT or SIGTERM (returns true) or until in_dir
+// cannot be watched any longer (returns false).
+bool watch_run(const char *in_dir, const char *out_dir, size_t workers, extract_fn fn, void *ctx);
+
+// What `peeler serve` does for the requests it does not answer itself.
+typedef struct {
+    extract_fn extract;
+    verify_fn verify;
+    void *ctx;
+} serve_ops_t;
+
+// Answer requests on a Unix domain socket created at socket_path, one
+// connection per worker thread at a time, until SIGINT or SIGTERM (returns
+// true).  Returns false if the socket cannot be set up.
+bool serve_run(const char *socket_path, size_t workers, const serve_ops_t *ops);
+
+// ============================================================================
+// Tar Streams — tar.c
+// ============================================================================
+
+// Append f to the tar stream on fd as member dir/name.  Finder info and
+// the resource fork follow as a ._ AppleDouble member, or with xattrs as
+// PAX SCHILY.xattr records on the file itself.
+bool tar_write_file(int fd, const char *dir, const peel_file_t *f, bool xattrs, int64_t mtime);
+
+// Write the end-of-archive marker.
+bool tar_write_end(int fd);
+
+#endif // OUTPUT_H
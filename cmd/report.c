@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) pappadf
+
+// report.c
+// Decode reports for the `peeler` CLI (`--manifest=json`).
+//
+// While an input is extracted, every file handed to the writers is recorded
+// with what the library's trace hook said about it: the layers it was
+// peeled out of and how long each took, the compression method of each
+// fork and whether a stored checksum covered them.  Once every input is
+// done the records are written to stdout as one JSON array, in input order
+// and, within an input, in the order the files were decoded.
+//
+// decode_ns is the time spent on the file itself: its forks for an archive
+// member, the innermost wrapper for a lone wrapped file.  bytes_per_sec
+// divides both decoded forks by it.  Wrapper layers above an archive are
+// shared by all of its members, so their times are repeated on each.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "output.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================================
+// Type Definitions (Private)
+// ============================================================================
+
+// One output file.
+typedef struct {
+    char *path;
+    uint64_t data_size;
+    uint64_t rsrc_size;
+    peel_trace_t trace; // Its strings are the library's, valid for good
+    bool traced; // The library said how it was produced
+} report_entry_t;
+
+// The files of one input, in decode order.
+struct report {
+    const char *input;
+    const char *out_dir;
+    report_entry_t *items;
+    size_t count;
+    size_t cap;
+};
+
+// ============================================================================
+// Static Helpers
+// ============================================================================
+
+// Write s as a JSON string.  Bytes outside printable ASCII are escaped
+// one by one: member names are Mac Roman, not UTF-8.
+static void json_string(FILE *out, const char *s) {
+    if (!s) {
+        fputs("null", out);
+        return;
+    }
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fprintf(out, "\\%c", *p);
+        } else if (*p < 0x20 || *p >= 0x7F) {
+            fprintf(out, "\\u%04x", *p);
+        } else {
+            fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// Write one record as a JSON object on a line of its own.
+static void json_entry(FILE *out, const report_t *r, const report_entry_t *e) {
+    fputs("  {\"input\": ", out);
+    json_string(out, r->input);
+    fputs(", \"path\": ", out);
+    json_string(out, e->path);
+    fprintf(out, ", \"data_size\": %" PRIu64 ", \"rsrc_size\": %" PRIu64 ", \"layers\": [",
+            e->data_size, e->rsrc_size);
+    const peel_trace_t *t = &e->trace;
+    for (size_t i = 0; i < t->count; i++) {
+        fputs(i ? ", {\"format\": " : "{\"format\": ", out);
+        json_string(out, t->layers[i].format);
+        fprintf(out, ", \"ns\": %" PRIu64 "}", t->layers[i].ns);
+    }
+    fputs("], \"data_method\": ", out);
+    json_string(out, t->data_method);
+    fputs(", \"rsrc_method\": ", out);
+    json_string(out, t->rsrc_method);
+    fprintf(out, ", \"crc\": \"%s\"", e->traced && t->crc_checked ? "ok" : "unchecked");
+
+    uint64_t ns = t->count ? t->layers[t->count - 1].ns : 0;
+    fprintf(out, ", \"decode_ns\": %" PRIu64 ", \"bytes_per_sec\": ", ns);
+    if (ns) {
+        double bytes = (double)(e->data_size + e->rsrc_size);
+        fprintf(out, "%.0f}", bytes * 1e9 / (double)ns);
+    } else {
+        fputs("null}", out);
+    }
+}
+
+// ============================================================================
+// Operations
+// ============================================================================
+
+// Start an empty report for input, whose files go to out_dir.
+report_t *report_new(const char *input, const char *out_dir) {
+    report_t *r = calloc(1, sizeof(*r));
+    if (r) {
+        r->input = input;
+        r->out_dir = out_dir;
+    }
+    return r;
+}
+
+// Record f, produced as trace says (NULL: unknown).
+bool report_add(report_t *r, const peel_file_t *f, const peel_trace_t *trace) {
+    if (r->count == r->cap) {
+        size_t cap = r->cap ? r->cap * 2 : 16;
+        report_entry_t *tmp = realloc(r->items, cap * sizeof(*tmp));
+        if (!tmp) {
+            return false;
+        }
+        r->items = tmp;
+        r->cap = cap;
+    }
+    char path[CLI_PATH_MAX];
+    const char *name = f->meta.name[0] ? f->meta.name : "unnamed";
+    report_entry_t e = {.data_size = f->data_fork.size, .rsrc_size = f->resource_fork.size,
+                        .traced = trace != NULL};
+    if (trace) {
+        e.trace = *trace;
+    }
+    if (!build_path(path, sizeof(path), r->out_dir, name)) {
+        snprintf(path, sizeof(path), "%s", name);
+    }
+    if (!(e.path = strdup(path))) {
+        return false;
+    }
+    r->items[r->count++] = e;
+    return true;
+}
+
+// Write every record in r as elements of a JSON array.
+void report_write(const report_t *r, FILE *out, bool *first) {
+    for (size_t i = 0; r && i < r->count; i++) {
+        fputs(*first ? "\n" : ",\n", out);
+        *first = false;
+        json_entry(out, r, &r->items[i]);
+    }
+}
+
+// Free r (NULL is ignored).
+void report_free(report_t *r) {
+    if (!r) {
+        return;
+    }
+    for (size_t i = 0; i < r->count; i++) {
+        free(r->items[i].path);
+    }
+    free(r->items);
+    free(r);
+}
@@ -0,0 +1,687 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) pappadf
+
+// serve.c
+// Local extraction server for the `peeler` CLI (`peeler serve <socket>`).
+//
+// One long-running process answers requests on a Unix domain socket, so a
+// front end pays neither process startup nor a fresh parse per request.
+// Archives that are listed or read from are kept open as lazy VFS trees
+// (peel_vfs_open()) with their decoded forks cached, and reused for as long
+// as the file on disk is unchanged; extraction shares one writer pool.
+//
+// The protocol is line-based.  A request is one line of tab-separated
+// fields:
+//
+//   list     <archive>                    every entry, one line each
+//   get      <archive> <path> [rsrc]      one fork of one entry, raw
+//   extract  <archive> <out-dir>          everything, durably (--durable)
+//   verify   <archive>                    one status line per member
+//
+// Every response starts with "ok\t<n>" or "error\t<n>".  After "ok" from
+// get, n raw bytes follow; otherwise n text lines (list entries, verify
+// lines, or error messages).  list entries read "dir\t<path>" or
+// "file\t<data-size>\t<rsrc-size>\t<path>".  Archive paths are resolved
+// against the server's working directory.  A connection may carry any
+// number of requests, answered in order.  Workers are handed one request at
+// a time: the accept loop polls every idle connection and queues it once a
+// request arrives, so -j bounds the requests answered at once, not the
+// clients connected.  If a get body cannot be sent in full, the server
+// closes the connection, so a client that sees end of file before n bytes
+// knows the body is short.
+
+#define _POSIX_C_SOURCE 200809L // getline, open_memstream, strdup
+
+#include "output.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// ============================================================================
+// Constants and Macros
+// ============================================================================
+
+// Archives kept open (at least one per worker), and the decoded fork
+// cache of each
+#define SERVE_ARCHIVES 16
+#define SERVE_CACHE    (64u << 20)
+
+// Pending connections the kernel holds while every worker is busy
+#define SERVE_BACKLOG 64
+
+// Fields in the longest request
+#define SERVE_MAX_FIELDS 4
+
+// Longest request line; a client that sends more without a newline is
+// disconnected
+#define SERVE_MAX_LINE (4 * CLI_PATH_MAX)
+
+// Bytes read from a fork per pread() while answering get
+#define SERVE_CHUNK (64u * 1024)
+
+// ============================================================================
+// Type Definitions (Private)
+// ============================================================================
+
+// An archive kept open between requests.  A VFS is not thread-safe, so its
+// users take turns on lock.
+typedef struct {
+    char *path; // As named in the request; NULL for a free slot
+    struct stat st; // Identity and version of the file opened
+    peel_vfs_t *vfs; // NULL until opened (by whoever holds lock first)
+    int users; // Requests holding or waiting for lock
+    uint64_t used; // Tick of the latest request, for eviction
+    pthread_mutex_t lock;
+} serve_archive_t;
+
+// A client connection.  At any time it is idle (polled by the accept
+// loop), queued, or held by one worker answering a request.
+typedef struct serve_conn {
+    struct serve_conn *next; // In the ready queue or the returned list
+    int fd;
+    FILE *out; // Responses; closing it closes fd
+    char *buf; // Bytes received and not yet answered
+    size_t len;
+    size_t cap;
+} serve_conn_t;
+
+// State shared by the accept loop and the workers.
+typedef struct server {
+    const serve_ops_t *ops;
+    serve_archive_t *archives;
+    size_t archive_count;
+    uint64_t tick;
+    serve_conn_t *head; // FIFO of connections with a request to answer
+    serve_conn_t *tail;
+    serve_conn_t *returned; // Answered connections for the loop to poll again
+    int notify; // Write end of the pipe that wakes the loop for returned
+    bool stopping;
+    pthread_mutex_t lock; // Guards everything above except archive locks
+    pthread_cond_t ready;
+} server_t;
+
+// ============================================================================
+// Static Helpers
+// ============================================================================
+
+// True if a and b describe the same version of the same file.
+static bool same_file(const struct stat *a, const struct stat *b) {
+    return a->st_dev == b->st_dev && a->st_ino == b->st_ino && a->st_size == b->st_size &&
+           a->st_mtime == b->st_mtime;
+}
+
+// Give up a slot taken with archive_acquire().
+static void archive_release(server_t *s, serve_archive_t *a) {
+    pthread_mutex_unlock(&a->lock);
+    pthread_mutex_lock(&s->lock);
+    a->users--;
+    pthread_mutex_unlock(&s->lock);
+}
+
+// Find or make the slot for the archive at path and take its lock.  A slot
+// whose file changed on disk is reopened.  Returns NULL with a message in
+// msg when the archive cannot be opened.
+static serve_archive_t *archive_acquire(server_t *s, const char *path, char *msg,
+                                        size_t msg_size) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        snprintf(msg, msg_size, "%s", strerror(errno));
+        return NULL;
+    }
+    pthread_mutex_lock(&s->lock);
+    serve_archive_t *a = NULL, *spare = NULL;
+    for (size_t i = 0; i < s->archive_count && !a; i++) {
+        serve_archive_t *c = &s->archives[i];
+        if (c->path && strcmp(c->path, path) == 0 && same_file(&c->st, &st)) {
+            a = c;
+        } else if (c->users == 0 &&
+                   (!spare || (spare->path && (!c->path || c->used < spare->used)))) {
+            spare = c; // A free slot, or else the least recently used idle one
+        }
+    }
+    if (!a) {
+        // Every worker holds at most one slot and there are more slots
+        // than workers, so an idle one is always left
+        a = spare;
+        peel_vfs_close(a->vfs);
+        free(a->path);
+        a->path = strdup(path);
+        a->st = st;
+        a->vfs = NULL;
+    }
+    a->users++;
+    a->used = ++s->tick;
+    pthread_mutex_unlock(&s->lock);
+
+    pthread_mutex_lock(&a->lock);
+    peel_err_t *err = NULL;
+    if (!a->vfs && a->path) {
+        a->vfs = peel_vfs_open_path(path, SERVE_CACHE, &err);
+    }
+    if (!a->vfs) {
+        snprintf(msg, msg_size, "%s", err ? peel_err_msg(err) : "out of memory");
+        peel_err_free(err);
+        archive_release(s, a);
+        return NULL;
+    }
+    return a;
+}
+
+// Send a response header followed by count text lines from body.
+static void reply(FILE *out, bool ok, size_t count, const char *body, size_t body_len) {
+    fprintf(out, "%s\t%zu\n", ok ? "ok" : "error", count);
+    if (body_len > 0) {
+        fwrite(body, 1, body_len, out);
+    }
+}
+
+// Send an error response with one message line.
+static void reply_error(FILE *out, const char *what, const char *msg) {
+    fprintf(out, "error\t1\n%s: %s\n", what, msg);
+}
+
+// Write one line per entry below dir (a directory path in vfs) to out,
+// counting them in *count.  Nested archives are not entered: that would
+// decode them.
+static bool list_dir(peel_vfs_t *vfs, const char *dir, FILE *out, size_t *count,
+                     peel_err_t **err) {
+    peel_vfs_dirent_t de;
+    for (size_t i = 0; peel_vfs_readdir(vfs, dir, i, &de, err); i++) {
+        char path[CLI_PATH_MAX];
+        int n = snprintf(path, sizeof(path), "%s%s%s", dir, dir[0] ? "/" : "", de.name);
+        peel_vfs_stat_t st;
+        if (n < 0 || (size_t)n >= sizeof(path) || !peel_vfs_stat(vfs, path, &st, err)) {
+            return false;
+        }
+        if (de.is_dir) {
+            fprintf(out, "dir\t%s\n", path);
+        } else {
+            fprintf(out, "file\t%llu\t%llu\t%s\n", (unsigned long long)st.data_size,
+                    (unsigned long long)st.rsrc_size, path);
+        }
+        (*count)++;
+        if (de.is_dir && !list_dir(vfs, path, out, count, err)) {
+            return false;
+        }
+    }
+    return *err == NULL;
+}
+
+// list <archive>
+static void serve_list(server_t *s, FILE *out, const char *input) {
+    char msg[256];
+    serve_archive_t *a = archive_acquire(s, input, msg, sizeof(msg));
+    if (!a) {
+        reply_error(out, input, msg);
+        return;
+    }
+    char *text = NULL;
+    size_t text_len = 0, count = 0;
+    FILE *mem = open_memstream(&text, &text_len);
+    peel_err_t *err = NULL;
+    bool ok = mem && list_dir(a->vfs, "", mem, &count, &err);
+    archive_release(s, a);
+    if (mem) {
+        fclose(mem);
+    }
+    if (ok) {
+        reply(out, true, count, text, text_len);
+    } else {
+        reply_error(out, input, err ? peel_err_msg(err) : "out of memory");
+    }
+    peel_err_free(err);
+    free(text);
+}
+
+// get <archive> <path> [rsrc]
+// Returns false if the body came up short and the connection must close.
+static bool serve_get(server_t *s, FILE *out, const char *input, const char *path,
+                      const char *fork) {
+    peel_fork_t which = fork && strcmp(fork, "rsrc") == 0 ? PEEL_FORK_RESOURCE : PEEL_FORK_DATA;
+    char msg[256];
+    serve_archive_t *a = archive_acquire(s, input, msg, sizeof(msg));
+    if (!a) {
+        reply_error(out, input, msg);
+        return true;
+    }
+    peel_err_t *err = NULL;
+    peel_vfs_stat_t st;
+    peel_vfs_file_t *f = NULL;
+    if (peel_vfs_stat(a->vfs, path, &st, &err) && !st.is_dir) {
+        f = peel_vfs_open_file(a->vfs, path, which, &err);
+    }
+    if (!f) {
+        reply_error(out, path, err ? peel_err_msg(err) : "is a directory");
+        peel_err_free(err);
+        archive_release(s, a);
+        return true;
+    }
+    uint64_t size = which == PEEL_FORK_DATA ? st.data_size : st.rsrc_size;
+    fprintf(out, "ok\t%llu\n", (unsigned long long)size);
+    uint8_t *buf = malloc(SERVE_CHUNK);
+    uint64_t off = 0;
+    while (off < size) {
+        size_t n = buf ? peel_vfs_pread(f, buf, SERVE_CHUNK, off) : 0;
+        if (n == 0 || fwrite(buf, 1, n, out) != n) {
+            break;
+        }
+        off += n;
+    }
+    free(buf);
+    peel_vfs_close_file(f);
+    archive_release(s, a);
+    return off == size;
+}
+
+// extract <archive> <out-dir>
+static void serve_extract(server_t *s, FILE *out, const char *input, const char *out_dir) {
+    if (s->ops->extract(input, out_dir, s->ops->ctx)) {
+        reply(out, true, 0, NULL, 0);
+    } else {
+        reply_error(out, input, "extraction failed (details in the server log)");
+    }
+}
+
+// verify <archive>
+static void serve_verify(server_t *s, FILE *out, const char *input) {
+    char *text = NULL;
+    size_t text_len = 0, count = 0;
+    FILE *mem = open_memstream(&text, &text_len);
+    if (!mem) {
+        reply_error(out, input, strerror(errno));
+        return;
+    }
+    bool ok = s->ops->verify(input, mem, s->ops->ctx);
+    fclose(mem);
+    for (size_t i = 0; i < text_len; i++) {
+        count += text[i] == '\n';
+    }
+    if (count == 0) {
+        reply_error(out, input, "cannot verify (details in the server log)");
+    } else {
+        reply(out, ok, count, text, text_len);
+    }
+    free(text);
+}
+
+// Answer one request line (newline stripped).  Returns false if the
+// connection must be closed.
+static bool serve_request(server_t *s, FILE *out, char *line) {
+    char *fields[SERVE_MAX_FIELDS + 1];
+    size_t n = 0;
+    for (char *p = line; n <= SERVE_MAX_FIELDS;) {
+        fields[n++] = p;
+        p = strchr(p, '\t');
+        if (!p) {
+            break;
+        }
+        *p++ = '\0';
+    }
+    const char *cmd = fields[0];
+    if (strcmp(cmd, "list") == 0 && n == 2) {
+        serve_list(s, out, fields[1]);
+    } else if (strcmp(cmd, "get") == 0 && (n == 3 || n == 4)) {
+        return serve_get(s, out, fields[1], fields[2], n == 4 ? fields[3] : NULL);
+    } else if (strcmp(cmd, "extract") == 0 && n == 3) {
+        serve_extract(s, out, fields[1], fields[2]);
+    } else if (strcmp(cmd, "verify") == 0 && n == 2) {
+        serve_verify(s, out, fields[1]);
+    } else {
+        reply_error(out, cmd, "bad request");
+    }
+    return true;
+}
+
+// Wrap an accepted socket.  Returns NULL (closing fd) when out of memory.
+static serve_conn_t *conn_new(int fd) {
+    serve_conn_t *c = calloc(1, sizeof(*c));
+    FILE *out = c ? fdopen(fd, "w") : NULL;
+    if (!out) {
+        free(c);
+        close(fd);
+        return NULL;
+    }
+    c->fd = fd;
+    c->out = out;
+    return c;
+}
+
+// Close a connection and free it.
+static void conn_close(serve_conn_t *c) {
+    fclose(c->out);
+    free(c->buf);
+    free(c);
+}
+
+// Length of the first complete request line in c's buffer, newline
+// included, or 0 if none has arrived yet.
+static size_t conn_line(const serve_conn_t *c) {
+    const char *nl = c->len ? memchr(c->buf, '\n', c->len) : NULL;
+    return nl ? (size_t)(nl - c->buf) + 1 : 0;
+}
+
+// Answer the next request on c, reading it first if it is not buffered
+// yet.  Returns false if the connection must be closed: the client hung
+// up, sent an overlong line, or could not be sent a full response.
+static bool conn_step(server_t *s, serve_conn_t *c) {
+    size_t n = conn_line(c);
+    if (n == 0) {
+        // The loop saw the socket readable, so one read() does not block
+        if (c->cap - c->len < SERVE_CHUNK) {
+            size_t cap = c->len + SERVE_CHUNK;
+            char *buf = realloc(c->buf, cap);
+            if (!buf) {
+                return false;
+            }
+            c->buf = buf;
+            c->cap = cap;
+        }
+        ssize_t got = read(c->fd, c->buf + c->len, c->cap - c->len);
+        if (got <= 0) {
+            return got < 0 && errno == EINTR;
+        }
+        c->len += (size_t)got;
+        n = conn_line(c);
+        if (n == 0) {
+            return c->len <= SERVE_MAX_LINE; // The rest of the line is to come
+        }
+    }
+    c->buf[n - 1] = '\0';
+    bool more = serve_request(s, c->out, c->buf);
+    memmove(c->buf, c->buf + n, c->len - n);
+    c->len -= n;
+    return fflush(c->out) == 0 && more;
+}
+
+// Worker thread: answer one request at a time until the server stops.  A
+// connection with another request already buffered goes straight back on
+// the queue; otherwise the accept loop polls it again.
+static void *serve_worker(void *arg) {
+    server_t *s = arg;
+    pthread_mutex_lock(&s->lock);
+    for (;;) {
+        while (!s->head && !s->stopping) {
+            pthread_cond_wait(&s->ready, &s->lock);
+        }
+        if (s->stopping) {
+            break;
+        }
+        serve_conn_t *c = s->head;
+        s->head = c->next;
+        if (!s->head) {
+            s->tail = NULL;
+        }
+        pthread_mutex_unlock(&s->lock);
+        bool keep = conn_step(s, c);
+        pthread_mutex_lock(&s->lock);
+        if (!keep || s->stopping) {
+            conn_close(c);
+        } else if (conn_line(c) > 0) {
+            c->next = NULL;
+            if (s->tail) {
+                s->tail->next = c;
+            } else {
+                s->head = c;
+            }
+            s->tail = c;
+        } else {
+            c->next = s->returned;
+            s->returned = c;
+            char b = 0;
+            ssize_t w = write(s->notify, &b, 1);
+            (void)w; // The pipe is already full of wake-ups: the loop will look
+        }
+    }
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+// Signal thread: wait for SIGINT or SIGTERM (blocked everywhere else), then
+// wake the accept loop through the pipe whose write end is arg.
+static void *serve_signals(void *arg) {
+    int fd = *(int *)arg;
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGINT);
+    sigaddset(&sigs, SIGTERM);
+    int sig;
+    sigwait(&sigs, &sig);
+    char c = 0;
+    ssize_t n = write(fd, &c, 1);
+    (void)n; // Nothing to do if the loop cannot be woken
+    return NULL;
+}
+
+// Create the listening socket at path.  A stale socket left there by an
+// earlier server is replaced; anything else is not.  Only the owner may
+// connect.
+static int serve_listen(const char *path) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path);
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    mode_t old = umask(077);
+    bool ok = bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+    umask(old);
+    if (!ok || listen(fd, SERVE_BACKLOG) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+// ============================================================================
+// Operations
+// ============================================================================
+
+// Serve on socket_path until a signal stops the server.
+bool serve_run(const char *socket_path, size_t workers, const serve_ops_t *ops) {
+    // A client hanging up mid-response must not end the server
+    struct sigaction ign = {.sa_handler = SIG_IGN};
+    sigaction(SIGPIPE, &ign, NULL);
+    block_stop_signals();
+
+    int lfd = serve_listen(socket_path);
+    int wake[2] = {-1, -1};
+    if (lfd < 0 || pipe(wake) != 0) {
+        fprintf(stderr, "peeler: cannot listen on '%s': %s\n", socket_path, strerror(errno));
+        if (lfd >= 0) {
+            close(lfd);
+            unlink(socket_path);
+        }
+        return false;
+    }
+
+    int note[2] = {-1, -1};
+    if (pipe(note) != 0 || fcntl(note[1], F_SETFL, O_NONBLOCK) != 0) {
+        fprintf(stderr, "peeler: %s: %s\n", socket_path, strerror(errno));
+        close(note[0]);
+        close(note[1]);
+        close(wake[0]);
+        close(wake[1]);
+        close(lfd);
+        unlink(socket_path);
+        return false;
+    }
+
+    server_t s = {.ops = ops, .archive_count = workers + SERVE_ARCHIVES, .notify = note[1]};
+    s.archives = calloc(s.archive_count, sizeof(*s.archives));
+    pthread_t *pool = calloc(workers, sizeof(*pool));
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_cond_init(&s.ready, NULL);
+    for (size_t i = 0; s.archives && i < s.archive_count; i++) {
+        pthread_mutex_init(&s.archives[i].lock, NULL);
+    }
+    size_t started = 0;
+    while (s.archives && pool && started < workers) {
+        if (pthread_create(&pool[started], NULL, serve_worker, &s) != 0) {
+            break;
+        }
+        started++;
+    }
+    pthread_t sig_thread;
+    bool listening =
+        started > 0 && pthread_create(&sig_thread, NULL, serve_signals, &wake[1]) == 0;
+    bool ok = listening;
+    if (!ok) {
+        fprintf(stderr, "peeler: cannot start workers\n");
+    }
+
+    // Idle connections, polled after the listening socket and both pipes
+    serve_conn_t **idle = NULL;
+    size_t idle_count = 0;
+    size_t idle_cap = 0;
+    struct pollfd *fds = malloc(3 * sizeof(*fds));
+    if (ok && !fds) {
+        fprintf(stderr, "peeler: %s\n", strerror(ENOMEM));
+        pthread_kill(sig_thread, SIGTERM); // Let the signal thread finish
+        ok = false;
+    }
+    while (ok) {
+        // Take back the connections the workers have answered
+        pthread_mutex_lock(&s.lock);
+        serve_conn_t *back = s.returned;
+        s.returned = NULL;
+        pthread_mutex_unlock(&s.lock);
+        while (back) {
+            serve_conn_t *c = back;
+            back = c->next;
+            if (idle_count == idle_cap) {
+                size_t cap = idle_cap ? 2 * idle_cap : 16;
+                serve_conn_t **grown = realloc(idle, cap * sizeof(*idle));
+                struct pollfd *more = grown ? realloc(fds, (cap + 3) * sizeof(*fds)) : NULL;
+                if (grown) {
+                    idle = grown;
+                }
+                if (!more) {
+                    conn_close(c);
+                    continue;
+                }
+                fds = more;
+                idle_cap = cap;
+            }
+            idle[idle_count++] = c;
+        }
+
+        fds[0] = (struct pollfd){.fd = lfd, .events = POLLIN};
+        fds[1] = (struct pollfd){.fd = wake[0], .events = POLLIN};
+        fds[2] = (struct pollfd){.fd = note[0], .events = POLLIN};
+        for (size_t i = 0; i < idle_count; i++) {
+            fds[i + 3] = (struct pollfd){.fd = idle[i]->fd, .events = POLLIN};
+        }
+        if (poll(fds, idle_count + 3, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "peeler: %s: %s\n", socket_path, strerror(errno));
+            pthread_kill(sig_thread, SIGTERM); // Let the signal thread finish
+            ok = false;
+            break;
+        }
+        if (fds[1].revents) {
+            break; // SIGINT or SIGTERM
+        }
+        if (fds[2].revents) {
+            char drain[64];
+            ssize_t n = read(note[0], drain, sizeof(drain));
+            (void)n; // Only the wake-up matters
+        }
+
+        // Queue every idle connection with a request (or a hang-up) waiting
+        pthread_mutex_lock(&s.lock);
+        size_t kept = 0;
+        for (size_t i = 0; i < idle_count; i++) {
+            serve_conn_t *c = idle[i];
+            if (!fds[i + 3].revents) {
+                idle[kept++] = c;
+                continue;
+            }
+            c->next = NULL;
+            if (s.tail) {
+                s.tail->next = c;
+            } else {
+                s.head = c;
+            }
+            s.tail = c;
+            pthread_cond_signal(&s.ready);
+        }
+        idle_count = kept;
+        pthread_mutex_unlock(&s.lock);
+
+        // A new connection starts idle; the next pass polls it
+        int cfd = fds[0].revents ? accept(lfd, NULL, NULL) : -1;
+        serve_conn_t *c = cfd >= 0 ? conn_new(cfd) : NULL;
+        if (c) {
+            pthread_mutex_lock(&s.lock);
+            c->next = s.returned;
+            s.returned = c;
+            pthread_mutex_unlock(&s.lock);
+        }
+    }
+    if (listening) {
+        pthread_join(sig_thread, NULL);
+    }
+
+    // Requests in progress are answered; then the workers drain out and
+    // every connection is closed
+    pthread_mutex_lock(&s.lock);
+    s.stopping = true;
+    pthread_cond_broadcast(&s.ready);
+    pthread_mutex_unlock(&s.lock);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(pool[i], NULL);
+    }
+    while (s.head) {
+        serve_conn_t *next = s.head->next;
+        conn_close(s.head);
+        s.head = next;
+    }
+    while (s.returned) {
+        serve_conn_t *next = s.returned->next;
+        conn_close(s.returned);
+        s.returned = next;
+    }
+    for (size_t i = 0; i < idle_count; i++) {
+        conn_close(idle[i]);
+    }
+    free(idle);
+    free(fds);
+    for (size_t i = 0; s.archives && i < s.archive_count; i++) {
+        peel_vfs_close(s.archives[i].vfs);
+        free(s.archives[i].path);
+        pthread_mutex_destroy(&s.archives[i].lock);
+    }
+    free(s.archives);
+    free(pool);
+    pthread_cond_destroy(&s.ready);
+    pthread_mutex_destroy(&s.lock);
+    close(note[0]);
+    close(note[1]);
+    close(wake[0]);
+    close(wake[1]);
+    close(lfd);
+    unlink(socket_path);
+    return ok;
+}
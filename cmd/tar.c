@@ -0,0 +1,232 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) pappadf
+
+// tar.c
+// Streaming tar output for the `peeler` CLI (`--tar -`).
+//
+// Each extracted file becomes a POSIX ustar member as soon as it reaches
+// the writer, so a pipe consumer sees files while the archive is still
+// decoding and nothing touches the local filesystem.  Finder info and the
+// resource fork travel the same way they would on disk: as a ._ AppleDouble
+// member next to the file, or with --xattr as SCHILY.xattr records in a PAX
+// extended header, which GNU tar and libarchive both restore as extended
+// attributes.  Names longer than the 100-byte ustar field also go in the
+// PAX header.  Directories get no members of their own; extractors create
+// them from member paths.  Fork data is handed to writev() straight from
+// the decoded buffers.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "output.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// ============================================================================
+// Constants and Macros
+// ============================================================================
+
+#define TAR_BLOCK 512
+
+// ustar header field offsets and widths
+#define TAR_NAME     0
+#define TAR_NAME_LEN 100
+#define TAR_MODE     100
+#define TAR_UID      108
+#define TAR_GID      116
+#define TAR_SIZE     124
+#define TAR_MTIME    136
+#define TAR_CHKSUM   148
+#define TAR_TYPE     156
+#define TAR_MAGIC    257
+#define TAR_VERSION  263
+
+// Member types
+#define TAR_TYPE_FILE '0'
+#define TAR_TYPE_PAX  'x'
+
+// Largest size the 11 octal digits of the ustar size field can hold
+#define TAR_SIZE_MAX 077777777777ull
+
+// PAX records per header (path, size, FinderInfo, ResourceFork), and the
+// pieces each is written as: "<len> <key>=" prefix, value, newline
+#define PAX_MAX_RECORDS 4
+#define PAX_PREFIX_MAX  64
+
+// ============================================================================
+// Type Definitions (Private)
+// ============================================================================
+
+// A PAX extended header under construction, kept as iovecs so binary
+// values are written from where they already are.
+typedef struct {
+    char prefix[PAX_MAX_RECORDS][PAX_PREFIX_MAX];
+    struct iovec iov[PAX_MAX_RECORDS * 3];
+    int iovcnt;
+    size_t size;
+} pax_t;
+
+// ============================================================================
+// Static Helpers
+// ============================================================================
+
+// All-zero block, for padding and the end-of-archive marker.
+static const uint8_t g_zeros[TAR_BLOCK * 2];
+
+// Write v as a NUL-terminated octal number filling width bytes.  A value
+// too large for the field is clamped to the largest one that fits.
+static void put_octal(uint8_t *field, size_t width, uint64_t v) {
+    size_t digits = width - 1;
+    if (digits * 3 < 64 && v >> (digits * 3)) {
+        v = ((uint64_t)1 << (digits * 3)) - 1;
+    }
+    field[digits] = '\0';
+    while (digits > 0) {
+        field[--digits] = (uint8_t)('0' + (v & 7));
+        v >>= 3;
+    }
+}
+
+// Fill a ustar header block for a member of the given type and size.
+static void tar_header(uint8_t *hdr, const char *name, char type, uint64_t size, int64_t mtime) {
+    memset(hdr, 0, TAR_BLOCK);
+    size_t n = strlen(name);
+    memcpy(hdr + TAR_NAME, name, n < TAR_NAME_LEN ? n : TAR_NAME_LEN);
+    put_octal(hdr + TAR_MODE, 8, 0644);
+    put_octal(hdr + TAR_UID, 8, 0);
+    put_octal(hdr + TAR_GID, 8, 0);
+    put_octal(hdr + TAR_SIZE, 12, size <= TAR_SIZE_MAX ? size : 0);
+    put_octal(hdr + TAR_MTIME, 12, mtime > 0 ? (uint64_t)mtime : 0);
+    hdr[TAR_TYPE] = (uint8_t)type;
+    memcpy(hdr + TAR_MAGIC, "ustar", 6);
+    memcpy(hdr + TAR_VERSION, "00", 2);
+
+    // The checksum is computed with its own field read as spaces
+    memset(hdr + TAR_CHKSUM, ' ', 8);
+    unsigned sum = 0;
+    for (int i = 0; i < TAR_BLOCK; i++) {
+        sum += hdr[i];
+    }
+    snprintf((char *)hdr + TAR_CHKSUM, 8, "%06o", sum);
+    hdr[TAR_CHKSUM + 7] = ' ';
+}
+
+// Add the record "<len> <key>=<value>\n" to a PAX header.  len counts its
+// own digits, so it is found by iterating until the digit count settles.
+static void pax_add(pax_t *pax, const char *key, const void *value, size_t value_len) {
+    size_t body = 1 + strlen(key) + 1 + value_len + 1; // " key=" ... "\n"
+    size_t digits = 1;
+    while (snprintf(NULL, 0, "%zu", body + digits) != (int)digits) {
+        digits++;
+    }
+    char *prefix = pax->prefix[pax->iovcnt / 3];
+    int n = snprintf(prefix, PAX_PREFIX_MAX, "%zu %s=", body + digits, key);
+    pax->iov[pax->iovcnt++] = (struct iovec){.iov_base = prefix, .iov_len = (size_t)n};
+    pax->iov[pax->iovcnt++] = (struct iovec){.iov_base = (void *)value, .iov_len = value_len};
+    pax->iov[pax->iovcnt++] = (struct iovec){.iov_base = "\n", .iov_len = 1};
+    pax->size += body + digits;
+}
+
+// Write one member: an optional PAX header, the ustar header and the
+// contents given as iovecs, padded to a whole block.
+static bool tar_member(int fd, const char *name, pax_t *pax, struct iovec *body, int bodycnt,
+                       int64_t mtime) {
+    uint64_t size = 0;
+    for (int i = 0; i < bodycnt; i++) {
+        size += body[i].iov_len;
+    }
+    size_t name_len = strlen(name);
+    if (name_len > TAR_NAME_LEN) {
+        pax_add(pax, "path", name, name_len);
+    }
+    char size_text[24];
+    if (size > TAR_SIZE_MAX) {
+        snprintf(size_text, sizeof(size_text), "%llu", (unsigned long long)size);
+        pax_add(pax, "size", size_text, strlen(size_text));
+    }
+
+    uint8_t pax_hdr[TAR_BLOCK], hdr[TAR_BLOCK];
+    struct iovec iov[PAX_MAX_RECORDS * 3 + 8];
+    int n = 0;
+    if (pax->iovcnt > 0) {
+        tar_header(pax_hdr, "././@PaxHeader", TAR_TYPE_PAX, pax->size, mtime);
+        iov[n++] = (struct iovec){.iov_base = pax_hdr, .iov_len = TAR_BLOCK};
+        memcpy(iov + n, pax->iov, (size_t)pax->iovcnt * sizeof(struct iovec));
+        n += pax->iovcnt;
+        size_t pad = (TAR_BLOCK - pax->size % TAR_BLOCK) % TAR_BLOCK;
+        iov[n++] = (struct iovec){.iov_base = (void *)g_zeros, .iov_len = pad};
+    }
+    tar_header(hdr, name, TAR_TYPE_FILE, size, mtime);
+    iov[n++] = (struct iovec){.iov_base = hdr, .iov_len = TAR_BLOCK};
+    for (int i = 0; i < bodycnt; i++) {
+        iov[n++] = body[i];
+    }
+    iov[n++] = (struct iovec){.iov_base = (void *)g_zeros,
+                              .iov_len = (size_t)((TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK)};
+    return write_all(fd, iov, n);
+}
+
+// ============================================================================
+// Operations
+// ============================================================================
+
+// Append f to the tar stream as dir/name, with its Mac metadata.
+bool tar_write_file(int fd, const char *dir, const peel_file_t *f, bool xattrs, int64_t mtime) {
+    const char *name = f->meta.name[0] ? f->meta.name : "unnamed";
+
+    // Member paths are relative: an output root of "." adds nothing
+    while (dir[0] == '.' && dir[1] == '/') {
+        dir += 2;
+    }
+    char path[CLI_PATH_MAX];
+    int n = (dir[0] == '\0' || strcmp(dir, ".") == 0)
+                ? snprintf(path, sizeof(path), "%s", name)
+                : snprintf(path, sizeof(path), "%s/%s", dir, name);
+    if (n <= 0 || (size_t)n >= sizeof(path)) {
+        fprintf(stderr, "peeler: path too long for '%s'\n", name);
+        return false;
+    }
+
+    bool meta = has_mac_metadata(f);
+    pax_t pax = {0};
+    uint8_t finder[AD_FINDER_LEN];
+    if (meta && xattrs) {
+        finder_info(f, finder);
+        pax_add(&pax, "SCHILY.xattr.com.apple.FinderInfo", finder, sizeof(finder));
+        if (f->resource_fork.size > 0) {
+            pax_add(&pax, "SCHILY.xattr.com.apple.ResourceFork", f->resource_fork.data,
+                    f->resource_fork.size);
+        }
+    }
+    struct iovec data = {.iov_base = (void *)f->data_fork.data, .iov_len = f->data_fork.size};
+    if (!tar_member(fd, path, &pax, &data, 1, mtime)) {
+        return false;
+    }
+    if (!meta || xattrs) {
+        return true;
+    }
+
+    // AppleDouble member ._<leaf> beside the file, as on disk
+    char sidecar[CLI_PATH_MAX];
+    const char *slash = strrchr(path, '/');
+    n = slash ? snprintf(sidecar, sizeof(sidecar), "%.*s/._%s", (int)(slash - path), path,
+                         slash + 1)
+              : snprintf(sidecar, sizeof(sidecar), "._%s", path);
+    if (n <= 0 || (size_t)n >= sizeof(sidecar)) {
+        fprintf(stderr, "peeler: path too long for '._%s'\n", name);
+        return false;
+    }
+    uint8_t hdr[AD_MAX_HEADER];
+    struct iovec ad[2] = {
+        {.iov_base = hdr, .iov_len = appledouble_header(f, hdr)},
+        {.iov_base = (void *)f->resource_fork.data, .iov_len = f->resource_fork.size},
+    };
+    pax_t none = {0};
+    return tar_member(fd, sidecar, &none, ad, 2, mtime);
+}
+
+// Two zero blocks end a tar archive.
+bool tar_write_end(int fd) {
+    struct iovec iov = {.iov_base = (void *)g_zeros, .iov_len = sizeof(g_zeros)};
+    return write_all(fd, &iov, 1);
+}
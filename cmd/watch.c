@@ -0,0 +1,324 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) pappadf
+
+// watch.c
+// Directory ingestion for the `peeler` CLI (`peeler watch <indir> <outdir>`).
+//
+// One long-running process watches a directory with inotify and extracts
+// every archive that is closed after writing or moved into it, plus those
+// already there at startup.  Archives are queued for a fixed set of worker
+// threads that live as long as the process, sharing one writer pool and
+// its directory caches, so an archive costs its decode and nothing for
+// process or thread startup.  Each archive is extracted into
+// <outdir>/<name>.  The caller's extract function publishes the files of
+// an archive all together (--durable), so a consumer of outdir never sees
+// half an archive.  SIGINT or SIGTERM stops the watch: archives being
+// extracted are finished and the rest are left for the next start.
+//
+// Hidden files (".name") are ignored: uploaders such as rsync write to a
+// hidden temporary name and rename it into place when done.
+
+#define _GNU_SOURCE // inotify, signalfd
+
+#include "output.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+
+// ============================================================================
+// Type Definitions (Private)
+// ============================================================================
+
+// An archive waiting for a worker, or being extracted by one.
+typedef struct watch_item {
+    struct watch_item *next;
+    bool again; // Changed while being extracted: queue it once more after
+    char name[]; // Within the watched directory
+} watch_item_t;
+
+// State shared by the poll loop and the workers.
+typedef struct {
+    const char *in_dir;
+    const char *out_dir;
+    extract_fn fn;
+    void *ctx;
+    watch_item_t *head; // FIFO of archives not yet claimed
+    watch_item_t *tail;
+    watch_item_t *running; // Archives the workers are extracting now
+    bool stopping;
+    pthread_mutex_t lock; // Guards the queue, running, stopping and stdout
+    pthread_cond_t ready;
+} watch_t;
+
+// ============================================================================
+// Static Helpers
+// ============================================================================
+
+// Append it to the queue and wake a worker.  The caller holds w->lock.
+static void queue_append(watch_t *w, watch_item_t *it) {
+    it->next = NULL;
+    if (w->tail) {
+        w->tail->next = it;
+    } else {
+        w->head = it;
+    }
+    w->tail = it;
+    pthread_cond_signal(&w->ready);
+}
+
+// The item named name in list, or NULL.
+static watch_item_t *item_find(watch_item_t *list, const char *name) {
+    while (list && strcmp(list->name, name) != 0) {
+        list = list->next;
+    }
+    return list;
+}
+
+// Queue name for extraction unless it is hidden or already waiting.  An
+// archive being extracted has changed since it was claimed; it is queued
+// again once that extraction finishes, so two workers never write the same
+// output directory at once.
+static void watch_queue(watch_t *w, const char *name) {
+    if (name[0] == '.') {
+        return;
+    }
+    pthread_mutex_lock(&w->lock);
+    watch_item_t *busy = item_find(w->running, name);
+    if (busy) {
+        busy->again = true;
+    } else if (!item_find(w->head, name)) {
+        size_t len = strlen(name) + 1;
+        watch_item_t *it = malloc(sizeof(*it) + len);
+        if (!it) {
+            fprintf(stderr, "peeler: out of memory queueing '%s'\n", name);
+        } else {
+            it->again = false;
+            memcpy(it->name, name, len);
+            queue_append(w, it);
+        }
+    }
+    pthread_mutex_unlock(&w->lock);
+}
+
+// Queue every regular file already in the watched directory.
+static bool watch_scan(watch_t *w) {
+    DIR *d = opendir(w->in_dir);
+    if (!d) {
+        fprintf(stderr, "peeler: %s: %s\n", w->in_dir, strerror(errno));
+        return false;
+    }
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        char path[CLI_PATH_MAX];
+        struct stat st;
+        if (build_path(path, sizeof(path), w->in_dir, de->d_name) && stat(path, &st) == 0 &&
+            S_ISREG(st.st_mode)) {
+            watch_queue(w, de->d_name);
+        }
+    }
+    closedir(d);
+    return true;
+}
+
+// Extract one queued archive and report the outcome on stdout.
+static void watch_extract(watch_t *w, const char *name) {
+    char input[CLI_PATH_MAX], out_dir[CLI_PATH_MAX];
+    bool ok = false;
+    struct stat st;
+    if (!build_path(input, sizeof(input), w->in_dir, name) ||
+        !build_path(out_dir, sizeof(out_dir), w->out_dir, name)) {
+        fprintf(stderr, "peeler: path too long for '%s'\n", name);
+    } else if (stat(input, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return; // Removed or replaced since it was queued
+    } else {
+        ok = w->fn(input, out_dir, w->ctx);
+    }
+    pthread_mutex_lock(&w->lock);
+    printf("%-6s %s\n", ok ? "ok" : "FAILED", name);
+    fflush(stdout);
+    pthread_mutex_unlock(&w->lock);
+}
+
+// Worker thread: extract queued archives until the watch stops.
+static void *watch_worker(void *arg) {
+    watch_t *w = arg;
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (!w->head && !w->stopping) {
+            pthread_cond_wait(&w->ready, &w->lock);
+        }
+        if (w->stopping) {
+            break;
+        }
+        watch_item_t *it = w->head;
+        w->head = it->next;
+        if (!w->head) {
+            w->tail = NULL;
+        }
+        it->next = w->running;
+        w->running = it;
+        pthread_mutex_unlock(&w->lock);
+        watch_extract(w, it->name);
+        pthread_mutex_lock(&w->lock);
+        watch_item_t **link = &w->running;
+        while (*link != it) {
+            link = &(*link)->next;
+        }
+        *link = it->next;
+        if (it->again) {
+            it->again = false;
+            queue_append(w, it);
+        } else {
+            free(it);
+        }
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+// Queue the archives named by the inotify events in buf[0..len).  Returns
+// false once the watched directory itself is gone.
+static bool watch_events(watch_t *w, const char *buf, size_t len) {
+    bool alive = true;
+    for (size_t off = 0; off + sizeof(struct inotify_event) <= len;) {
+        const struct inotify_event *ev = (const struct inotify_event *)(buf + off);
+        if (ev->mask & IN_Q_OVERFLOW) {
+            watch_scan(w); // Events were lost: look at everything
+        } else if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+            alive = false;
+        } else if (ev->len > 0 && !(ev->mask & IN_ISDIR)) {
+            watch_queue(w, ev->name);
+        }
+        off += sizeof(*ev) + ev->len;
+    }
+    return alive;
+}
+
+// ============================================================================
+// Operations
+// ============================================================================
+
+// Watch in_dir until a signal stops it or the directory goes away.
+bool watch_run(const char *in_dir, const char *out_dir, size_t workers, extract_fn fn, void *ctx) {
+    watch_t w = {.in_dir = in_dir, .out_dir = out_dir, .fn = fn, .ctx = ctx};
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGINT);
+    sigaddset(&sigs, SIGTERM);
+    block_stop_signals(); // In case the caller had no threads to protect
+    int sfd = signalfd(-1, &sigs, SFD_CLOEXEC);
+    int ifd = inotify_init1(IN_CLOEXEC);
+    if (sfd < 0 || ifd < 0 ||
+        inotify_add_watch(ifd, in_dir,
+                          IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF |
+                              IN_ONLYDIR) < 0) {
+        fprintf(stderr, "peeler: cannot watch '%s': %s\n", in_dir, strerror(errno));
+        if (sfd >= 0) {
+            close(sfd);
+        }
+        if (ifd >= 0) {
+            close(ifd);
+        }
+        return false;
+    }
+    pthread_mutex_init(&w.lock, NULL);
+    pthread_cond_init(&w.ready, NULL);
+
+    // Watching before scanning: an archive landing in between is queued
+    // twice at worst, never missed
+    bool ok = watch_scan(&w);
+    pthread_t *threads = calloc(workers, sizeof(*threads));
+    size_t started = 0;
+    while (ok && threads && started < workers &&
+           pthread_create(&threads[started], NULL, watch_worker, &w) == 0) {
+        started++;
+    }
+    if (ok && started == 0) {
+        fprintf(stderr, "peeler: cannot start workers\n");
+        ok = false;
+    }
+
+    union {
+        struct inotify_event ev; // Alignment for the events read into bytes
+        char bytes[64 * 1024];
+    } buf;
+    bool running = ok;
+    while (running) {
+        struct pollfd fds[2] = {{.fd = ifd, .events = POLLIN}, {.fd = sfd, .events = POLLIN}};
+        if (poll(fds, 2, -1) < 0) {
+            running = errno == EINTR;
+            continue;
+        }
+        if (fds[1].revents) {
+            break; // SIGINT or SIGTERM
+        }
+        ssize_t n = read(ifd, buf.bytes, sizeof(buf.bytes));
+        if (n < 0 && errno != EINTR && errno != EAGAIN) {
+            fprintf(stderr, "peeler: %s: %s\n", in_dir, strerror(errno));
+            ok = running = false;
+        } else if (n > 0 && !watch_events(&w, buf.bytes, (size_t)n)) {
+            fprintf(stderr, "peeler: %s: watched directory went away\n", in_dir);
+            ok = running = false;
+        }
+    }
+
+    // Let the workers finish what they hold; drop what is still waiting
+    pthread_mutex_lock(&w.lock);
+    w.stopping = true;
+    pthread_cond_broadcast(&w.ready);
+    pthread_mutex_unlock(&w.lock);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    while (w.head) {
+        watch_item_t *next = w.head->next;
+        free(w.head);
+        w.head = next;
+    }
+    pthread_cond_destroy(&w.ready);
+    pthread_mutex_destroy(&w.lock);
+    close(ifd);
+    close(sfd);
+    return ok;
+}
+
+#else // !__linux__
+
+// No inotify: watching is not available.
+bool watch_run(const char *in_dir, const char *out_dir, size_t workers, extract_fn fn, void *ctx) {
+    (void)out_dir;
+    (void)workers;
+    (void)fn;
+    (void)ctx;
+    fprintf(stderr, "peeler: cannot watch '%s': needs inotify (Linux)\n", in_dir);
+    return false;
+}
+
+#endif // __linux__
+
+// Block the signals that stop a watch or a server.  They are then taken
+// from a descriptor (signalfd, or serve.c's sigwait thread), which only
+// works if no thread would take them first.
+void block_stop_signals(void) {
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGINT);
+    sigaddset(&sigs, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+}
@@ -18,6 +18,15 @@ extern "C" {
 #include <stddef.h>
 #include <stdint.h>
 
+// === Version ===
+
+// Library version.  Persistent caches are keyed on it, so any change to
+// decoder output must come with a version bump.
+#define PEEL_VERSION "0.1.0"
+
+// Version of the linked library (PEEL_VERSION at its build time).
+const char *peel_version(void);
+
 // === Error Handling ===
 
 // Opaque error object.  NULL means no error.
@@ -31,17 +40,126 @@ void peel_err_free(peel_err_t *err);
 
 // === Byte Buffer ===
 
+// Reference-counted backing store shared by several buffers (opaque).
+typedef struct peel_ref peel_ref_t;
+
 // A contiguous byte buffer with explicit ownership tracking.
 // Created by the library, freed by the caller via peel_free().
 typedef struct {
     uint8_t *data; // Pointer to contents (NULL when size == 0)
     size_t size; // Number of valid bytes
     bool owned; // If true, peel_free() will release data
+    size_t cap; // Allocated bytes behind data (0 if unknown); lets the pool recycle it
+    peel_ref_t *ref; // Shared backing (NULL = exclusively owned); data is read-only
+    bool partial; // Only a prefix was decoded (peel_prefix()); checksum not verified
+    bool extent; // Not loaded (peel_fd_each_extents()): data is NULL, the bytes are in the input
+    uint64_t offset; // With extent: where the bytes start in the input file
+    bool sunk; // In cap bytes acquired from a peel_sink_t; peel_free() leaves data alone
 } peel_buf_t;
 
 // Free the data inside a buffer (if owned) and zero the struct.
+// With the buffer pool enabled, the allocation may be recycled instead.
+// A shared buffer (ref != NULL) drops one reference; the backing store is
+// released with the last one, so shared buffers must go through peel_free().
 void peel_free(peel_buf_t *buf);
 
+// === Buffer Pool ===
+
+// Counters describing the buffer pool.
+typedef struct {
+    size_t cached_bytes; // Bytes currently held on free lists
+    size_t cached_buffers; // Buffers currently held on free lists
+    uint64_t hits; // Allocations served from a free list
+    uint64_t misses; // Allocations that fell through to malloc
+} peel_pool_stats_t;
+
+// Enable the opt-in buffer pool.  Owned buffers released through peel_free()
+// or peel_file_list_free() are kept on size-classed free lists (up to
+// max_cached bytes in total) and reused by later decodes.  Calling again
+// adjusts the limit.  The free lists are process-wide and guarded by one
+// mutex, so buffers may be allocated and freed from any thread.
+void peel_pool_enable(size_t max_cached);
+
+// Disable the pool and return every cached buffer to the system allocator.
+void peel_pool_disable(void);
+
+// Release cached buffers until at most keep_bytes remain cached.
+// Returns the number of bytes handed back to the system allocator.
+size_t peel_pool_trim(size_t keep_bytes);
+
+// Read the current pool counters into *out.
+void peel_pool_stats(peel_pool_stats_t *out);
+
+// === Dedupe Cache ===
+
+// Counters describing the dedupe cache.
+typedef struct {
+    uint64_t hits; // Forks served from a resident entry
+    uint64_t misses; // Forks that had to be decoded
+    uint64_t spill_hits; // Forks read back from the spill directory
+    uint64_t spills; // Forks written to the spill directory
+    size_t cached_bytes; // Decoded bytes currently resident
+    size_t cached_forks; // Forks currently resident
+} peel_dedupe_stats_t;
+
+// Enable the opt-in content-addressed fork cache.  Compressed forks are keyed
+// by format, method, lengths, stored CRC and the SHA-256 of the packed
+// bytes; a repeat of a known fork returns a shared buffer instead of
+// decoding again.
+// Up to max_bytes of decoded data stay resident.  If spill_dir is non-NULL,
+// evicted forks are written there and read back on later hits, so separate
+// runs can share them.  Calling again replaces the settings.  The key table
+// and LRU list are process-wide and guarded by one mutex, so any thread may
+// decode while the cache is enabled; shared forks may be freed on any thread.
+bool peel_dedupe_enable(size_t max_bytes, const char *spill_dir, peel_err_t **err);
+
+// Disable the cache and drop its references (buffers already handed out stay
+// valid).  Spill files are left in place.
+void peel_dedupe_disable(void);
+
+// Read the current dedupe counters into *out.
+void peel_dedupe_stats(peel_dedupe_stats_t *out);
+
+// === Result Cache ===
+
+// Storage backend for the persistent whole-result cache.  Keys are short
+// strings safe to use as file names.
+typedef struct {
+    // Return the entry stored under key, or an empty buffer on a miss.  The
+    // buffer must be owned or shared; the library releases it with peel_free().
+    peel_buf_t (*load)(void *ctx, const char *key);
+    // Save an entry under key.  Best-effort: failures are simply not cached.
+    void (*store)(void *ctx, const char *key, const uint8_t *data, size_t len);
+    void *ctx;
+} peel_cache_backend_t;
+
+// Counters describing the result cache.
+typedef struct {
+    uint64_t hits; // peel_path() calls answered from the cache
+    uint64_t misses; // Calls that had to decode
+    uint64_t stores; // Results handed to the backend
+} peel_cache_stats_t;
+
+// Enable the opt-in result cache with a caller-supplied backend.  peel_path()
+// then digests its input (together with the library version) and, on a hit,
+// returns the stored file list instead of decoding.  Pass NULL to disable.
+// The backend and counters are process-wide and guarded by one mutex, held
+// across each load() and store(): peel_path() may be called from any thread,
+// and the backend is never called concurrently.  It must not call back into
+// the result cache.
+void peel_cache_enable(const peel_cache_backend_t *backend);
+
+// Enable the result cache with the built-in backend: one file per input in
+// dir (which must exist), mapped with mmap() on a hit so cached forks are
+// not copied.  Safe to share between processes.
+bool peel_cache_enable_dir(const char *dir, peel_err_t **err);
+
+// Disable the result cache.  File lists already returned stay valid.
+void peel_cache_disable(void);
+
+// Read the current result cache counters into *out.
+void peel_cache_stats(peel_cache_stats_t *out);
+
 // === File Metadata ===
 
 // Metadata for a single file extracted from an archive.
@@ -67,15 +185,23 @@ typedef struct {
 // Flat list of files produced by archive extraction.
 typedef struct {
     peel_file_t *files; // Heap-allocated array of extracted files
-    int count; // Number of entries
+    size_t count; // Number of entries
 } peel_file_list_t;
 
 // Free every buffer in every file, then the array itself.  Zeroes the struct.
 void peel_file_list_free(peel_file_list_t *list);
 
+// === Streaming Extraction ===
+
+// Receives one extracted file at a time, in archive order.  The callee takes
+// ownership of *file (release its forks with peel_free()).  Return false to
+// stop iteration early.
+typedef bool (*peel_each_fn)(peel_file_t *file, void *ctx);
+
 // === Input Helpers ===
 
-// Read an entire file into an owned buffer.
+// Read an entire file into an owned buffer.  Pipes and FIFOs are read to
+// end of file.
 peel_buf_t peel_read_file(const char *path, peel_err_t **err);
 
 // Copy caller data into a new owned buffer.
@@ -92,15 +218,208 @@ peel_buf_t peel_buf_wrap(const void *src, size_t len);
 // Returns a short name ("hqx", "bin", "sit", "cpt") or NULL if unknown.
 const char *peel_detect(const uint8_t *src, size_t len);
 
+// Maximum number of layers reported by peel_probe_chain().
+#define PEEL_PROBE_MAX 8
+
+// One layer of a probed chain.
+typedef struct {
+    const char *format; // "hqx", "bin", "sit" (classic), "sit5" or "cpt"
+    uint64_t size; // Input length for the outermost layer; declared payload
+                   // length (from the enclosing wrapper's header) otherwise
+} peel_layer_t;
+
+// Layers found by peel_probe_chain(), outermost first.
+typedef struct {
+    size_t count;
+    peel_layer_t layers[PEEL_PROBE_MAX];
+} peel_chain_t;
+
+// Identify the full wrapper chain (e.g. hqx -> bin -> sit5) without peeling:
+// only wrapper headers and the first few KiB of each payload are decoded,
+// and at most 64 KiB of each layer is scanned for signatures, so the cost
+// is independent of input size.  Meant for routing and quota decisions;
+// peel() remains authoritative.  Returns out->count (0 if unrecognised).
+size_t peel_probe_chain(const uint8_t *src, size_t len, peel_chain_t *out);
+
+// === Cost Estimation ===
+
+// Predicted cost of one archive member.
+typedef struct {
+    peel_file_meta_t meta;
+    uint64_t raw_bytes; // Decoded size of both forks
+    uint64_t work_bytes; // Decoder working memory beyond the output (larger fork)
+    uint64_t cpu_ns; // Approximate decode time of both forks
+} peel_entry_cost_t;
+
+// Predicted cost of peel() on one input.
+typedef struct {
+    uint64_t peak_bytes; // Peak heap use of peel(), not counting the input
+    uint64_t output_bytes; // Total size of the returned forks
+    uint64_t cpu_ns; // Approximate total decode time (wrappers + members)
+    size_t count; // Archive members (0 if no archive was found)
+    peel_entry_cost_t *entries; // Members in archive order
+} peel_estimate_t;
+
+// Predict the peak memory and CPU time peel() would need, for admission
+// control and scheduling.  Wrapper sizes come from their headers and member
+// costs from archive catalogs (compression method, fork sizes, Arsenic block
+// size); no fork is decompressed.  A BinHex layer in front of an archive is
+// decoded to reach the catalog.  Times are calibrated on a ~3 GHz core and
+// only meaningful relative to each other; archives nested inside members
+// are not predicted.  Release with peel_estimate_free().
+bool peel_estimate(const uint8_t *src, size_t len, peel_estimate_t *out, peel_err_t **err);
+
+// Free the entries of an estimate and zero it.
+void peel_estimate_free(peel_estimate_t *est);
+
 // === Main Entry Points ===
 
 // Detect, peel all layers, return extracted files.
 // Handles arbitrarily nested formats (e.g. .sit.hqx).
 peel_file_list_t peel(const uint8_t *src, size_t len, peel_err_t **err);
 
-// Convenience: read the file at path, then peel().
+// Like peel(), but decode at most max_bytes of each extracted fork, for
+// sniffing magic numbers or previewing text without paying for whole forks.
+// Wrapper layers in front of an archive are still decoded in full.  A fork
+// cut short has partial set and its checksum is not verified; a fork that
+// fits within max_bytes is decoded and verified as usual.  Archive members
+// that are themselves wrapped are not peeled further when cut short.
+peel_file_list_t peel_prefix(const uint8_t *src, size_t len, size_t max_bytes, peel_err_t **err);
+
+// Convenience: read the file at path, then peel().  Consults the result
+// cache when one is enabled (peel_cache_enable()); a cached result holds
+// shared, read-only forks.
 peel_file_list_t peel_path(const char *path, peel_err_t **err);
 
+// Like peel(), but hand each extracted file to fn as soon as its forks are
+// decoded instead of collecting a list, so a caller can write out one file
+// while the next is decoding.  Files arrive in the order peel() lists them.
+void peel_each(const uint8_t *src, size_t len, peel_each_fn fn, void *ctx, peel_err_t **err);
+
+// Convenience: read the file at path, then peel_each().  The result cache is
+// not consulted.
+void peel_path_each(const char *path, peel_each_fn fn, void *ctx, peel_err_t **err);
+
+// Like peel_each() over the regular file open on fd, but a fork stored
+// verbatim in the file (StuffIt method 0, a MacBinary payload) is not copied
+// into memory.  It arrives as an extent: data is NULL, extent is set, and
+// offset/size locate its bytes in the file, for the caller to move with
+// copy_file_range() or sendfile().  Its checksum is still verified.  The
+// file is read with pread(), so the file position is untouched, and a file
+// truncated meanwhile fails with *err set rather than faulting.  fd stays
+// open and owned by the caller.
+void peel_fd_each_extents(int fd, peel_each_fn fn, void *ctx, peel_err_t **err);
+
+// What an archive's catalog says about one member, before any decoding.
+typedef struct {
+    peel_file_meta_t meta;
+    uint64_t data_len; // Decoded fork lengths
+    uint64_t rsrc_len;
+    uint32_t data_crc; // Stored checksums, format-specific (0 if none)
+    uint32_t rsrc_crc;
+} peel_entry_info_t;
+
+// One layer a delivered file was peeled out of.
+typedef struct {
+    const char *format; // "hqx", "bin", "sit", "sit5" or "cpt"
+    uint64_t ns; // Decode time: the whole layer for a wrapper, only this
+                 // file's forks for an archive (monotonic clock)
+} peel_trace_layer_t;
+
+// How one delivered file was produced.
+typedef struct {
+    size_t count; // Layers, outermost first (deeper ones are dropped)
+    peel_trace_layer_t layers[PEEL_PROBE_MAX];
+    const char *data_method; // Archive compression method of each fork, e.g.
+    const char *rsrc_method; // "lzw" or "arsenic"; NULL if empty or not archived
+    bool crc_checked; // Every fork was checked against a stored checksum
+} peel_trace_t;
+
+// Caller hooks for peel_fd_each_into() and peel_each_into().  acquire()
+// returns size writable bytes for the data fork of the member described by
+// meta (for example a shared mapping of the output file, already sized), or
+// NULL to let the library allocate as usual.  When decoding into the memory
+// fails, or the file is not delivered, the library hands it back through
+// discard().  skip(), if set, sees every archive member first and returns
+// true to leave it out without decoding either fork.  trace(), if set, is
+// told how each file was produced just before fn receives it.  Any hook
+// may be NULL.
+typedef struct {
+    uint8_t *(*acquire)(void *ctx, const peel_file_meta_t *meta, size_t size);
+    void (*discard)(void *ctx, uint8_t *data, size_t size);
+    bool (*skip)(void *ctx, const peel_entry_info_t *entry);
+    void (*trace)(void *ctx, const peel_file_t *file, const peel_trace_t *trace);
+    void *ctx;
+} peel_sink_t;
+
+// Like peel_each(), with the hooks in sink.
+void peel_each_into(const uint8_t *src, size_t len, const peel_sink_t *sink, peel_each_fn fn,
+                    void *ctx, peel_err_t **err);
+
+// Like peel_fd_each_extents(), but a compressed data fork whose length the
+// archive records is decoded straight into memory from sink (when acquire()
+// supplies it) instead of a library buffer.  Such a fork arrives with sunk
+// set: data points into the caller's memory, which stays the caller's to
+// release; size may be smaller than acquired only for a fork cut short.
+void peel_fd_each_into(int fd, const peel_sink_t *sink, peel_each_fn fn, void *ctx,
+                       peel_err_t **err);
+
+// === Verification ===
+
+// Outcome of verifying one archive member (or a lone wrapped file).
+typedef enum {
+    PEEL_VERIFY_OK, // Every fork decoded and matched its stored checksum
+    PEEL_VERIFY_UNCHECKED, // Decoded cleanly, but no stored checksum covers it
+    PEEL_VERIFY_FAILED, // Decoding failed or a checksum did not match
+} peel_verify_status_t;
+
+// Verification result for one member.
+typedef struct {
+    peel_file_meta_t meta;
+    peel_verify_status_t status;
+    char message[160]; // Why it failed (empty unless PEEL_VERIFY_FAILED)
+} peel_verify_entry_t;
+
+// Result of peel_verify(), members in archive order.
+typedef struct {
+    size_t count;
+    size_t failed; // Entries with PEEL_VERIFY_FAILED
+    peel_verify_entry_t *entries;
+} peel_verify_report_t;
+
+// Run every decoder and checksum peel() would, without keeping the output:
+// forks stream through a small fixed buffer into their checksums, so memory
+// stays flat however large the members are.  Wrapper layers in front of an
+// archive are still decoded whole (the archive needs random access).  Members
+// that are themselves archives are checked as bytes, not unpacked.  Returns
+// false only when the input cannot be walked at all, including input in no
+// recognised format; per-member failures are in the report.  Release with
+// peel_verify_free().
+bool peel_verify(const uint8_t *src, size_t len, peel_verify_report_t *out, peel_err_t **err);
+
+// Free the entries of a report and zero it.
+void peel_verify_free(peel_verify_report_t *report);
+
+// === Packed Results ===
+
+// Replace the contents of the regular file or memfd fd with list in packed
+// form: a metadata table followed by every fork, each aligned to 64 bytes.
+bool peel_pack(const peel_file_list_t *list, int fd, peel_err_t **err);
+
+// Pack list into a new anonymous memory file and return its descriptor
+// (close it when done), or -1 with *err set.  On Linux this is a memfd,
+// sealed against further modification; elsewhere an unlinked temp file.
+int peel_pack_memfd(const peel_file_list_t *list, peel_err_t **err);
+
+// Map a packed result from fd (e.g. a memfd received from another process)
+// and return its files.  The forks are zero-copy, read-only views into the
+// mapping; it stays mapped until the last fork is released with peel_free()
+// or peel_file_list_free().  fd may be closed right after the call.  Only a
+// memfd sealed against shrinking and writes, as peel_pack_memfd() makes on
+// Linux, is mapped; any other fd is read into memory and the views point
+// into that copy.
+peel_file_list_t peel_unpack_view(int fd, peel_err_t **err);
+
 // === Per-Format Entry Points (Wrappers: buf → buf) ===
 
 // BinHex 4.0 (.hqx) — peel wrapper, return data fork only.
@@ -120,9 +439,80 @@ peel_file_t peel_bin_file(const uint8_t *src, size_t len, peel_err_t **err);
 // StuffIt classic / SIT5 (.sit).
 peel_file_list_t peel_sit(const uint8_t *src, size_t len, peel_err_t **err);
 
+// StuffIt — decode entries as the catalog is walked, passing each file to fn
+// as soon as its forks are decoded.  No limit on the number of entries.
+void peel_sit_each(const uint8_t *src, size_t len, peel_each_fn fn, void *ctx, peel_err_t **err);
+
 // Compact Pro (.cpt).
 peel_file_list_t peel_cpt(const uint8_t *src, size_t len, peel_err_t **err);
 
+// Compact Pro — pass each file to fn as soon as its forks are decoded.
+void peel_cpt_each(const uint8_t *src, size_t len, peel_each_fn fn, void *ctx, peel_err_t **err);
+
+// === Virtual Filesystem ===
+
+// Lazily decoded, filesystem-style view of an archive.  Paths use '/' and
+// are relative to the archive root ("" or "/" is the root).  A file whose
+// data fork is itself a recognized format can be entered like a directory,
+// e.g. "outer/inner.sit.hqx/file".  Unrecognized top-level data appears as a
+// single file named "data".  Each handle keeps its own unlocked fork cache,
+// so use a given peel_vfs_t from one thread at a time.
+typedef struct peel_vfs peel_vfs_t;
+
+// An open fork within a VFS.
+typedef struct peel_vfs_file peel_vfs_file_t;
+
+// Selects one of a file's two forks.
+typedef enum {
+    PEEL_FORK_DATA,
+    PEEL_FORK_RESOURCE,
+} peel_fork_t;
+
+// Result of peel_vfs_stat().
+typedef struct {
+    bool is_dir; // Directory (no forks, no Finder info)
+    peel_file_meta_t meta; // Finder info; name is the last path component
+    uint64_t data_size; // Decoded data fork length
+    uint64_t rsrc_size; // Decoded resource fork length
+} peel_vfs_stat_t;
+
+// One directory entry returned by peel_vfs_readdir().
+typedef struct {
+    char name[256]; // Entry name (no path)
+    bool is_dir;
+} peel_vfs_dirent_t;
+
+// Open a VFS over an archive.  Takes ownership of *archive (zeroing it),
+// even on failure; use peel_buf_wrap() to lend a buffer that outlives the
+// VFS instead.  Wrappers are stripped now; archive members are only listed.
+// Decoded forks are cached up to cache_bytes (least recently used first out;
+// forks held open are never evicted).
+peel_vfs_t *peel_vfs_open(peel_buf_t *archive, size_t cache_bytes, peel_err_t **err);
+
+// Convenience: read the file at path, then peel_vfs_open().
+peel_vfs_t *peel_vfs_open_path(const char *path, size_t cache_bytes, peel_err_t **err);
+
+// Close a VFS and free all cached forks.  Close every open file first.
+void peel_vfs_close(peel_vfs_t *vfs);
+
+// Describe the file or directory at path.  Returns false on error.
+bool peel_vfs_stat(peel_vfs_t *vfs, const char *path, peel_vfs_stat_t *st, peel_err_t **err);
+
+// Fetch the index-th entry (0-based, archive order) of the directory at path.
+// Returns false past the last entry (with *err NULL) or on error.
+bool peel_vfs_readdir(peel_vfs_t *vfs, const char *path, size_t index, peel_vfs_dirent_t *out,
+                      peel_err_t **err);
+
+// Open one fork of the file at path, decoding it on a cache miss.
+peel_vfs_file_t *peel_vfs_open_file(peel_vfs_t *vfs, const char *path, peel_fork_t fork,
+                                    peel_err_t **err);
+
+// Copy up to n bytes from offset.  Returns bytes copied (0 at end of fork).
+size_t peel_vfs_pread(peel_vfs_file_t *f, void *buf, size_t n, uint64_t offset);
+
+// Close an open fork.  Its decoded bytes stay cached until evicted.
+void peel_vfs_close_file(peel_vfs_file_t *f);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,257 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) pappadf
+
+// cache.c
+// Opt-in persistent cache of whole peel_path() results.
+//
+// Mirrors of classic Mac software are re-ingested over and over, mostly
+// unchanged.  With a cache backend installed, peel_path() digests the input
+// bytes and looks the digest up before decoding anything.  A hit turns the
+// stored entry straight back into a file list; a miss peels normally and
+// saves the result.
+//
+// An entry is a small header naming the input (SHA-256 digest, length,
+// library version) followed by a packed file list (pack.c).  The key a
+// backend sees is derived from the same digest, but the header is what is
+// trusted: a lookup only hits when the stored digest matches in full.  The
+// built-in directory backend maps entries with mmap(), so the forks of a
+// cached result are views into the page cache rather than fresh
+// allocations.
+//
+// The backend and counters are guarded by one mutex, held across each
+// backend call so the backend is never swapped out from under one; packing
+// and unpacking happen outside it.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "internal.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ============================================================================
+// Constants and Macros
+// ============================================================================
+
+// Entry header: magic(8) + digest(32) + input length(8) + version(32) +
+// pad(48).  The size is a multiple of PACK_ALIGN so forks stay aligned in
+// the mapping.
+#define RC_MAGIC    "PEELRC02"
+#define RC_HDR_SIZE 128
+#define RC_VERSION_LEN 32
+
+// ============================================================================
+// Type Definitions (Private)
+// ============================================================================
+
+// Process-wide cache state, read and written under g_cache_lock.
+typedef struct {
+    bool enabled;
+    peel_cache_backend_t backend;
+    char *dir; // Directory of the built-in backend, or NULL
+    peel_cache_stats_t stats;
+} result_cache_t;
+
+// ============================================================================
+// Static Helpers
+// ============================================================================
+
+static result_cache_t g_cache;
+static pthread_mutex_t g_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Bump one of the counters.
+static void cache_count(uint64_t *counter) {
+    pthread_mutex_lock(&g_cache_lock);
+    (*counter)++;
+    pthread_mutex_unlock(&g_cache_lock);
+}
+
+// Drop the installed backend.  The caller holds g_cache_lock.
+static void cache_reset(void) {
+    free(g_cache.dir);
+    memset(&g_cache, 0, sizeof(g_cache));
+}
+
+// Build the path of an entry in the cache directory into dst.
+static void dir_entry_path(char *dst, size_t cap, const char *dir, const char *key) {
+    snprintf(dst, cap, "%s/%s.peel", dir, key);
+}
+
+// Built-in backend: map dir/<key>.peel read-only.
+static peel_buf_t dir_load(void *ctx, const char *key) {
+    char path[4096];
+    dir_entry_path(path, sizeof(path), ctx, key);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return (peel_buf_t){0};
+    }
+    peel_err_t *err = NULL;
+    peel_buf_t buf = buf_map_fd(fd, &err);
+    close(fd);
+    if (err) {
+        peel_err_free(err);
+    }
+    return buf;
+}
+
+// Built-in backend: write dir/<key>.peel via a temp file and rename, so a
+// concurrent reader never maps a partial entry.
+static void dir_store(void *ctx, const char *key, const uint8_t *data, size_t len) {
+    char path[4096], tmp[4096 + 32];
+    dir_entry_path(path, sizeof(path), ctx, key);
+    snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid());
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        return;
+    }
+    bool ok = fwrite(data, 1, len, f) == len;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp, path) != 0) {
+        remove(tmp);
+    }
+}
+
+// Fill the entry header for key into hdr.
+static void entry_header(uint8_t *hdr, const result_key_t *key) {
+    memset(hdr, 0, RC_HDR_SIZE);
+    memcpy(hdr, RC_MAGIC, 8);
+    memcpy(hdr + 8, key->digest, SHA256_LEN);
+    wr64be(hdr + 8 + SHA256_LEN, key->len);
+    strncpy((char *)hdr + 16 + SHA256_LEN, PEEL_VERSION, RC_VERSION_LEN - 1);
+}
+
+// ============================================================================
+// Operations (Internal)
+// ============================================================================
+
+// True when a result cache backend is installed.
+bool result_cache_active(void) {
+    pthread_mutex_lock(&g_cache_lock);
+    bool enabled = g_cache.enabled;
+    pthread_mutex_unlock(&g_cache_lock);
+    return enabled;
+}
+
+// Digest the input and name its cache entry.
+result_key_t result_cache_key(const uint8_t *src, size_t len) {
+    result_key_t k;
+    memset(&k, 0, sizeof(k));
+    sha256(src, len, k.digest);
+    k.len = len;
+    char hex[2 * SHA256_LEN + 1];
+    for (int i = 0; i < SHA256_LEN; i++) {
+        snprintf(hex + 2 * i, 3, "%02x", k.digest[i]);
+    }
+    snprintf(k.name, sizeof(k.name), "%s-%llx-v%s", hex, (unsigned long long)k.len,
+             PEEL_VERSION);
+    return k;
+}
+
+// Load and unpack a cached result.  Entries that do not match the key
+// exactly, or fail to unpack, count as misses.
+bool result_cache_lookup(const result_key_t *key, peel_file_list_t *out) {
+    pthread_mutex_lock(&g_cache_lock);
+    peel_buf_t entry = g_cache.enabled ? g_cache.backend.load(g_cache.backend.ctx, key->name)
+                                       : (peel_buf_t){0};
+    pthread_mutex_unlock(&g_cache_lock);
+    uint8_t want[RC_HDR_SIZE];
+    entry_header(want, key);
+    if (entry.size < RC_HDR_SIZE || memcmp(entry.data, want, RC_HDR_SIZE) != 0 ||
+        (entry.owned && !buf_make_shared(&entry))) {
+        peel_free(&entry);
+        cache_count(&g_cache.stats.misses);
+        return false;
+    }
+
+    // View the packed list in place; its forks share the entry's reference
+    peel_buf_t packed = {.data = entry.data + RC_HDR_SIZE, .size = entry.size - RC_HDR_SIZE,
+                         .ref = entry.ref};
+    peel_err_t *err = NULL;
+    peel_file_list_t list = unpack_file_list(&packed, &err);
+    peel_free(&entry);
+    if (err) {
+        peel_err_free(err);
+        cache_count(&g_cache.stats.misses);
+        return false;
+    }
+    *out = list;
+    cache_count(&g_cache.stats.hits);
+    return true;
+}
+
+// Pack a result behind its entry header and hand it to the backend.
+void result_cache_store(const result_key_t *key, const peel_file_list_t *list) {
+    if (list->count > UINT32_MAX) {
+        return;
+    }
+    size_t len = RC_HDR_SIZE + pack_size(list);
+    uint8_t *entry = malloc(len);
+    if (!entry) {
+        return;
+    }
+    entry_header(entry, key);
+    pack_into(list, entry + RC_HDR_SIZE);
+    pthread_mutex_lock(&g_cache_lock);
+    if (g_cache.enabled) {
+        g_cache.backend.store(g_cache.backend.ctx, key->name, entry, len);
+        g_cache.stats.stores++;
+    }
+    pthread_mutex_unlock(&g_cache_lock);
+    free(entry);
+}
+
+// ============================================================================
+// Operations (Public API)
+// ============================================================================
+
+// Install a caller-supplied storage backend.
+void peel_cache_enable(const peel_cache_backend_t *backend) {
+    pthread_mutex_lock(&g_cache_lock);
+    cache_reset();
+    if (backend && backend->load && backend->store) {
+        g_cache.backend = *backend;
+        g_cache.enabled = true;
+    }
+    pthread_mutex_unlock(&g_cache_lock);
+}
+
+// Install the built-in mmap directory backend.
+bool peel_cache_enable_dir(const char *dir, peel_err_t **err) {
+    *err = NULL;
+    struct stat st;
+    if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        *err = make_err("result cache: '%s' is not a directory", dir);
+        return false;
+    }
+    char *copy = malloc(strlen(dir) + 1);
+    if (!copy) {
+        *err = make_err("out of memory enabling result cache");
+        return false;
+    }
+    strcpy(copy, dir);
+    pthread_mutex_lock(&g_cache_lock);
+    cache_reset();
+    g_cache.dir = copy;
+    g_cache.backend = (peel_cache_backend_t){.load = dir_load, .store = dir_store, .ctx = copy};
+    g_cache.enabled = true;
+    pthread_mutex_unlock(&g_cache_lock);
+    return true;
+}
+
+// Remove the backend.  Results already handed out stay valid.
+void peel_cache_disable(void) {
+    pthread_mutex_lock(&g_cache_lock);
+    cache_reset();
+    pthread_mutex_unlock(&g_cache_lock);
+}
+
+// Snapshot the cache counters.
+void peel_cache_stats(peel_cache_stats_t *out) {
+    if (out) {
+        pthread_mutex_lock(&g_cache_lock);
+        *out = g_cache.stats;
+        pthread_mutex_unlock(&g_cache_lock);
+    }
+}
@@ -0,0 +1,429 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) pappadf
+
+// dedupe.c
+// Opt-in content-addressed cache of decoded forks.
+//
+// Software collections repeat the same installers and resource forks across
+// thousands of archives.  When the cache is enabled, every compressed fork is
+// keyed by (format, method, packed length, raw length, stored CRC, SHA-256
+// of the packed bytes).  A fork whose key has been seen before is not decoded
+// again: the caller receives another reference to the same shared buffer.
+//
+// Resident entries are bounded by a byte limit and evicted least recently
+// used first.  If a spill directory is configured, evicted forks are written
+// there and read back on a later hit, which also lets separate runs (or
+// processes) share decoded forks.  Each spill file ends in a trailer holding
+// the stored CRC and the SHA-256 of the decoded bytes, checked before reuse.
+// Evicted forks that were not spilled leave the key table entirely.
+//
+// The table, LRU list and counters are guarded by one mutex, held across a
+// lookup or store (including spill I/O), so any thread may decode.  Forks
+// are decoded outside it.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "internal.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+// ============================================================================
+// Constants and Macros
+// ============================================================================
+
+// Forks smaller than this are decoded directly; caching them costs more than
+// it saves.
+#define DEDUPE_MIN_RAW 4096
+
+// Initial slot count of the key table (power of two).
+#define DEDUPE_TABLE_INIT 256
+
+// Spill file trailer: stored CRC (4 bytes, big-endian) + SHA-256 of the
+// decoded fork.
+#define SPILL_TRAILER (4 + SHA256_LEN)
+
+// ============================================================================
+// Type Definitions (Private)
+// ============================================================================
+
+// One cached fork.
+typedef struct dedupe_entry {
+    dedupe_key_t key;
+    peel_buf_t buf; // Shared decoded fork (ref != NULL while resident)
+    bool used; // Slot occupied
+    bool spilled; // A copy exists in the spill directory
+    struct dedupe_entry *prev; // LRU neighbour towards most recently used
+    struct dedupe_entry *next; // LRU neighbour towards least recently used
+} dedupe_entry_t;
+
+// Process-wide cache state, read and written under g_dedupe_lock.
+typedef struct {
+    bool enabled;
+    size_t max_bytes; // Upper bound on resident decoded bytes
+    char *spill_dir; // Directory for evicted forks, or NULL
+    dedupe_entry_t *slots; // Open-addressed key table
+    size_t cap;
+    size_t count;
+    dedupe_entry_t *lru_head; // Most recently used resident entry
+    dedupe_entry_t *lru_tail; // Least recently used resident entry
+    peel_dedupe_stats_t stats;
+} dedupe_state_t;
+
+// ============================================================================
+// Static Helpers
+// ============================================================================
+
+static dedupe_state_t g_dedupe;
+static pthread_mutex_t g_dedupe_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Mix the key fields into one table hash.
+static uint64_t key_hash(const dedupe_key_t *k) {
+    uint64_t h = rd64be(k->digest);
+    h ^= ((uint64_t)k->raw_len << 32 | k->crc) * 0x9E3779B97F4A7C15ULL;
+    h ^= ((uint64_t)k->packed_len << 16 | (uint64_t)k->method << 8 | (uint8_t)k->format) *
+         0xC2B2AE3D27D4EB4FULL;
+    return h ^ (h >> 29);
+}
+
+// True if both keys describe the same compressed fork.
+static bool key_eq(const dedupe_key_t *a, const dedupe_key_t *b) {
+    return a->format == b->format && a->method == b->method && a->crc == b->crc &&
+           a->packed_len == b->packed_len && a->raw_len == b->raw_len &&
+           memcmp(a->digest, b->digest, SHA256_LEN) == 0;
+}
+
+// Slot holding key, or the empty slot where it would be inserted.
+static dedupe_entry_t *table_slot(dedupe_entry_t *slots, size_t cap, const dedupe_key_t *k) {
+    size_t i = (size_t)key_hash(k) & (cap - 1);
+    while (slots[i].used && !key_eq(&slots[i].key, k)) {
+        i = (i + 1) & (cap - 1);
+    }
+    return &slots[i];
+}
+
+// Unlink a resident entry from the LRU list.
+static void lru_unlink(dedupe_entry_t *e) {
+    if (e->prev) e->prev->next = e->next;
+    else g_dedupe.lru_head = e->next;
+    if (e->next) e->next->prev = e->prev;
+    else g_dedupe.lru_tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+// Insert a resident entry at the most-recently-used end.
+static void lru_push_front(dedupe_entry_t *e) {
+    e->prev = NULL;
+    e->next = g_dedupe.lru_head;
+    if (g_dedupe.lru_head) g_dedupe.lru_head->prev = e;
+    g_dedupe.lru_head = e;
+    if (!g_dedupe.lru_tail) g_dedupe.lru_tail = e;
+}
+
+// Grow the key table, re-linking the LRU list to the moved entries.
+static bool table_grow(void) {
+    size_t cap = g_dedupe.cap ? g_dedupe.cap * 2 : DEDUPE_TABLE_INIT;
+    dedupe_entry_t *slots = calloc(cap, sizeof(*slots));
+    if (!slots) {
+        return false;
+    }
+    // Walk the old LRU list from the tail so pushes rebuild the same order
+    dedupe_entry_t *old_tail = g_dedupe.lru_tail;
+    g_dedupe.lru_head = g_dedupe.lru_tail = NULL;
+    for (dedupe_entry_t *e = old_tail; e; e = e->prev) {
+        dedupe_entry_t *n = table_slot(slots, cap, &e->key);
+        *n = *e;
+        lru_push_front(n);
+    }
+    // Spilled-only entries are not on the LRU list
+    for (size_t i = 0; i < g_dedupe.cap; i++) {
+        dedupe_entry_t *e = &g_dedupe.slots[i];
+        if (e->used && !e->buf.ref) {
+            dedupe_entry_t *n = table_slot(slots, cap, &e->key);
+            *n = *e;
+            n->prev = n->next = NULL;
+        }
+    }
+    free(g_dedupe.slots);
+    g_dedupe.slots = slots;
+    g_dedupe.cap = cap;
+    return true;
+}
+
+// Move the entry at src into the empty slot dst, re-linking its LRU
+// neighbours if it is resident.
+static void entry_move(dedupe_entry_t *dst, dedupe_entry_t *src) {
+    *dst = *src;
+    memset(src, 0, sizeof(*src));
+    if (!dst->buf.ref) {
+        return;
+    }
+    if (dst->prev) dst->prev->next = dst;
+    else g_dedupe.lru_head = dst;
+    if (dst->next) dst->next->prev = dst;
+    else g_dedupe.lru_tail = dst;
+}
+
+// Remove a non-resident entry from the key table.  Later members of its
+// probe cluster shift back into the hole so lookups never stop early.
+static void table_remove(dedupe_entry_t *e) {
+    size_t mask = g_dedupe.cap - 1;
+    size_t hole = (size_t)(e - g_dedupe.slots);
+    memset(e, 0, sizeof(*e));
+    for (size_t i = (hole + 1) & mask; g_dedupe.slots[i].used; i = (i + 1) & mask) {
+        size_t home = (size_t)key_hash(&g_dedupe.slots[i].key) & mask;
+        // Only entries whose home slot is not between the hole and i may move
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            entry_move(&g_dedupe.slots[hole], &g_dedupe.slots[i]);
+            hole = i;
+        }
+    }
+    g_dedupe.count--;
+}
+
+// Build the spill file path for a key into dst.
+static void spill_path(char *dst, size_t cap, const dedupe_key_t *k) {
+    char hex[SHA256_LEN * 2 + 1];
+    for (size_t i = 0; i < SHA256_LEN; i++) {
+        snprintf(hex + i * 2, 3, "%02x", k->digest[i]);
+    }
+    snprintf(dst, cap, "%s/%s-%c%u-%08x-%08x-%08x.fork", g_dedupe.spill_dir, hex, k->format,
+             (unsigned)k->method, (unsigned)k->packed_len, (unsigned)k->raw_len,
+             (unsigned)k->crc);
+}
+
+// Write a decoded fork and its trailer to the spill directory (temp file +
+// rename, so a concurrent reader never sees a partial file).  Returns true
+// on success.
+static bool spill_write(const dedupe_key_t *k, const peel_buf_t *buf) {
+    char path[4096], tmp[4096 + 32];
+    spill_path(path, sizeof(path), k);
+    snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid());
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        return false;
+    }
+    uint8_t trailer[SPILL_TRAILER];
+    wr32be(trailer, k->crc);
+    sha256(buf->data, buf->size, trailer + 4);
+    bool ok = fwrite(buf->data, 1, buf->size, f) == buf->size &&
+              fwrite(trailer, 1, sizeof(trailer), f) == sizeof(trailer);
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp, path) != 0) {
+        remove(tmp);
+        return false;
+    }
+    g_dedupe.stats.spills++;
+    return true;
+}
+
+// Read a spilled fork back.  Returns an owned buffer, or an empty one if the
+// file is missing, has the wrong length, or its trailer does not match the
+// key's CRC and the bytes read.
+static peel_buf_t spill_read(const dedupe_key_t *k) {
+    char path[4096];
+    spill_path(path, sizeof(path), k);
+    peel_err_t *err = NULL;
+    peel_buf_t buf = peel_read_file(path, &err);
+    if (err) {
+        peel_err_free(err);
+        return (peel_buf_t){0};
+    }
+    bool ok = buf.size == k->raw_len + SPILL_TRAILER;
+    if (ok) {
+        const uint8_t *trailer = buf.data + k->raw_len;
+        uint8_t digest[SHA256_LEN];
+        sha256(buf.data, k->raw_len, digest);
+        ok = rd32be(trailer) == k->crc && memcmp(trailer + 4, digest, SHA256_LEN) == 0;
+    }
+    if (!ok) {
+        peel_free(&buf);
+        return (peel_buf_t){0};
+    }
+    buf.size = k->raw_len;
+    return buf;
+}
+
+// Drop the cache's reference to a resident entry (spilling it first if a
+// spill directory is configured).  Callers holding the buffer keep it alive.
+// Unless a spilled copy remains, the entry leaves the table.
+static void entry_evict(dedupe_entry_t *e) {
+    if (g_dedupe.spill_dir && !e->spilled) {
+        e->spilled = spill_write(&e->key, &e->buf);
+    }
+    lru_unlink(e);
+    g_dedupe.stats.cached_bytes -= e->buf.size;
+    g_dedupe.stats.cached_forks--;
+    peel_free(&e->buf);
+    if (!e->spilled) {
+        table_remove(e);
+    }
+}
+
+// Evict least recently used entries until resident bytes fit the limit.
+static void cache_shrink(size_t limit) {
+    while (g_dedupe.lru_tail && g_dedupe.stats.cached_bytes > limit) {
+        entry_evict(g_dedupe.lru_tail);
+    }
+}
+
+// Make an owned buffer resident under e, returning the caller's handle.
+static bool entry_fill(dedupe_entry_t *e, peel_buf_t *buf) {
+    if (!buf_make_shared(buf)) {
+        return false;
+    }
+    e->buf = buf_share(buf);
+    g_dedupe.stats.cached_bytes += e->buf.size;
+    g_dedupe.stats.cached_forks++;
+    lru_push_front(e);
+    return true;
+}
+
+// Insert or refill the entry for key with an owned buffer.  spilled records
+// that the spill directory already holds a copy.
+static bool cache_insert(const dedupe_key_t *key, peel_buf_t *buf, bool spilled) {
+    if ((g_dedupe.count + 1) * 4 > g_dedupe.cap * 3 && !table_grow()) {
+        return false;
+    }
+    dedupe_entry_t *e = table_slot(g_dedupe.slots, g_dedupe.cap, key);
+    if (e->used && e->buf.ref) {
+        return true; // Already resident
+    }
+    bool fresh = !e->used;
+    if (fresh) {
+        memset(e, 0, sizeof(*e));
+        e->key = *key;
+        e->used = true;
+    }
+    if (!entry_fill(e, buf)) {
+        if (fresh) {
+            e->used = false;
+        }
+        return false;
+    }
+    e->spilled = e->spilled || spilled;
+    if (fresh) {
+        g_dedupe.count++;
+    }
+    cache_shrink(g_dedupe.max_bytes);
+    return true;
+}
+
+// ============================================================================
+// Operations (Internal)
+// ============================================================================
+
+// True when the cache is enabled and a fork of raw_len bytes is worth caching.
+bool dedupe_wanted(size_t raw_len) {
+    if (raw_len < DEDUPE_MIN_RAW) {
+        return false;
+    }
+    pthread_mutex_lock(&g_dedupe_lock);
+    bool enabled = g_dedupe.enabled;
+    pthread_mutex_unlock(&g_dedupe_lock);
+    return enabled;
+}
+
+// Build the content key for a compressed fork.
+dedupe_key_t dedupe_key(char format, const fork_ref_t *ref, const uint8_t *packed) {
+    dedupe_key_t k;
+    memset(&k, 0, sizeof(k));
+    k.format = format;
+    k.method = ref->method;
+    k.crc = ref->crc;
+    k.packed_len = ref->packed_len;
+    k.raw_len = ref->raw_len;
+    sha256(packed, ref->packed_len, k.digest);
+    return k;
+}
+
+// Look up a previously decoded fork.  On a hit, *out receives a new shared
+// reference and true is returned.
+bool dedupe_lookup(const dedupe_key_t *key, peel_buf_t *out) {
+    pthread_mutex_lock(&g_dedupe_lock);
+    dedupe_entry_t *e = g_dedupe.cap ? table_slot(g_dedupe.slots, g_dedupe.cap, key) : NULL;
+    if (e && e->used && e->buf.ref) {
+        lru_unlink(e);
+        lru_push_front(e);
+        *out = buf_share(&e->buf);
+        g_dedupe.stats.hits++;
+        pthread_mutex_unlock(&g_dedupe_lock);
+        return true;
+    }
+    // Spilled by us earlier, or possibly by another run sharing the directory
+    if (g_dedupe.spill_dir && (!e || !e->used || e->spilled)) {
+        peel_buf_t buf = spill_read(key);
+        if (buf.data) {
+            // Make it resident again; if that fails the caller still gets
+            // a private copy
+            cache_insert(key, &buf, true);
+            *out = buf;
+            g_dedupe.stats.spill_hits++;
+            pthread_mutex_unlock(&g_dedupe_lock);
+            return true;
+        }
+    }
+    g_dedupe.stats.misses++;
+    pthread_mutex_unlock(&g_dedupe_lock);
+    return false;
+}
+
+// Record a freshly decoded fork.  *buf is converted to a shared buffer that
+// the caller keeps; the cache holds its own reference.  Returns false if the
+// fork could not be cached (the caller's buffer is still valid).
+bool dedupe_store(const dedupe_key_t *key, peel_buf_t *buf) {
+    pthread_mutex_lock(&g_dedupe_lock);
+    // Disabled since the caller asked dedupe_wanted(): keep the fork private
+    bool ok = g_dedupe.enabled && cache_insert(key, buf, false);
+    pthread_mutex_unlock(&g_dedupe_lock);
+    return ok;
+}
+
+// ============================================================================
+// Operations (Public API)
+// ============================================================================
+
+// Enable the cache with a resident byte limit and optional spill directory.
+bool peel_dedupe_enable(size_t max_bytes, const char *spill_dir, peel_err_t **err) {
+    *err = NULL;
+    char *dir = NULL;
+    if (spill_dir) {
+        dir = malloc(strlen(spill_dir) + 1);
+        if (!dir) {
+            *err = make_err("out of memory enabling dedupe cache");
+            return false;
+        }
+        strcpy(dir, spill_dir);
+    }
+    pthread_mutex_lock(&g_dedupe_lock);
+    free(g_dedupe.spill_dir);
+    g_dedupe.spill_dir = dir;
+    g_dedupe.max_bytes = max_bytes;
+    g_dedupe.enabled = true;
+    cache_shrink(max_bytes);
+    pthread_mutex_unlock(&g_dedupe_lock);
+    return true;
+}
+
+// Disable the cache and drop its references.  Spill files are left in place.
+void peel_dedupe_disable(void) {
+    pthread_mutex_lock(&g_dedupe_lock);
+    for (size_t i = 0; i < g_dedupe.cap; i++) {
+        if (g_dedupe.slots[i].buf.ref) {
+            peel_free(&g_dedupe.slots[i].buf);
+        }
+    }
+    free(g_dedupe.slots);
+    free(g_dedupe.spill_dir);
+    memset(&g_dedupe, 0, sizeof(g_dedupe));
+    pthread_mutex_unlock(&g_dedupe_lock);
+}
+
+// Snapshot the cache counters.
+void peel_dedupe_stats(peel_dedupe_stats_t *out) {
+    if (out) {
+        pthread_mutex_lock(&g_dedupe_lock);
+        *out = g_dedupe.stats;
+        pthread_mutex_unlock(&g_dedupe_lock);
+    }
+}
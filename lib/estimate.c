@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) pappadf
+
+// estimate.c
+// Predict what peel() will cost before running it.
+//
+// peel_estimate() walks the same layers peel() would, but reads headers
+// instead of decoding.  A wrapper's declared payload length is the buffer
+// peel() allocates for it; an archive's scan pass yields each member's fork
+// sizes and compression method, which the format's fork_cost hook turns
+// into decoder working memory and CPU time.  The memory model mirrors
+// peel_depth(): while a wrapper decodes, its input and output buffers are
+// both live; while an archive extracts, the archive blob, every fork
+// decoded so far and the current decoder state are live.
+//
+// Only a wrapper whose payload can be viewed in place (MacBinary) is free to
+// cross.  BinHex has to be decoded to reach the archive catalog behind it;
+// its cost is part of the estimate anyway.
+
+#include "internal.h"
+
+// ============================================================================
+// Constants and Macros
+// ============================================================================
+
+// Maximum wrapper layers followed, matching peel()'s limit.
+#define EST_MAX_DEPTH 32
+
+// ============================================================================
+// Type Definitions (Private)
+// ============================================================================
+
+// Scan callback state: the estimate being filled and the archive it reads.
+typedef struct {
+    peel_estimate_t *est;
+    const peel_format_t *fmt;
+    const uint8_t *src;
+    size_t len;
+    size_t cap; // Allocated slots in est->entries
+    uint64_t held; // Bytes of the archive blob peel() would hold
+    uint64_t decoded; // Forks decoded so far
+    bool oom;
+} est_scan_t;
+
+// ============================================================================
+// Static Helpers
+// ============================================================================
+
+// Record one member: price both forks and update the running peak.
+static bool cost_entry(const entry_ref_t *ent, void *ctx) {
+    est_scan_t *s = ctx;
+    peel_estimate_t *est = s->est;
+    if (est->count == s->cap) {
+        size_t cap = s->cap ? s->cap * 2 : 16;
+        peel_entry_cost_t *tmp = realloc(est->entries, cap * sizeof(*tmp));
+        if (!tmp) {
+            s->oom = true;
+            return false;
+        }
+        est->entries = tmp;
+        s->cap = cap;
+    }
+
+    peel_entry_cost_t *e = &est->entries[est->count++];
+    memset(e, 0, sizeof(*e));
+    e->meta = ent->meta;
+
+    // Forks decode one after another; each output stays live until the end
+    const fork_ref_t *forks[2] = {&ent->data_fork, &ent->rsrc_fork};
+    for (int k = 0; k < 2; k++) {
+        fork_cost_t c = s->fmt->fork_cost(s->src, s->len, forks[k]);
+        uint64_t live = s->held + s->decoded + forks[k]->raw_len + c.work_bytes +
+                        est->count * sizeof(peel_file_t);
+        if (live > est->peak_bytes) {
+            est->peak_bytes = live;
+        }
+        s->decoded += forks[k]->raw_len;
+        e->raw_bytes += forks[k]->raw_len;
+        e->cpu_ns += c.cpu_ns;
+        if (c.work_bytes > e->work_bytes) {
+            e->work_bytes = c.work_bytes;
+        }
+    }
+    est->output_bytes += e->raw_bytes;
+    est->cpu_ns += e->cpu_ns;
+    return true;
+}
+
+// ============================================================================
+// Operations (Public API)
+// ============================================================================
+
+// Predict peel()'s peak memory and CPU time from headers and catalogs.
+bool peel_estimate(const uint8_t *src, size_t len, peel_estimate_t *out, peel_err_t **err) {
+    *err = NULL;
+    memset(out, 0, sizeof(*out));
+
+    // `owned` holds a decoded wrapper payload when one had to be materialized;
+    // `held` is the size of the buffer peel() itself would hold at this point
+    peel_buf_t owned = {0};
+    const uint8_t *cur = src;
+    size_t cur_len = len;
+    uint64_t held = 0;
+    bool wrapped = false;
+
+    for (int depth = 0; depth < EST_MAX_DEPTH; depth++) {
+        const peel_format_t *fmt = detect_format(cur, cur_len);
+        if (!fmt) {
+            break;
+        }
+
+        if (fmt->kind == PEEL_FMT_ARCHIVE) {
+            est_scan_t s = {.est = out, .fmt = fmt, .src = cur, .len = cur_len, .held = held};
+            fmt->scan(cur, cur_len, cost_entry, &s, err);
+            peel_free(&owned);
+            if (!*err && s.oom) {
+                *err = make_err("out of memory estimating archive");
+            }
+            if (*err) {
+                peel_estimate_free(out);
+                return false;
+            }
+            return true;
+        }
+
+        // Wrapper: its declared payload length is what peel() will allocate
+        const uint8_t *view = NULL;
+        uint64_t full_len = 0;
+        size_t n = fmt->probe(cur, cur_len, &view, NULL, 0, &full_len);
+        if (n == (size_t)-1) {
+            peel_free(&owned);
+            *err = make_err("estimate: unreadable %s header", fmt->name);
+            return false;
+        }
+        out->cpu_ns += full_len * fmt->ps_per_byte / 1000;
+        if (held + full_len > out->peak_bytes) {
+            out->peak_bytes = held + full_len;
+        }
+        held = full_len;
+        wrapped = true;
+
+        if (n == full_len) {
+            // Payload is a complete view into the current buffer
+            cur = view;
+            cur_len = n;
+            continue;
+        }
+        peel_buf_t decoded = fmt->peel_wrapper(cur, cur_len, err);
+        if (*err) {
+            peel_free(&owned);
+            return false;
+        }
+        peel_free(&owned);
+        owned = decoded;
+        cur = owned.data;
+        cur_len = owned.size;
+    }
+
+    // No archive: peel() returns the last payload, or a copy of the input
+    peel_free(&owned);
+    if (!wrapped) {
+        held = len;
+        out->peak_bytes = len;
+    }
+    out->output_bytes = held;
+    return true;
+}
+
+// Free the entries of an estimate and zero it.
+void peel_estimate_free(peel_estimate_t *est) {
+    if (!est) {
+        return;
+    }
+    free(est->entries);
+    memset(est, 0, sizeof(*est));
+}
@@ -156,10 +156,11 @@ static bin_header_t bin_parse_header(const uint8_t *hdr) {
 // ============================================================================
 
 // Decode a MacBinary file into a peel_file_t with both forks and metadata.
-// This is the shared implementation for both peel_bin and peel_bin_file.
+// This is the shared implementation for peel_bin, peel_bin_file and
+// bin_verify (which passes keep = false: bounds are checked, nothing copied).
 // bin.md § 14.1 — decoding steps for a MacBinary II file record.
 static peel_file_t bin_decode(const uint8_t *src, size_t len,
-                              decode_ctx_t *ctx) {
+                              decode_ctx_t *ctx, bool keep) {
     // bin.md § 14.1 step 1 — need at least 128 bytes for the header
     if (len < MB_BLOCK) {
         decode_abort(ctx, "MacBinary: input too short (%zu bytes)", len);
@@ -191,7 +192,7 @@ static peel_file_t bin_decode(const uint8_t *src, size_t len,
     }
 
     peel_buf_t data_fork = {0};
-    if (hdr.data_len > 0) {
+    if (keep && hdr.data_len > 0) {
         peel_err_t *copy_err = NULL;
         data_fork = peel_buf_copy(src + pos, hdr.data_len, &copy_err);
         if (copy_err) {
@@ -210,7 +211,7 @@ static peel_file_t bin_decode(const uint8_t *src, size_t len,
     }
 
     peel_buf_t rsrc_fork = {0};
-    if (hdr.rsrc_len > 0) {
+    if (keep && hdr.rsrc_len > 0) {
         peel_err_t *copy_err = NULL;
         rsrc_fork = peel_buf_copy(src + pos, hdr.rsrc_len, &copy_err);
         if (copy_err) {
@@ -256,6 +257,48 @@ bool bin_detect(const uint8_t *src, size_t len) {
     return bin_validate(src);
 }
 
+// ============================================================================
+// Operations (Internal) — Chain Probing
+// ============================================================================
+
+// Point at the fork peel_bin() would return, straight inside src.  Forks are
+// stored verbatim, so nothing needs decoding; the result may be a prefix when
+// src is itself a prefix of a larger stream.
+size_t bin_probe(const uint8_t *src, size_t len, const uint8_t **payload, uint8_t *scratch,
+                 size_t cap, uint64_t *full_len) {
+    (void)scratch;
+    (void)cap;
+    if (len < MB_BLOCK || !bin_validate(src)) {
+        return (size_t)-1;
+    }
+    bin_header_t hdr = bin_parse_header(src);
+
+    size_t pos = MB_BLOCK;
+    if (hdr.sec_hdr_len > 0) {
+        pos += hdr.sec_hdr_len + pad128(hdr.sec_hdr_len);
+    }
+
+    // bin.md § 10.3 — same fork selection as peel_bin()
+    size_t data_avail = pos < len ? len - pos : 0;
+    if (data_avail > hdr.data_len) {
+        data_avail = hdr.data_len;
+    }
+    bool use_data = hdr.rsrc_len == 0 || looks_like_sit(src + pos, data_avail);
+    uint32_t fork_len = hdr.data_len;
+    if (!use_data) {
+        pos += (size_t)hdr.data_len + pad128(hdr.data_len);
+        fork_len = hdr.rsrc_len;
+    }
+
+    *full_len = fork_len;
+    if (pos >= len) {
+        *payload = NULL;
+        return 0;
+    }
+    *payload = src + pos;
+    return len - pos < fork_len ? len - pos : fork_len;
+}
+
 // ============================================================================
 // Operations (Public API) — Wrapper Peel
 // ============================================================================
@@ -274,7 +317,7 @@ peel_buf_t peel_bin(const uint8_t *src, size_t len, peel_err_t **err) {
         return (peel_buf_t){0};
     }
 
-    peel_file_t file = bin_decode(src, len, &ctx);
+    peel_file_t file = bin_decode(src, len, &ctx, true);
 
     // bin.md § 10.3 — apply fork selection heuristic
     peel_buf_t result;
@@ -304,5 +347,25 @@ peel_file_t peel_bin_file(const uint8_t *src, size_t len, peel_err_t **err) {
         return (peel_file_t){0};
     }
 
-    return bin_decode(src, len, &ctx);
+    return bin_decode(src, len, &ctx, true);
+}
+
+// ============================================================================
+// Operations (Internal) — Verification
+// ============================================================================
+
+// Check the header and that both forks are present.  bin.md § 6 — the only
+// checksum MacBinary II carries is the header CRC; forks are stored verbatim.
+peel_verify_status_t bin_verify(const uint8_t *src, size_t len, peel_file_meta_t *meta,
+                                peel_err_t **err) {
+    *err = NULL;
+
+    decode_ctx_t ctx;
+    if (setjmp(ctx.jmp) != 0) {
+        *err = make_err("%s", ctx.errmsg);
+        return PEEL_VERIFY_FAILED;
+    }
+
+    *meta = bin_decode(src, len, &ctx, false).meta;
+    return PEEL_VERIFY_UNCHECKED;
 }
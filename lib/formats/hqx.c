@@ -96,8 +96,13 @@ static size_t hqx_find_preamble(const uint8_t *src, size_t len) {
         return (size_t)-1;
     }
 
-    // Search for the preamble substring in the input
-    for (size_t i = 0; i + preamble_len <= len; i++) {
+    // Search for the preamble substring in the input, jumping between
+    // candidate '(' bytes with memchr
+    const uint8_t *p = src;
+    const uint8_t *last = src + (len - preamble_len);
+    while ((p = memchr(p, '(', (size_t)(last - p) + 1)) != NULL) {
+        size_t i = (size_t)(p - src);
+        p++;
         if (memcmp(src + i, HQX_PREAMBLE, preamble_len) == 0) {
             // Skip past the rest of this line
             size_t j = i + preamble_len;
@@ -320,10 +325,11 @@ static hqx_header_t hqx_parse_header(hqx_decoder_t *dec) {
 // ============================================================================
 
 // hqx.md § 6.4 / § 6.5 — read a fork of `fork_len` bytes from the decoded
-// stream, verify the trailing 2-byte CRC, and return the data.
+// stream, verify the trailing 2-byte CRC, and return the data (or an empty
+// buffer when `keep` is false, for peel_verify()).
 // hqx.md § 7.2 — uses the CRC placeholder rule for verification.
 static peel_buf_t hqx_read_fork(hqx_decoder_t *dec, uint32_t fork_len,
-                                const char *fork_name) {
+                                const char *fork_name, bool keep) {
     if (fork_len == 0) {
         // hqx.md § 6.6 — zero-length fork: still must read and verify CRC
         uint8_t crc_bytes[2];
@@ -336,16 +342,22 @@ static peel_buf_t hqx_read_fork(hqx_decoder_t *dec, uint32_t fork_len,
         return (peel_buf_t){0};
     }
 
-    // Allocate and read fork content
-    grow_buf_t gbuf;
-    grow_init(&gbuf, fork_len, dec->ctx);
+    // Read fork content, accumulating its CRC as each chunk arrives
+    grow_buf_t gbuf = {0};
+    if (keep) {
+        grow_init(&gbuf, fork_len, dec->ctx);
+    }
 
     uint8_t chunk[4096];
+    uint16_t crc = 0;
     uint32_t remaining = fork_len;
     while (remaining > 0) {
         size_t batch = remaining < sizeof(chunk) ? remaining : sizeof(chunk);
         hqx_read_bytes(dec, chunk, batch);
-        grow_append(&gbuf, chunk, batch, dec->ctx);
+        crc = crc16_ccitt_update(crc, chunk, batch);
+        if (keep) {
+            grow_append(&gbuf, chunk, batch, dec->ctx);
+        }
         remaining -= (uint32_t)batch;
     }
 
@@ -353,16 +365,13 @@ static peel_buf_t hqx_read_fork(hqx_decoder_t *dec, uint32_t fork_len,
     // CRC(content + stored_crc) should yield zero.
     uint8_t crc_bytes[2];
     hqx_read_bytes(dec, crc_bytes, 2);
-
-    // Compute CRC over fork content then over the stored CRC bytes
-    uint16_t crc = crc16_ccitt(gbuf.data, gbuf.len);
     crc = crc16_ccitt_update(crc, crc_bytes, 2);
     if (crc != 0) {
         grow_free(&gbuf);
         decode_abort(dec->ctx, "BinHex: %s fork CRC mismatch", fork_name);
     }
 
-    return grow_finish(&gbuf);
+    return keep ? grow_finish(&gbuf) : (peel_buf_t){0};
 }
 
 // ============================================================================
@@ -370,9 +379,10 @@ static peel_buf_t hqx_read_fork(hqx_decoder_t *dec, uint32_t fork_len,
 // ============================================================================
 
 // Decode a BinHex 4.0 file into a peel_file_t with both forks and metadata.
-// This is the shared implementation for both peel_hqx and peel_hqx_file.
+// This is the shared implementation for peel_hqx, peel_hqx_file and
+// hqx_verify (which passes keep = false: CRCs are checked, forks dropped).
 static peel_file_t hqx_decode(const uint8_t *src, size_t len,
-                               decode_ctx_t *ctx) {
+                               decode_ctx_t *ctx, bool keep) {
     // hqx.md § 3.1 — locate the preamble identification string
     size_t after_preamble = hqx_find_preamble(src, len);
     if (after_preamble == (size_t)-1) {
@@ -393,10 +403,10 @@ static peel_file_t hqx_decode(const uint8_t *src, size_t len,
     hqx_header_t hdr = hqx_parse_header(&dec);
 
     // hqx.md § 6.4 — read the data fork and verify its CRC
-    peel_buf_t data_fork = hqx_read_fork(&dec, hdr.data_len, "data");
+    peel_buf_t data_fork = hqx_read_fork(&dec, hdr.data_len, "data", keep);
 
     // hqx.md § 6.5 — read the resource fork and verify its CRC
-    peel_buf_t rsrc_fork = hqx_read_fork(&dec, hdr.rsrc_len, "resource");
+    peel_buf_t rsrc_fork = hqx_read_fork(&dec, hdr.rsrc_len, "resource", keep);
 
     // Assemble the result
     peel_file_t file;
@@ -430,6 +440,48 @@ bool hqx_detect(const uint8_t *src, size_t len) {
     return hqx_find_preamble(src, len) != (size_t)-1;
 }
 
+// ============================================================================
+// Operations (Internal) — Chain Probing
+// ============================================================================
+
+// Decode the header and at most cap bytes of the data fork (the payload
+// peel_hqx() returns) into scratch.  hqx.md § 6.3 — header CRC is still
+// verified; fork CRCs are not, since the fork is never fully read.
+size_t hqx_probe(const uint8_t *src, size_t len, const uint8_t **payload, uint8_t *scratch,
+                 size_t cap, uint64_t *full_len) {
+    decode_ctx_t ctx;
+    if (setjmp(ctx.jmp) != 0) {
+        return (size_t)-1;
+    }
+
+    size_t after_preamble = hqx_find_preamble(src, len);
+    if (after_preamble == (size_t)-1) {
+        return (size_t)-1;
+    }
+    size_t payload_start = hqx_find_start_colon(src, len, after_preamble);
+    if (payload_start == (size_t)-1) {
+        return (size_t)-1;
+    }
+
+    hqx_decoder_t dec;
+    hqx_decoder_init(&dec, src, len, payload_start, &ctx);
+    hqx_header_t hdr = hqx_parse_header(&dec);
+
+    // Stop at the end of the input: src may itself be a decoded prefix
+    size_t want = hdr.data_len < cap ? hdr.data_len : cap;
+    size_t got = 0;
+    while (got < want) {
+        int b = hqx_decoded_byte(&dec);
+        if (b < 0) {
+            break;
+        }
+        scratch[got++] = (uint8_t)b;
+    }
+    *payload = scratch;
+    *full_len = hdr.data_len;
+    return got;
+}
+
 // ============================================================================
 // Operations (Public API) — Wrapper Peel
 // ============================================================================
@@ -447,7 +499,7 @@ peel_buf_t peel_hqx(const uint8_t *src, size_t len, peel_err_t **err) {
         return (peel_buf_t){0};
     }
 
-    peel_file_t file = hqx_decode(src, len, &ctx);
+    peel_file_t file = hqx_decode(src, len, &ctx, true);
 
     // Return the data fork; free the resource fork
     peel_buf_t result = file.data_fork;
@@ -465,5 +517,24 @@ peel_file_t peel_hqx_file(const uint8_t *src, size_t len, peel_err_t **err) {
         return (peel_file_t){0};
     }
 
-    return hqx_decode(src, len, &ctx);
+    return hqx_decode(src, len, &ctx, true);
+}
+
+// ============================================================================
+// Operations (Internal) — Verification
+// ============================================================================
+
+// Decode both forks and check the header and fork CRCs, keeping nothing.
+peel_verify_status_t hqx_verify(const uint8_t *src, size_t len, peel_file_meta_t *meta,
+                                peel_err_t **err) {
+    *err = NULL;
+
+    decode_ctx_t ctx;
+    if (setjmp(ctx.jmp) != 0) {
+        *err = make_err("%s", ctx.errmsg);
+        return PEEL_VERIFY_FAILED;
+    }
+
+    *meta = hqx_decode(src, len, &ctx, false).meta;
+    return PEEL_VERIFY_OK;
 }
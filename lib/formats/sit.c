@@ -37,6 +37,22 @@ peel_buf_t peel_sit13(const uint8_t *src, size_t len, size_t uncomp_len,
 peel_buf_t peel_sit15(const uint8_t *src, size_t len, size_t uncomp_len,
                       peel_err_t **err);
 
+// Decompress a method-13 / method-15 fork into uncomp_len bytes at out.
+bool sit13_decode_into(const uint8_t *src, size_t len, uint8_t *out, size_t uncomp_len,
+                       peel_err_t **err);
+bool sit15_decode_into(const uint8_t *src, size_t len, uint8_t *out, size_t uncomp_len,
+                       peel_err_t **err);
+
+// Decoder working memory for method 13, and for one method-15 stream.
+size_t sit13_work_size(void);
+size_t sit15_work_size(const uint8_t *src, size_t len);
+
+// Decode a method-13 / method-15 fork in chunks without keeping it.
+bool sit13_stream(const uint8_t *src, size_t len, size_t uncomp_len, chunk_fn fn, void *ctx,
+                  peel_err_t **err);
+bool sit15_stream(const uint8_t *src, size_t len, size_t uncomp_len, chunk_fn fn, void *ctx,
+                  peel_err_t **err);
+
 // ============================================================================
 // Constants and Macros
 // ============================================================================
@@ -57,8 +73,9 @@ peel_buf_t peel_sit15(const uint8_t *src, size_t len, size_t uncomp_len,
 // sit.md § 4.7 "Classic Iteration Rules" — max folder nesting depth.
 #define SIT_MAX_DEPTH  10
 
-// sit.md § 5.7 "Iteration Rules" — max directory map entries for SIT5.
-#define SIT5_MAX_DIRS  32
+// sit.md § 5.7 "Iteration Rules" — initial slot count of the SIT5 directory
+// map (power of two; doubled whenever the map is three-quarters full).
+#define SIT5_DIR_MAP_INIT  64
 
 // sit.md § 5.3 "Entry Header" — SIT5 entry magic value.
 #define SIT5_ENTRY_MAGIC  0xA5A5A5A5
@@ -72,8 +89,14 @@ peel_buf_t peel_sit15(const uint8_t *src, size_t len, size_t uncomp_len,
 // Number of known classic SIT signatures.
 #define SIT_NUM_SIGS  9
 
-// Maximum number of files from a single archive (safety limit).
-#define SIT_MAX_FILES  65536
+// Approximate decode cost per output byte, in picoseconds, for
+// peel_estimate().  Measured at -O2 on a ~3 GHz x86-64 core over the test
+// corpus; methods 1 and 2 have no samples there and are estimated.
+#define SIT_PS_STORE  3600   // method 0: copy + CRC-16
+#define SIT_PS_RLE90  5000   // method 1
+#define SIT_PS_LZW    12000  // method 2
+#define SIT_PS_M13    18000  // method 13: LZSS + Huffman
+#define SIT_PS_M15    30000  // method 15: Arsenic (arithmetic + BWT)
 
 // ============================================================================
 // Type Definitions (Private)
@@ -100,12 +123,15 @@ typedef struct {
     bool             has_rsrc;     // Resource fork present
 } sit_entry_t;
 
-// Growable list of parsed file entries.
+// RLE90 decoder state, so output can be produced in pieces.
+// sit.md § 8.2 "State"
 typedef struct {
-    sit_entry_t *items;
-    int          count;
-    int          cap;
-} sit_entry_list_t;
+    const uint8_t *src;
+    size_t         src_len;
+    size_t         src_off;
+    uint8_t        last_byte;  // initialized to 0
+    size_t         pending;    // copies of last_byte still to emit
+} rle90_state_t;
 
 // LZW decoder state.
 // sit.md § 9.3 "Dictionary Structure" — struct-of-arrays layout.
@@ -129,13 +155,41 @@ typedef struct {
     size_t   stage_len;            // Valid bytes in staging buffer
 } lzw_state_t;
 
-// SIT5 directory map entry for path construction.
+// SIT5 directory map slot for path construction.
 // sit.md § 5.7 "Iteration Rules"
 typedef struct {
-    uint32_t offset;    // Byte offset of the folder header
-    char     path[512]; // Reconstructed full path
+    uint32_t offset; // Byte offset of the folder header
+    char    *path;   // Reconstructed full path (NULL = empty slot)
 } sit5_dir_entry_t;
 
+// Open-addressed hash map from folder header offset to full folder path.
+// Each folder's path is built once from its parent's entry, so resolving a
+// child is a single probe regardless of how many folders the archive has.
+typedef struct {
+    sit5_dir_entry_t *slots; // Slot array (cap entries)
+    size_t            cap;   // Slot count (power of two, or 0 before first insert)
+    size_t            count; // Occupied slots
+} sit5_dir_map_t;
+
+// Incremental entry parser for either archive layout.  Each call to
+// sit_iter_next() reads just enough headers to produce the next file entry.
+typedef struct {
+    const uint8_t *blob;      // Whole input buffer
+    size_t         blob_len;  // Length of the input buffer
+    const uint8_t *base;      // Start of the archive within blob
+    size_t         avail;     // Bytes from base to end of blob
+    bool           sit5;      // SIT5 layout (false = classic)
+    size_t         cursor;    // Offset of the next header, relative to base
+    uint64_t       remaining; // Headers still to visit (grows with folders)
+
+    // Classic: sit.md § 4.7 — folder stack of up to 10 nesting levels
+    char dirs_stack[SIT_MAX_DEPTH][64];
+    int  depth;
+
+    // SIT5: folder offset → path map, sit.md § 5.7
+    sit5_dir_map_t dirs;
+} sit_iter_t;
+
 // ============================================================================
 // Static Helpers — CRC-16
 // ============================================================================
@@ -190,48 +244,6 @@ static inline uint16_t sit_crc(const uint8_t *buf, size_t len) {
     return sit_crc_update(0, buf, len);
 }
 
-// ============================================================================
-// Static Helpers — Entry List
-// ============================================================================
-
-// Initialize an empty entry list.
-static void entry_list_init(sit_entry_list_t *list) {
-    list->items = NULL;
-    list->count = 0;
-    list->cap   = 0;
-}
-
-// Append one entry, growing the backing array if needed.
-static sit_entry_t *entry_list_push(sit_entry_list_t *list, peel_err_t **err) {
-    if (list->count >= SIT_MAX_FILES) {
-        *err = make_err("SIT: too many files in archive (limit %d)", SIT_MAX_FILES);
-        return NULL;
-    }
-    if (list->count == list->cap) {
-        // Double the capacity (start at 16)
-        int new_cap = list->cap ? list->cap * 2 : 16;
-        sit_entry_t *tmp = realloc(list->items,
-                                   (size_t)new_cap * sizeof(sit_entry_t));
-        if (!tmp) {
-            *err = make_err("SIT: out of memory growing entry list");
-            return NULL;
-        }
-        list->items = tmp;
-        list->cap   = new_cap;
-    }
-    sit_entry_t *e = &list->items[list->count++];
-    memset(e, 0, sizeof(*e));
-    return e;
-}
-
-// Release the entry list backing storage.
-static void entry_list_free(sit_entry_list_t *list) {
-    free(list->items);
-    list->items = NULL;
-    list->count = 0;
-    list->cap   = 0;
-}
-
 // ============================================================================
 // Static Helpers — Path Construction
 // ============================================================================
@@ -261,6 +273,95 @@ static void build_path(char *dst, size_t cap, const char *dir, const char *name)
     }
 }
 
+// ============================================================================
+// Static Helpers — SIT5 Directory Map
+// ============================================================================
+
+// Slot index for a folder offset (Fibonacci hashing; cap is a power of two).
+static size_t dir_map_slot(uint32_t offset, size_t cap) {
+    return (size_t)(offset * 0x9E3779B1u) & (cap - 1);
+}
+
+// Look up the full path of the folder whose header is at `offset`.
+// Returns NULL if no such folder has been recorded.
+static const char *dir_map_find(const sit5_dir_map_t *map, uint32_t offset) {
+    if (map->cap == 0) return NULL;
+    // Linear probing until the key or an empty slot is found
+    for (size_t i = dir_map_slot(offset, map->cap);; i = (i + 1) & (map->cap - 1)) {
+        const sit5_dir_entry_t *e = &map->slots[i];
+        if (!e->path) return NULL;
+        if (e->offset == offset) return e->path;
+    }
+}
+
+// Double the slot array (or allocate the first one) and rehash all entries.
+static bool dir_map_grow(sit5_dir_map_t *map, peel_err_t **err) {
+    size_t new_cap = map->cap ? map->cap * 2 : SIT5_DIR_MAP_INIT;
+    sit5_dir_entry_t *slots = calloc(new_cap, sizeof(*slots));
+    if (!slots) {
+        *err = make_err("SIT5: out of memory growing directory map");
+        return false;
+    }
+    for (size_t i = 0; i < map->cap; ++i) {
+        sit5_dir_entry_t *e = &map->slots[i];
+        if (!e->path) continue;
+        size_t j = dir_map_slot(e->offset, new_cap);
+        while (slots[j].path) j = (j + 1) & (new_cap - 1);
+        slots[j] = *e;
+    }
+    free(map->slots);
+    map->slots = slots;
+    map->cap   = new_cap;
+    return true;
+}
+
+// Record (or replace) the full path of the folder at `offset`.
+static bool dir_map_insert(sit5_dir_map_t *map, uint32_t offset,
+                           const char *path, peel_err_t **err) {
+    // Keep the load factor at or below 3/4
+    if ((map->count + 1) * 4 > map->cap * 3 && !dir_map_grow(map, err))
+        return false;
+
+    size_t plen = strlen(path);
+    char *copy = malloc(plen + 1);
+    if (!copy) {
+        *err = make_err("SIT5: out of memory for folder path");
+        return false;
+    }
+    memcpy(copy, path, plen + 1);
+
+    size_t i = dir_map_slot(offset, map->cap);
+    while (map->slots[i].path && map->slots[i].offset != offset)
+        i = (i + 1) & (map->cap - 1);
+    if (map->slots[i].path) {
+        // Same header offset seen twice (malformed archive); keep the latest
+        free(map->slots[i].path);
+    } else {
+        map->count++;
+    }
+    map->slots[i].offset = offset;
+    map->slots[i].path   = copy;
+    return true;
+}
+
+// Release every stored path and the slot array.
+static void dir_map_free(sit5_dir_map_t *map) {
+    for (size_t i = 0; i < map->cap; ++i)
+        free(map->slots[i].path);
+    free(map->slots);
+    map->slots = NULL;
+    map->cap   = 0;
+    map->count = 0;
+}
+
+// Resolve a parent folder offset to its path ("" for the archive root or an
+// unknown parent).
+static const char *dir_map_parent(const sit5_dir_map_t *map, uint32_t parent_off) {
+    if (parent_off == 0) return "";
+    const char *p = dir_map_find(map, parent_off);
+    return p ? p : "";
+}
+
 // ============================================================================
 // Static Helpers — LZW Decoder
 // ============================================================================
@@ -420,47 +521,84 @@ static void lzw_destroy(lzw_state_t *z) {
     free(z);
 }
 
+// ============================================================================
+// Static Helpers — RLE90 Decoder
+// ============================================================================
+
+// sit.md § 8 "Method 1: RLE90" — escape-based run-length encoding.
+// Produce up to `want` bytes; returns the number produced (0 = EOF).  A run
+// longer than the space left is finished by the next call.
+static size_t rle90_decode(rle90_state_t *r, uint8_t *dst, size_t want) {
+    size_t produced = 0;
+    while (produced < want) {
+        // Finish a pending run first
+        if (r->pending > 0) {
+            size_t n = r->pending < want - produced ? r->pending : want - produced;
+            memset(dst + produced, r->last_byte, n);
+            produced += n;
+            r->pending -= n;
+            continue;
+        }
+        if (r->src_off >= r->src_len) break;
+        uint8_t b = r->src[r->src_off++];
+        if (b != 0x90) {
+            // Literal byte
+            dst[produced++] = b;
+            r->last_byte = b;
+        } else {
+            // sit.md § 8.3 "Algorithm" — escape marker 0x90
+            if (r->src_off >= r->src_len) break;
+            uint8_t n = r->src[r->src_off++];
+            if (n == 0) {
+                // Literal 0x90 (do not update last_byte)
+                dst[produced++] = 0x90;
+            } else {
+                // Repeat last_byte (n-1) additional times; n == 1 adds none
+                r->pending = (size_t)(n - 1);
+            }
+        }
+    }
+    return produced;
+}
+
 // ============================================================================
 // Static Helpers — Fork Decompression
 // ============================================================================
 
-// Decompress a single fork using the specified compression method.
-// Returns an owned buffer on success, or a zero buffer with *err set.
+// Decompress a single fork using the specified compression method, into
+// dest (raw_len bytes of caller memory from a peel_sink_t) or, when dest is
+// NULL, a new owned buffer.  At most limit bytes are decoded.  Returns the
+// result, or a zero buffer with *err set; dest is left to the caller on
+// failure.
 // sit.md § 6 "Compression Methods" — dispatch by method ID.
-static peel_buf_t decompress_fork(const sit_fork_info_t *fi, peel_err_t **err) {
+static peel_buf_t decode_fork_data(const sit_fork_info_t *fi, uint8_t *dest, size_t limit,
+                                   peel_err_t **err) {
     uint32_t raw_len    = fi->raw_len;
     uint32_t packed_len = fi->packed_len;
     uint16_t expect_crc = fi->crc;
     uint8_t  method     = fi->method;
     const uint8_t *src  = fi->data;
 
-    // sit.md § 10 "Method 13" — delegated to sit13.c
-    if (method == 13) {
-        peel_buf_t result = peel_sit13(src, packed_len, raw_len, err);
-        if (*err) return (peel_buf_t){0};
-        // sit.md § 6.3 "CRC Verification Rule" — verify CRC over decompressed
-        uint16_t actual = sit_crc(result.data, result.size);
-        if (actual != expect_crc) {
-            *err = make_err("SIT: fork CRC mismatch (expected 0x%04X, got 0x%04X)",
-                            expect_crc, actual);
-            peel_free(&result);
-            return (peel_buf_t){0};
-        }
-        return result;
-    }
+    // peel_prefix(): every decoder below stops after raw_len bytes, so a
+    // smaller raw_len yields the fork's prefix.  Its CRC cannot be checked.
+    bool partial = raw_len > limit;
+    if (partial) raw_len = (uint32_t)limit;
 
-    // sit.md § 11 "Method 15" — delegated to sit15.c
-    // sit.md § 6.3 — method 15 handles integrity internally; skip CRC check.
-    if (method == 15) {
-        return peel_sit15(src, packed_len, raw_len, err);
-    }
+    // Methods 13 and 15 have no header to decode from an empty fork; one
+    // clamped to nothing by the limit is still reported as partial
+    if ((method == 13 || method == 15) && raw_len == 0)
+        return (peel_buf_t){.partial = partial};
 
-    // Allocate output buffer for methods 0, 1, 2
-    uint8_t *out = malloc(raw_len);
+    // Allocate the output buffer unless the caller supplied one
+    size_t out_cap = 0;
+    uint8_t *out = dest;
     if (!out) {
-        *err = make_err("SIT: out of memory allocating %u bytes for fork",
-                        raw_len);
-        return (peel_buf_t){0};
+        out = buf_alloc(raw_len, &out_cap);
+        if (!out) {
+            *err = make_err("SIT: out of memory allocating %u bytes for fork",
+                            raw_len);
+            return (peel_buf_t){0};
+        }
     }
 
     size_t produced = 0;
@@ -471,8 +609,7 @@ static peel_buf_t decompress_fork(const sit_fork_info_t *fi, peel_err_t **err) {
         if (packed_len < raw_len) {
             *err = make_err("SIT: method 0 packed (%u) < raw (%u)",
                             packed_len, raw_len);
-            free(out);
-            return (peel_buf_t){0};
+            break;
         }
         memcpy(out, src, raw_len);
         produced = raw_len;
@@ -481,33 +618,8 @@ static peel_buf_t decompress_fork(const sit_fork_info_t *fi, peel_err_t **err) {
 
     case 1: {
         // sit.md § 8 "Method 1: RLE90" — escape-based run-length encoding
-        // sit.md § 8.2 "State" — last_byte initialized to 0
-        uint8_t last_byte = 0;
-        size_t  src_off = 0;
-        while (produced < raw_len && src_off < packed_len) {
-            uint8_t b = src[src_off++];
-            if (b != 0x90) {
-                // Literal byte
-                out[produced++] = b;
-                last_byte = b;
-            } else {
-                // sit.md § 8.3 "Algorithm" — escape marker 0x90
-                if (src_off >= packed_len) break;
-                uint8_t n = src[src_off++];
-                if (n == 0) {
-                    // Literal 0x90 (do not update last_byte)
-                    out[produced++] = 0x90;
-                } else if (n > 1) {
-                    // Repeat last_byte (n-1) additional times
-                    size_t repeats = (size_t)(n - 1);
-                    if (produced + repeats > raw_len)
-                        repeats = raw_len - produced;
-                    memset(out + produced, last_byte, repeats);
-                    produced += repeats;
-                }
-                // n == 1 means zero additional copies
-            }
-        }
+        rle90_state_t rle = {.src = src, .src_len = packed_len};
+        produced = rle90_decode(&rle, out, raw_len);
         break;
     }
 
@@ -516,31 +628,165 @@ static peel_buf_t decompress_fork(const sit_fork_info_t *fi, peel_err_t **err) {
         lzw_state_t *lzw = lzw_create(src, packed_len);
         if (!lzw) {
             *err = make_err("SIT: out of memory creating LZW decoder");
-            free(out);
-            return (peel_buf_t){0};
+            break;
         }
         produced = lzw_decode(lzw, out, raw_len);
         lzw_destroy(lzw);
         break;
     }
 
+    case 13:
+        // sit.md § 10 "Method 13" — delegated to sit13.c
+        if (sit13_decode_into(src, packed_len, out, raw_len, err)) produced = raw_len;
+        break;
+
+    case 15:
+        // sit.md § 11 "Method 15" — delegated to sit15.c
+        if (sit15_decode_into(src, packed_len, out, raw_len, err)) produced = raw_len;
+        break;
+
     default:
         // sit.md § 12 "Unsupported Methods" — fatal error
         *err = make_err("SIT: unsupported compression method %d", method);
-        free(out);
+        break;
+    }
+
+    // sit.md § 6.3 "CRC Verification Rule" — verify CRC over decompressed
+    // data.  Method 15 handles integrity internally; its CRC is skipped.
+    if (!*err && !partial && method != 15) {
+        uint16_t actual_crc = sit_crc(out, produced);
+        if (actual_crc != expect_crc) {
+            *err = make_err("SIT: fork CRC mismatch (expected 0x%04X, got 0x%04X)",
+                            expect_crc, actual_crc);
+        }
+    }
+    if (*err) {
+        if (!dest) buf_release(out, out_cap);
         return (peel_buf_t){0};
     }
 
-    // sit.md § 6.3 "CRC Verification Rule" — verify CRC over decompressed data
-    uint16_t actual_crc = sit_crc(out, produced);
-    if (actual_crc != expect_crc) {
-        *err = make_err("SIT: fork CRC mismatch (expected 0x%04X, got 0x%04X)",
-                        expect_crc, actual_crc);
-        free(out);
+    return (peel_buf_t){.data = out, .size = produced, .owned = !dest,
+                        .cap = dest ? raw_len : out_cap, .partial = partial, .sunk = dest != NULL};
+}
+
+// sit.md § 7 "Method 0: None" — the fork is its own packed bytes.  Check
+// them in place and return a view instead of a copy.
+static peel_buf_t stored_view(const sit_fork_info_t *fi, peel_err_t **err) {
+    if (fi->packed_len < fi->raw_len) {
+        *err = make_err("SIT: method 0 packed (%u) < raw (%u)", fi->packed_len, fi->raw_len);
+        return (peel_buf_t){0};
+    }
+    uint16_t actual = sit_crc(fi->data, fi->raw_len);
+    if (actual != fi->crc) {
+        *err = make_err("SIT: fork CRC mismatch (expected 0x%04X, got 0x%04X)", fi->crc, actual);
         return (peel_buf_t){0};
     }
+    return peel_buf_wrap(fi->data, fi->raw_len);
+}
+
+// Decompress a fork, consulting the dedupe cache when it is enabled.  A hit
+// returns a shared buffer referencing an earlier decode of identical bytes.
+// With opts->views, a stored fork is returned as a view into the archive;
+// with opts->sink, a data fork (meta set) may be decoded into caller memory.
+// Only the first opts->limit bytes are decoded.
+static peel_buf_t decompress_fork(const sit_fork_info_t *fi, const each_opts_t *opts,
+                                  const peel_file_meta_t *meta, peel_err_t **err) {
+    size_t limit = opts ? opts->limit : SIZE_MAX;
+    bool whole = fi->raw_len <= limit;
+    if (opts && opts->views && fi->method == 0 && whole) {
+        return stored_view(fi, err);
+    }
+    uint8_t *dest = NULL;
+    if (opts && opts->sink && opts->sink->acquire && meta && whole && fi->raw_len > 0) {
+        dest = opts->sink->acquire(opts->sink->ctx, meta, fi->raw_len);
+    }
+    if (dest) {
+        peel_buf_t out = decode_fork_data(fi, dest, limit, err);
+        if (*err) opts->sink->discard(opts->sink->ctx, dest, fi->raw_len);
+        return out;
+    }
+    if (!whole || !dedupe_wanted(fi->raw_len)) {
+        return decode_fork_data(fi, NULL, limit, err);
+    }
+    fork_ref_t ref = {.packed_len = fi->packed_len, .raw_len = fi->raw_len,
+                      .crc = fi->crc, .method = fi->method};
+    dedupe_key_t key = dedupe_key('s', &ref, fi->data);
+    peel_buf_t out;
+    if (dedupe_lookup(&key, &out)) return out;
+    out = decode_fork_data(fi, NULL, limit, err);
+    if (!*err) dedupe_store(&key, &out);
+    return out;
+}
+
+// Feed one verify chunk into the running CRC-16 at ctx.
+static void crc_chunk(const uint8_t *data, size_t len, void *ctx) {
+    uint16_t *crc = ctx;
+    *crc = sit_crc_update(*crc, data, len);
+}
+
+// Decode a fork through a small buffer and check it exactly as
+// decode_fork_data() does, keeping nothing.  Method 15 reports UNCHECKED:
+// its container CRC is not used (sit.md § 6.3).
+static peel_verify_status_t verify_fork_data(const sit_fork_info_t *fi, peel_err_t **err) {
+    *err = NULL;
+    uint8_t chunk[VERIFY_CHUNK];
+    size_t left = fi->raw_len, n;
+    uint16_t crc = 0;
+
+    switch (fi->method) {
+    case 0:
+        if (fi->packed_len < fi->raw_len) {
+            *err = make_err("SIT: method 0 packed (%u) < raw (%u)", fi->packed_len, fi->raw_len);
+            return PEEL_VERIFY_FAILED;
+        }
+        crc = sit_crc(fi->data, fi->raw_len);
+        break;
+
+    case 1: {
+        rle90_state_t rle = {.src = fi->data, .src_len = fi->packed_len};
+        while (left && (n = rle90_decode(&rle, chunk, left < sizeof(chunk) ? left : sizeof(chunk)))) {
+            crc = sit_crc_update(crc, chunk, n);
+            left -= n;
+        }
+        break;
+    }
+
+    case 2: {
+        lzw_state_t *lzw = lzw_create(fi->data, fi->packed_len);
+        if (!lzw) {
+            *err = make_err("SIT: out of memory creating LZW decoder");
+            return PEEL_VERIFY_FAILED;
+        }
+        while (left && (n = lzw_decode(lzw, chunk, left < sizeof(chunk) ? left : sizeof(chunk)))) {
+            crc = sit_crc_update(crc, chunk, n);
+            left -= n;
+        }
+        lzw_destroy(lzw);
+        break;
+    }
+
+    case 13:
+        if (!sit13_stream(fi->data, fi->packed_len, fi->raw_len, crc_chunk, &crc, err)) {
+            return PEEL_VERIFY_FAILED;
+        }
+        break;
+
+    case 15:
+        if (!sit15_stream(fi->data, fi->packed_len, fi->raw_len, NULL, NULL, err)) {
+            return PEEL_VERIFY_FAILED;
+        }
+        return PEEL_VERIFY_UNCHECKED;
+
+    default:
+        *err = make_err("SIT: unsupported compression method %d", fi->method);
+        return PEEL_VERIFY_FAILED;
+    }
 
-    return (peel_buf_t){.data = out, .size = produced, .owned = true};
+    if (crc != fi->crc) {
+        *err = make_err("SIT: fork CRC mismatch (expected 0x%04X, got 0x%04X)", fi->crc, crc);
+        return PEEL_VERIFY_FAILED;
+    }
+    return PEEL_VERIFY_OK;
 }
 
 // ============================================================================
@@ -560,7 +806,10 @@ static int64_t find_classic_magic(const uint8_t *src, size_t len) {
     if (len < SIT_CLASSIC_HDR_SIZE) return -1;
     size_t limit = len - 14;
     for (size_t off = 0; off <= limit; ++off) {
-        // Check for "rLau" at offset 10–13 first (fast rejection)
+        // Jump to the next 'r' that could begin "rLau" at offset 10–13
+        const uint8_t *r = memchr(src + off + 10, 'r', limit - off + 1);
+        if (!r) break;
+        off = (size_t)(r - src) - 10;
         if (memcmp(src + off + 10, "rLau", 4) != 0)
             continue;
         // Check for any of the 9 known signatures at offset 0–3
@@ -572,60 +821,64 @@ static int64_t find_classic_magic(const uint8_t *src, size_t len) {
     return -1;
 }
 
-// Parse all file entries from a classic StuffIt archive.
-// sit.md § 4.7 "Classic Iteration Rules" and Appendix B
-static bool parse_classic(const uint8_t *blob, size_t blob_len,
-                          size_t archive_off, sit_entry_list_t *entries,
-                          peel_err_t **err) {
-    const uint8_t *base = blob + archive_off;
-    size_t avail = blob_len - archive_off;
+// Start iterating a classic StuffIt archive at archive_off.
+// sit.md § 4.2 "Main Archive Header"
+static bool classic_begin(sit_iter_t *it, size_t archive_off, peel_err_t **err) {
+    it->base  = it->blob + archive_off;
+    it->avail = it->blob_len - archive_off;
 
-    if (avail < SIT_CLASSIC_HDR_SIZE) {
+    if (it->avail < SIT_CLASSIC_HDR_SIZE) {
         *err = make_err("SIT classic: archive too small");
         return false;
     }
 
     // sit.md § 4.2 "Main Archive Header" — file_count at offset 4
-    uint16_t file_count = rd16be(base + 4);
-    uint32_t cursor = SIT_CLASSIC_HDR_SIZE;
-    uint32_t done = 0;
+    it->remaining = rd16be(it->base + 4);
+    it->cursor    = SIT_CLASSIC_HDR_SIZE;
+    it->depth     = 0;
+    return true;
+}
 
-    // sit.md § 4.7 — folder stack of up to 10 nesting levels
-    char dirs[SIT_MAX_DEPTH][64];
-    int  depth = 0;
+// Advance to the next file entry of a classic StuffIt archive.
+// Returns true with *ent filled, or false at the end (or on error).
+// sit.md § 4.7 "Classic Iteration Rules" and Appendix B
+static bool classic_next(sit_iter_t *it, sit_entry_t *ent, peel_err_t **err) {
+    const uint8_t *blob = it->blob;
+    const uint8_t *base = it->base;
+    size_t avail = it->avail;
 
-    while (done < file_count) {
-        if ((size_t)cursor + SIT_ENTRY_HDR_SIZE > avail) break;
+    while (it->remaining > 0) {
+        if (it->cursor + SIT_ENTRY_HDR_SIZE > avail) break;
 
-        const uint8_t *hdr = base + cursor;
+        const uint8_t *hdr = base + it->cursor;
         uint8_t rm = hdr[0];
         uint8_t dm = hdr[1];
 
         // sit.md § 4.4 — folder start marker (0x20)
         if (rm == SIT_FOLDER_START || dm == SIT_FOLDER_START) {
             uint8_t nlen = hdr[2];
-            if (depth < SIT_MAX_DEPTH && nlen < 64) {
-                memcpy(dirs[depth], hdr + 3, nlen);
-                dirs[depth][nlen] = '\0';
-                depth++;
+            if (it->depth < SIT_MAX_DEPTH && nlen < 64) {
+                memcpy(it->dirs_stack[it->depth], hdr + 3, nlen);
+                it->dirs_stack[it->depth][nlen] = '\0';
+                it->depth++;
             }
-            cursor += SIT_ENTRY_HDR_SIZE;
-            done++;
+            it->cursor += SIT_ENTRY_HDR_SIZE;
+            it->remaining--;
             continue;
         }
 
         // sit.md § 4.4 — folder end marker (0x21)
         if (rm == SIT_FOLDER_END || dm == SIT_FOLDER_END) {
-            if (depth > 0) depth--;
-            cursor += SIT_ENTRY_HDR_SIZE;
-            done++;
+            if (it->depth > 0) it->depth--;
+            it->cursor += SIT_ENTRY_HDR_SIZE;
+            it->remaining--;
             continue;
         }
 
         // sit.md § 4.4 — skip entries with unknown high bits
         if ((rm & 0xE0) || (dm & 0xE0)) {
-            cursor += SIT_ENTRY_HDR_SIZE;
-            done++;
+            it->cursor += SIT_ENTRY_HDR_SIZE;
+            it->remaining--;
             continue;
         }
 
@@ -640,10 +893,10 @@ static bool parse_classic(const uint8_t *blob, size_t blob_len,
         // Build full path from folder stack
         char path[512] = "";
         size_t p = 0;
-        for (int d = 0; d < depth; d++) {
-            size_t sl = strlen(dirs[d]);
+        for (int d = 0; d < it->depth; d++) {
+            size_t sl = strlen(it->dirs_stack[d]);
             if (p + sl + 1 >= sizeof(path)) break;
-            memcpy(path + p, dirs[d], sl);
+            memcpy(path + p, it->dirs_stack[d], sl);
             p += sl;
             path[p++] = '/';
         }
@@ -666,19 +919,16 @@ static bool parse_classic(const uint8_t *blob, size_t blob_len,
         uint16_t dcrc  = rd16be(hdr + 102);
 
         // sit.md § 4.5 "Fork Data Layout" — rsrc first, then data
-        const uint8_t *rsrc_ptr = base + cursor + SIT_ENTRY_HDR_SIZE;
+        const uint8_t *rsrc_ptr = base + it->cursor + SIT_ENTRY_HDR_SIZE;
         const uint8_t *data_ptr = rsrc_ptr + rclen;
 
         // Bounds check
-        if ((size_t)(data_ptr - blob) + dclen > blob_len) {
+        if ((size_t)(data_ptr - blob) + dclen > it->blob_len) {
             *err = make_err("SIT classic: fork data extends past archive end");
             return false;
         }
 
-        // Add entry to the list
-        sit_entry_t *ent = entry_list_push(entries, err);
-        if (!ent) return false;
-
+        memset(ent, 0, sizeof(*ent));
         strncpy(ent->name, path, sizeof(ent->name) - 1);
         ent->mac_type     = ftype;
         ent->mac_creator  = fcreator;
@@ -700,11 +950,12 @@ static bool parse_classic(const uint8_t *blob, size_t blob_len,
         ent->has_rsrc = (rulen > 0);
 
         // Advance past both fork data regions
-        cursor = (uint32_t)((size_t)(data_ptr - base) + dclen);
-        done++;
+        it->cursor = (size_t)(data_ptr - base) + dclen;
+        it->remaining--;
+        return true;
     }
 
-    return true;
+    return false;
 }
 
 // ============================================================================
@@ -718,6 +969,10 @@ static int64_t find_sit5_magic(const uint8_t *src, size_t len) {
     if (len < 80) return -1;
     size_t limit = len - 80;
     for (size_t off = 0; off <= limit; ++off) {
+        // Jump to the next 'S' that could begin the signature
+        const uint8_t *s = memchr(src + off, 'S', limit - off + 1);
+        if (!s) break;
+        off = (size_t)(s - src);
         // sit.md § 5.1 — check two validated substrings; bytes 16–19 (year)
         // and bytes 78–79 (CR LF) are NOT validated.
         if (memcmp(src + off, "StuffIt (c)1997-", 16) == 0 &&
@@ -730,35 +985,40 @@ static int64_t find_sit5_magic(const uint8_t *src, size_t len) {
     return -1;
 }
 
-// Parse all file entries from a SIT5 archive.
-// sit.md § 5.7 "Iteration Rules" and Appendix C
-static bool parse_sit5(const uint8_t *blob, size_t blob_len,
-                       size_t archive_off, sit_entry_list_t *entries,
-                       peel_err_t **err) {
-    const uint8_t *base = blob + archive_off;
-    size_t avail = blob_len - archive_off;
-
-    if (avail < SIT5_MIN_SIZE) {
-        *err = make_err("SIT5: archive too small (%zu bytes)", avail);
+// Start iterating a SIT5 archive at archive_off.
+// sit.md § 5.2 "Top Header"
+static bool sit5_begin(sit_iter_t *it, size_t archive_off, peel_err_t **err) {
+    it->base  = it->blob + archive_off;
+    it->avail = it->blob_len - archive_off;
+
+    if (it->avail < SIT5_MIN_SIZE) {
+        *err = make_err("SIT5: archive too small (%zu bytes)", it->avail);
         return false;
     }
 
     // sit.md § 5.2 "Top Header" — entry count at offset 92, cursor at 94
-    uint16_t entry_count = rd16be(base + 92);
-    uint32_t cursor      = rd32be(base + 94);
-    uint32_t remaining   = entry_count;
+    it->remaining = rd16be(it->base + 92);
+    it->cursor    = rd32be(it->base + 94);
+    return true;
+}
 
-    // Directory map for path resolution
-    sit5_dir_entry_t dmap[SIT5_MAX_DIRS];
-    int dmap_cnt = 0;
+// Advance to the next file entry of a SIT5 archive, recording folders in the
+// directory map as they are passed.  Returns true with *ent filled, or false
+// at the end (or on error).
+// sit.md § 5.7 "Iteration Rules" and Appendix C
+static bool sit5_next(sit_iter_t *it, sit_entry_t *ent, peel_err_t **err) {
+    const uint8_t *blob = it->blob;
+    size_t blob_len = it->blob_len;
+    const uint8_t *base = it->base;
+    size_t avail = it->avail;
 
-    while (remaining > 0 && cursor != 0 &&
-           (size_t)cursor + 48 <= avail) {
-        const uint8_t *h1 = base + cursor;
+    while (it->remaining > 0 && it->cursor != 0 &&
+           it->cursor + 48 <= avail) {
+        const uint8_t *h1 = base + it->cursor;
 
         // sit.md § 5.3 "Entry Header" — validate entry magic
         if (rd32be(h1) != SIT5_ENTRY_MAGIC) {
-            *err = make_err("SIT5: invalid entry magic at offset %u", cursor);
+            *err = make_err("SIT5: invalid entry magic at offset %zu", it->cursor);
             return false;
         }
 
@@ -769,7 +1029,7 @@ static bool parse_sit5(const uint8_t *blob, size_t blob_len,
         }
 
         uint16_t h1_len = rd16be(h1 + 6);
-        if ((size_t)cursor + h1_len > avail) {
+        if (it->cursor + h1_len > avail) {
             *err = make_err("SIT5: header1 extends past archive end");
             return false;
         }
@@ -788,13 +1048,13 @@ static bool parse_sit5(const uint8_t *blob, size_t blob_len,
             uint16_t stored   = rd16be(h1 + 32);
             free(tmp);
             if (computed != stored) {
-                *err = make_err("SIT5: header CRC mismatch at offset %u",
-                                cursor);
+                *err = make_err("SIT5: header CRC mismatch at offset %zu",
+                                it->cursor);
                 return false;
             }
         }
 
-        uint32_t h2_off       = cursor + h1_len;
+        size_t   h2_off       = it->cursor + h1_len;
         uint8_t  flags        = h1[9];
         uint32_t parent_off   = rd32be(h1 + 26);
         uint16_t namelen      = rd16be(h1 + 30);
@@ -807,7 +1067,7 @@ static bool parse_sit5(const uint8_t *blob, size_t blob_len,
         {
             size_t cl = namelen;
             if (cl > sizeof(namebuf) - 1) cl = sizeof(namebuf) - 1;
-            if ((size_t)cursor + 48 + cl > avail) cl = avail - (size_t)cursor - 48;
+            if (it->cursor + 48 + cl > avail) cl = avail - it->cursor - 48;
             memcpy(namebuf, h1 + 48, cl);
             namebuf[cl] = '\0';
         }
@@ -853,44 +1113,28 @@ static bool parse_sit5(const uint8_t *blob, size_t blob_len,
 
             // sit.md § 5.6 "Special Markers" — 0xFFFFFFFF folders are skipped
             if (d_raw_len == 0xFFFFFFFF) {
-                remaining++;
-                cursor = h2_off;
-                remaining--;
+                it->remaining++;
+                it->cursor = h2_off;
+                it->remaining--;
                 continue;
             }
 
-            // Build parent path
-            char ppath[512] = "";
-            if (parent_off != 0) {
-                for (int i = 0; i < dmap_cnt; ++i) {
-                    if (dmap[i].offset == parent_off) {
-                        strncpy(ppath, dmap[i].path, sizeof(ppath) - 1);
-                        ppath[sizeof(ppath) - 1] = '\0';
-                        break;
-                    }
-                }
-            }
-
-            // Record folder in directory map
+            // Record folder in directory map, extending the parent's path
             char folder_full[512];
-            build_path(folder_full, sizeof(folder_full), ppath, namebuf);
-            if (dmap_cnt < SIT5_MAX_DIRS) {
-                dmap[dmap_cnt].offset = cursor;
-                strncpy(dmap[dmap_cnt].path, folder_full,
-                        sizeof(dmap[dmap_cnt].path) - 1);
-                dmap[dmap_cnt].path[sizeof(dmap[dmap_cnt].path) - 1] = '\0';
-                dmap_cnt++;
-            }
+            build_path(folder_full, sizeof(folder_full),
+                       dir_map_parent(&it->dirs, parent_off), namebuf);
+            if (!dir_map_insert(&it->dirs, (uint32_t)it->cursor, folder_full, err))
+                return false;
 
             // sit.md § 5.7 — add child count, advance into children
-            remaining += child_count;
-            cursor = (uint32_t)(payload_ptr - base);
+            it->remaining += child_count;
+            it->cursor = (size_t)(payload_ptr - base);
             continue;
         }
 
         // sit.md § 5.6 "Special Markers" — skip 0xFFFFFFFF non-folder entries
         if (d_raw_len == 0xFFFFFFFF) {
-            cursor = h2_off;
+            it->cursor = h2_off;
             continue;
         }
 
@@ -906,18 +1150,9 @@ static bool parse_sit5(const uint8_t *blob, size_t blob_len,
         }
 
         // Build full path from parent
-        char ppath[512] = "";
-        if (parent_off != 0) {
-            for (int i = 0; i < dmap_cnt; ++i) {
-                if (dmap[i].offset == parent_off) {
-                    strncpy(ppath, dmap[i].path, sizeof(ppath) - 1);
-                    ppath[sizeof(ppath) - 1] = '\0';
-                    break;
-                }
-            }
-        }
         char full_name[512];
-        build_path(full_name, sizeof(full_name), ppath, namebuf);
+        build_path(full_name, sizeof(full_name),
+                   dir_map_parent(&it->dirs, parent_off), namebuf);
 
         // sit.md § 5.5 "Fork Data Layout" — resource fork first, then data
         const uint8_t *r_base = payload_ptr;
@@ -927,10 +1162,7 @@ static bool parse_sit5(const uint8_t *blob, size_t blob_len,
             return false;
         }
 
-        // Add entry to the list
-        sit_entry_t *ent = entry_list_push(entries, err);
-        if (!ent) return false;
-
+        memset(ent, 0, sizeof(*ent));
         strncpy(ent->name, full_name, sizeof(ent->name) - 1);
         ent->mac_type     = ftype;
         ent->mac_creator  = fcreator;
@@ -955,91 +1187,134 @@ static bool parse_sit5(const uint8_t *blob, size_t blob_len,
         }
 
         // Advance cursor past the fork data
-        cursor = (uint32_t)((size_t)(d_base - base) + d_packed_len);
-        remaining--;
+        it->cursor = (size_t)(d_base - base) + d_packed_len;
+        it->remaining--;
+        return true;
     }
 
-    return true;
+    return false;
 }
 
 // ============================================================================
-// Static Helpers — Build File List from Entries
+// Static Helpers — Entry Iteration
 // ============================================================================
 
-// Decompress all forks and produce the final peel_file_list_t.
-static peel_file_list_t build_file_list(const sit_entry_list_t *entries,
-                                        peel_err_t **err) {
-    if (entries->count == 0) {
-        return (peel_file_list_t){.files = NULL, .count = 0};
-    }
+// Locate the archive in src and prepare an iterator over its file entries.
+// sit.md § 2.3 "Detection Strategy" — prefer the earliest match.
+static bool sit_iter_init(sit_iter_t *it, const uint8_t *src, size_t len,
+                          peel_err_t **err) {
+    memset(it, 0, sizeof(*it));
+    it->blob     = src;
+    it->blob_len = len;
 
-    // Count entries with at least one non-empty fork
-    int file_count = 0;
-    for (int i = 0; i < entries->count; ++i) {
-        const sit_entry_t *e = &entries->items[i];
-        if (e->data_fork.raw_len > 0 ||
-            (e->has_rsrc && e->rsrc_fork.raw_len > 0)) {
-            file_count++;
-        }
-    }
+    int64_t classic_off = find_classic_magic(src, len);
+    int64_t sit5_off    = find_sit5_magic(src, len);
 
-    peel_file_t *files = calloc((size_t)file_count, sizeof(peel_file_t));
-    if (!files) {
-        *err = make_err("SIT: out of memory for file list (%d files)",
-                        file_count);
-        return (peel_file_list_t){0};
+    if (classic_off >= 0 && (sit5_off < 0 || classic_off <= sit5_off)) {
+        return classic_begin(it, (size_t)classic_off, err);
+    }
+    if (sit5_off >= 0) {
+        it->sit5 = true;
+        return sit5_begin(it, (size_t)sit5_off, err);
     }
+    *err = make_err("SIT: no valid StuffIt signature found");
+    return false;
+}
 
-    int fi = 0;
-    for (int i = 0; i < entries->count && fi < file_count; ++i) {
-        const sit_entry_t *ent = &entries->items[i];
+// Parse the next file entry.  Returns false at the end or on error.
+static bool sit_iter_next(sit_iter_t *it, sit_entry_t *ent, peel_err_t **err) {
+    return it->sit5 ? sit5_next(it, ent, err) : classic_next(it, ent, err);
+}
 
-        // Skip entries with no non-empty forks
-        if (ent->data_fork.raw_len == 0 &&
-            !(ent->has_rsrc && ent->rsrc_fork.raw_len > 0))
-            continue;
+// Release iterator state (the SIT5 directory map).
+static void sit_iter_free(sit_iter_t *it) {
+    dir_map_free(&it->dirs);
+}
 
-        peel_file_t *f = &files[fi];
-
-        // Copy metadata
-        strncpy(f->meta.name, ent->name, sizeof(f->meta.name) - 1);
-        f->meta.mac_type     = ent->mac_type;
-        f->meta.mac_creator  = ent->mac_creator;
-        f->meta.finder_flags = ent->finder_flags;
-
-        // Decompress data fork
-        if (ent->data_fork.raw_len > 0) {
-            f->data_fork = decompress_fork(&ent->data_fork, err);
-            if (*err) {
-                // Clean up previously allocated files
-                for (int j = 0; j < fi; ++j) {
-                    peel_free(&files[j].data_fork);
-                    peel_free(&files[j].resource_fork);
-                }
-                free(files);
-                return (peel_file_list_t){0};
-            }
-        }
+// Decompress both forks of one entry into *f.
+static bool decode_entry(const sit_entry_t *ent, peel_file_t *f, const each_opts_t *opts,
+                         peel_err_t **err) {
+    memset(f, 0, sizeof(*f));
+
+    // Copy metadata
+    strncpy(f->meta.name, ent->name, sizeof(f->meta.name) - 1);
+    f->meta.mac_type     = ent->mac_type;
+    f->meta.mac_creator  = ent->mac_creator;
+    f->meta.finder_flags = ent->finder_flags;
+
+    // Decompress data fork
+    if (ent->data_fork.raw_len > 0) {
+        f->data_fork = decompress_fork(&ent->data_fork, opts, &f->meta, err);
+        if (*err) return false;
+    }
 
-        // Decompress resource fork
-        if (ent->has_rsrc && ent->rsrc_fork.raw_len > 0) {
-            f->resource_fork = decompress_fork(&ent->rsrc_fork, err);
-            if (*err) {
-                // Clean up this file's data fork and all prior files
-                peel_free(&f->data_fork);
-                for (int j = 0; j < fi; ++j) {
-                    peel_free(&files[j].data_fork);
-                    peel_free(&files[j].resource_fork);
-                }
-                free(files);
-                return (peel_file_list_t){0};
-            }
+    // Decompress resource fork
+    if (ent->has_rsrc && ent->rsrc_fork.raw_len > 0) {
+        f->resource_fork = decompress_fork(&ent->rsrc_fork, opts, NULL, err);
+        if (*err) {
+            fork_release(opts ? opts->sink : NULL, &f->data_fork);
+            return false;
         }
+    }
+    return true;
+}
+
+// True if the sink asks to leave this entry out, judged from its header.
+static bool skip_entry(const sit_entry_t *ent, const each_opts_t *opts) {
+    if (!opts || !opts->sink || !opts->sink->skip) return false;
+    peel_entry_info_t info;
+    memset(&info, 0, sizeof(info));
+    strncpy(info.meta.name, ent->name, sizeof(info.meta.name) - 1);
+    info.meta.mac_type     = ent->mac_type;
+    info.meta.mac_creator  = ent->mac_creator;
+    info.meta.finder_flags = ent->finder_flags;
+    info.data_len = ent->data_fork.raw_len;
+    info.data_crc = ent->data_fork.crc;
+    if (ent->has_rsrc) {
+        info.rsrc_len = ent->rsrc_fork.raw_len;
+        info.rsrc_crc = ent->rsrc_fork.crc;
+    }
+    return opts->sink->skip(opts->sink->ctx, &info);
+}
+
+// Describe one parsed fork by its offset in the blob, for later decoding.
+static fork_ref_t fork_ref_of(const uint8_t *blob, const sit_fork_info_t *fi) {
+    return (fork_ref_t){
+        .offset     = (size_t)(fi->data - blob),
+        .packed_len = fi->packed_len,
+        .raw_len    = fi->raw_len,
+        .crc        = fi->crc,
+        .method     = fi->method
+    };
+}
 
-        fi++;
+// Name of a fork's compression method for peel_trace_t, NULL for no fork.
+static const char *method_name(const sit_fork_info_t *fi) {
+    if (fi->raw_len == 0) return NULL;
+    switch (fi->method) {
+    case 0:  return "none";
+    case 1:  return "rle90";
+    case 2:  return "lzw";
+    case 13: return "lzss-huffman";
+    case 15: return "arsenic";
+    default: return "unknown";
     }
+}
 
-    return (peel_file_list_t){.files = files, .count = file_count};
+// Record how ent was decoded, in ns, in the last layer of opts->trace.
+// Method 15 forks and prefixes (peel_prefix()) go without a CRC check.
+static void trace_entry(const sit_entry_t *ent, const each_opts_t *opts, uint64_t ns) {
+    peel_trace_t *t = opts ? opts->trace : NULL;
+    if (!t) return;
+    size_t limit = opts->limit;
+    bool has_rsrc = ent->has_rsrc && ent->rsrc_fork.raw_len > 0;
+    t->data_method = method_name(&ent->data_fork);
+    t->rsrc_method = has_rsrc ? method_name(&ent->rsrc_fork) : NULL;
+    t->crc_checked = !(t->data_method && (ent->data_fork.method == 15 ||
+                                          ent->data_fork.raw_len > limit)) &&
+                     !(has_rsrc && (ent->rsrc_fork.method == 15 ||
+                                    ent->rsrc_fork.raw_len > limit));
+    if (t->count > 0) t->layers[t->count - 1].ns = ns;
 }
 
 // ============================================================================
@@ -1053,41 +1328,181 @@ bool sit_detect(const uint8_t *src, size_t len) {
     return false;
 }
 
+// Name the StuffIt variant whose signature appears first.
+const char *sit_flavor(const uint8_t *src, size_t len) {
+    int64_t classic = find_classic_magic(src, len);
+    int64_t sit5    = find_sit5_magic(src, len);
+    if (classic < 0 && sit5 < 0) return NULL;
+    if (sit5 < 0 || (classic >= 0 && classic < sit5)) return "sit";
+    return "sit5";
+}
+
 // ============================================================================
 // Operations (Public API) — Archive Extraction
 // ============================================================================
 
-// Detect, parse, and extract all files from a StuffIt archive.
-// Supports both classic (1.x–4.x) and SIT5 (5.x) formats.
-// sit.md § 2.3 "Detection Strategy" — prefer earliest match.
-peel_file_list_t peel_sit(const uint8_t *src, size_t len, peel_err_t **err) {
+// Parse entries one at a time and hand each decoded file to fn before the
+// next header is read, so the first file is available without walking the
+// whole catalog.  Entries with no non-empty fork are skipped.
+void peel_sit_each(const uint8_t *src, size_t len, peel_each_fn fn, void *ctx,
+                   peel_err_t **err) {
+    sit_each(src, len, NULL, fn, ctx, err);
+}
+
+// peel_sit_each() with each_opts_t: stored (method 0) forks as views into
+// src, data forks decoded into sink memory, entries the sink skips left out.
+void sit_each(const uint8_t *src, size_t len, const each_opts_t *opts, peel_each_fn fn,
+              void *ctx, peel_err_t **err) {
     *err = NULL;
 
-    int64_t classic_off = find_classic_magic(src, len);
-    int64_t sit5_off    = find_sit5_magic(src, len);
+    sit_iter_t it;
+    if (!sit_iter_init(&it, src, len, err)) {
+        sit_iter_free(&it);
+        return;
+    }
 
-    sit_entry_list_t entries;
-    entry_list_init(&entries);
+    sit_entry_t ent;
+    while (sit_iter_next(&it, &ent, err)) {
+        // Skip entries with no non-empty forks
+        if (ent.data_fork.raw_len == 0 &&
+            !(ent.has_rsrc && ent.rsrc_fork.raw_len > 0))
+            continue;
+        if (skip_entry(&ent, opts))
+            continue;
 
-    // Prefer the earliest match
-    if (classic_off >= 0 && (sit5_off < 0 || classic_off <= sit5_off)) {
-        if (!parse_classic(src, len, (size_t)classic_off, &entries, err)) {
-            entry_list_free(&entries);
-            return (peel_file_list_t){0};
-        }
-    } else if (sit5_off >= 0) {
-        if (!parse_sit5(src, len, (size_t)sit5_off, &entries, err)) {
-            entry_list_free(&entries);
-            return (peel_file_list_t){0};
+        peel_file_t f;
+        uint64_t start = opts && opts->trace ? clock_ns() : 0;
+        if (!decode_entry(&ent, &f, opts, err))
+            break;
+        if (opts && opts->trace) trace_entry(&ent, opts, clock_ns() - start);
+        // Ownership of f passes to the callback
+        if (!fn(&f, ctx))
+            break;
+    }
+    sit_iter_free(&it);
+}
+
+// List every member with at least one non-empty fork, without decoding.
+void sit_scan(const uint8_t *src, size_t len, entry_scan_fn fn, void *ctx,
+              peel_err_t **err) {
+    *err = NULL;
+
+    sit_iter_t it;
+    if (!sit_iter_init(&it, src, len, err)) {
+        sit_iter_free(&it);
+        return;
+    }
+
+    sit_entry_t ent;
+    while (sit_iter_next(&it, &ent, err)) {
+        if (ent.data_fork.raw_len == 0 &&
+            !(ent.has_rsrc && ent.rsrc_fork.raw_len > 0))
+            continue;
+
+        entry_ref_t ref;
+        memset(&ref, 0, sizeof(ref));
+        strncpy(ref.meta.name, ent.name, sizeof(ref.meta.name) - 1);
+        ref.meta.mac_type     = ent.mac_type;
+        ref.meta.mac_creator  = ent.mac_creator;
+        ref.meta.finder_flags = ent.finder_flags;
+        ref.data_fork = fork_ref_of(src, &ent.data_fork);
+        if (ent.has_rsrc)
+            ref.rsrc_fork = fork_ref_of(src, &ent.rsrc_fork);
+        if (!fn(&ref, ctx))
+            break;
+    }
+    sit_iter_free(&it);
+}
+
+// Decode one fork previously reported by sit_scan().
+peel_buf_t sit_decode_fork(const uint8_t *src, size_t len, const fork_ref_t *ref,
+                           peel_err_t **err) {
+    *err = NULL;
+    if (ref->offset > len || ref->packed_len > len - ref->offset) {
+        *err = make_err("SIT: fork extends past archive end");
+        return (peel_buf_t){0};
+    }
+    sit_fork_info_t fi = {
+        .raw_len    = ref->raw_len,
+        .packed_len = ref->packed_len,
+        .crc        = (uint16_t)ref->crc,
+        .method     = ref->method,
+        .data       = src + ref->offset
+    };
+    return decompress_fork(&fi, NULL, NULL, err);
+}
+
+// Decode and check both forks of one member reported by sit_scan(),
+// keeping none of the output.
+peel_verify_status_t sit_verify_entry(const uint8_t *src, size_t len, const entry_ref_t *ent,
+                                      peel_err_t **err) {
+    *err = NULL;
+    peel_verify_status_t status = PEEL_VERIFY_OK;
+    const fork_ref_t *forks[2] = {&ent->data_fork, &ent->rsrc_fork};
+    for (int k = 0; k < 2; k++) {
+        const fork_ref_t *ref = forks[k];
+        if (ref->raw_len == 0) continue;
+        if (ref->offset > len || ref->packed_len > len - ref->offset) {
+            *err = make_err("SIT: fork extends past archive end");
+            return PEEL_VERIFY_FAILED;
         }
-    } else {
-        *err = make_err("SIT: no valid StuffIt signature found");
-        entry_list_free(&entries);
-        return (peel_file_list_t){0};
+        sit_fork_info_t fi = {
+            .raw_len    = ref->raw_len,
+            .packed_len = ref->packed_len,
+            .crc        = (uint16_t)ref->crc,
+            .method     = ref->method,
+            .data       = src + ref->offset
+        };
+        peel_verify_status_t s = verify_fork_data(&fi, err);
+        if (s == PEEL_VERIFY_FAILED) return s;
+        if (s == PEEL_VERIFY_UNCHECKED) status = s;
+    }
+    return status;
+}
+
+// Predict the cost of decoding one fork reported by sit_scan() from its
+// method and sizes.  Only an Arsenic stream header is read, for its block size.
+fork_cost_t sit_fork_cost(const uint8_t *src, size_t len, const fork_ref_t *ref) {
+    fork_cost_t c = {0};
+    if (ref->raw_len == 0) {
+        return c;
+    }
+    uint64_t ps = 0;
+    switch (ref->method) {
+    case 0:
+        ps = SIT_PS_STORE;
+        break;
+    case 1:
+        ps = SIT_PS_RLE90;
+        break;
+    case 2:
+        ps = SIT_PS_LZW;
+        c.work_bytes = sizeof(lzw_state_t);
+        break;
+    case 13:
+        ps = SIT_PS_M13;
+        c.work_bytes = sit13_work_size();
+        break;
+    case 15: {
+        size_t avail = ref->offset < len ? len - ref->offset : 0;
+        if (avail > ref->packed_len) avail = ref->packed_len;
+        ps = SIT_PS_M15;
+        c.work_bytes = sit15_work_size(avail ? src + ref->offset : src, avail);
+        break;
     }
+    default:
+        break; // Unsupported: decoding fails before doing any work
+    }
+    c.cpu_ns = ref->raw_len * ps / 1000;
+    return c;
+}
+
+// Detect, parse, and extract all files from a StuffIt archive.
+// Supports both classic (1.x–4.x) and SIT5 (5.x) formats.
+peel_file_list_t peel_sit(const uint8_t *src, size_t len, peel_err_t **err) {
+    file_list_builder_t b;
+    file_list_builder_init(&b);
 
-    // Decompress all forks and build the result
-    peel_file_list_t result = build_file_list(&entries, err);
-    entry_list_free(&entries);
-    return result;
+    peel_sit_each(src, len, file_list_collect, &b, err);
+    return file_list_builder_finish(&b, err);
 }
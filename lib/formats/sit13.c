@@ -605,13 +605,47 @@ static int m13_output(m13_state_t *st, uint8_t *dst, size_t cap) {
 // Entry Point (Internal)
 // ============================================================================
 
-// Decompress method-13 (LZSS + Huffman) compressed data into a freshly
-// allocated buffer.  Called by sit.c for entries using compression method 13.
+// Decompress method-13 (LZSS + Huffman) compressed data into out, which
+// holds uncomp_len bytes (a pool buffer, or caller memory from a
+// peel_sink_t).  Called by sit.c for entries using compression method 13.
 //
 // sit13.md § "Appendix A: Complete Decompression Walkthrough"
 //   1. Read header, build (or select) Huffman trees.
-//   2. Main decode loop: literals + matches into sliding window.
-//   3. Return the output buffer.
+//   2. Main decode loop: literals + matches into sliding window, copied to out.
+bool sit13_decode_into(const uint8_t *src, size_t len, uint8_t *out, size_t uncomp_len,
+                       peel_err_t **err) {
+    *err = NULL;
+
+    // The decoder state is large (~70 KiB), so heap-allocate to avoid stack overflow
+    m13_state_t *st = calloc(1, sizeof(*st));
+    if (!st) {
+        *err = make_err("sit13: out of memory allocating decoder state");
+        return false;
+    }
+
+    // Initialise bit reader over the compressed input
+    m13_br_init(&st->br, src, len);
+
+    // Parse header and build Huffman trees
+    if (m13_setup(st) < 0) {
+        free(st);
+        *err = make_err("sit13: invalid header or tree construction failed");
+        return false;
+    }
+
+    // Decode uncomp_len bytes through the main loop
+    int produced = m13_output(st, out, uncomp_len);
+    free(st);
+
+    if (produced < 0 || (size_t)produced != uncomp_len) {
+        *err = make_err("sit13: decompression failed (produced %d of %zu bytes)",
+                        produced, uncomp_len);
+        return false;
+    }
+    return true;
+}
+
+// Decompress method-13 data into a freshly allocated buffer.
 peel_buf_t peel_sit13(const uint8_t *src, size_t len, size_t uncomp_len, peel_err_t **err) {
     *err = NULL;
 
@@ -621,41 +655,63 @@ peel_buf_t peel_sit13(const uint8_t *src, size_t len, size_t uncomp_len, peel_er
     }
 
     // Allocate the output buffer up front (known size from container metadata)
-    uint8_t *out = malloc(uncomp_len);
+    size_t out_cap;
+    uint8_t *out = buf_alloc(uncomp_len, &out_cap);
     if (!out) {
         *err = make_err("sit13: out of memory allocating %zu-byte output buffer", uncomp_len);
         return (peel_buf_t){0};
     }
+    if (!sit13_decode_into(src, len, out, uncomp_len, err)) {
+        buf_release(out, out_cap);
+        return (peel_buf_t){0};
+    }
+    return (peel_buf_t){.data = out, .size = uncomp_len, .owned = true, .cap = out_cap};
+}
+
+// Decode method-13 data like peel_sit13(), but hand the output to fn in
+// VERIFY_CHUNK pieces instead of keeping it (peel_verify()).
+bool sit13_stream(const uint8_t *src, size_t len, size_t uncomp_len, chunk_fn fn, void *ctx,
+                  peel_err_t **err) {
+    *err = NULL;
+    if (uncomp_len == 0) {
+        return true;
+    }
 
-    // The decoder state is large (~70 KiB), so heap-allocate to avoid stack overflow
     m13_state_t *st = calloc(1, sizeof(*st));
     if (!st) {
-        free(out);
         *err = make_err("sit13: out of memory allocating decoder state");
-        return (peel_buf_t){0};
+        return false;
     }
-
-    // Initialise bit reader over the compressed input
     m13_br_init(&st->br, src, len);
-
-    // Parse header and build Huffman trees
     if (m13_setup(st) < 0) {
-        free(out);
         free(st);
         *err = make_err("sit13: invalid header or tree construction failed");
-        return (peel_buf_t){0};
+        return false;
     }
 
-    // Decode uncomp_len bytes through the main loop
-    int produced = m13_output(st, out, uncomp_len);
+    uint8_t chunk[VERIFY_CHUNK];
+    size_t done = 0;
+    while (done < uncomp_len) {
+        size_t want = uncomp_len - done < sizeof(chunk) ? uncomp_len - done : sizeof(chunk);
+        int n = m13_output(st, chunk, want);
+        if (n <= 0) {
+            break;
+        }
+        fn(chunk, (size_t)n, ctx);
+        done += (size_t)n;
+    }
     free(st);
 
-    if (produced < 0 || (size_t)produced != uncomp_len) {
-        free(out);
-        *err = make_err("sit13: decompression failed (produced %d of %zu bytes)",
-                        produced, uncomp_len);
-        return (peel_buf_t){0};
+    if (done != uncomp_len) {
+        *err = make_err("sit13: decompression failed (produced %zu of %zu bytes)", done,
+                        uncomp_len);
+        return false;
     }
+    return true;
+}
 
-    return (peel_buf_t){.data = out, .size = uncomp_len, .owned = true};
+// Working memory peel_sit13() needs beyond its output: the decoder state,
+// dominated by the sliding window and Huffman node pool.
+size_t sit13_work_size(void) {
+    return sizeof(m13_state_t);
 }
@@ -556,8 +556,8 @@ static uint8_t produce_byte(arsenic_state *s)
 // Stream Header — sit15.md §5.1 "Stream Header"
 // ============================================================================
 
-// Parse the Arsenic stream header: signature, block-size exponent, initial EOS.
-static bool parse_header(arsenic_state *s)
+// Read the Arsenic stream header: signature, block-size exponent, initial EOS.
+static void read_header(arsenic_state *s)
 {
     // §4.2  Bootstrap the arithmetic decoder.
     s->ac.range = AC_ONE;
@@ -581,6 +581,12 @@ static bool parse_header(arsenic_state *s)
 
     // Initial end-of-stream flag.
     s->eos = ac_decode_sym(s, &s->m_primary) != 0;
+}
+
+// Parse the stream header and allocate the block buffers it calls for.
+static bool parse_header(arsenic_state *s)
+{
+    read_header(s);
 
     // Allocate block buffers.
     s->blk_buf = malloc((size_t)s->blk_cap);
@@ -605,44 +611,31 @@ static void free_buffers(arsenic_state *s)
 // Entry Point (Internal)
 // ============================================================================
 
-// Decompress method-15 (Arsenic) compressed data into a freshly allocated buffer.
+// Decompress method-15 (Arsenic) compressed data into out, which holds
+// uncomp_len bytes (a pool buffer, or caller memory from a peel_sink_t).
 // Called by sit.c for entries using compression method 15.
 //
 // sit15.md § "Appendix A: Complete Decompression Walkthrough"
 //   1. Parse stream header, bootstrap arithmetic decoder.
 //   2. Decode blocks (selector loop → MTF → inverse BWT).
 //   3. Expand via randomization + final RLE.
-//   4. Return the output buffer.
-peel_buf_t peel_sit15(const uint8_t *src, size_t len, size_t uncomp_len, peel_err_t **err) {
+bool sit15_decode_into(const uint8_t *src, size_t len, uint8_t *out, size_t uncomp_len,
+                       peel_err_t **err) {
     *err = NULL;
 
-    // Handle degenerate case: zero-length output
-    if (uncomp_len == 0) {
-        return (peel_buf_t){.data = NULL, .size = 0, .owned = false};
-    }
-
-    // Allocate the output buffer up front (known size from container metadata)
-    uint8_t *out = malloc(uncomp_len);
-    if (!out) {
-        *err = make_err("sit15: out of memory allocating %zu-byte output buffer", uncomp_len);
-        return (peel_buf_t){0};
-    }
-
     // Use setjmp/longjmp for deep-error abort during decompression
     decode_ctx_t dctx;
     if (setjmp(dctx.jmp) != 0) {
         // Arrived here via arsenic_abort — propagate the error message
-        free(out);
         *err = make_err("%s", dctx.errmsg);
-        return (peel_buf_t){0};
+        return false;
     }
 
     // The decoder state is large, so heap-allocate to avoid stack overflow.
     arsenic_state *s = calloc(1, sizeof *s);
     if (!s) {
-        free(out);
         *err = make_err("sit15: out of memory allocating decoder state");
-        return (peel_buf_t){0};
+        return false;
     }
 
     // Wire up the decode context for longjmp error handling
@@ -661,6 +654,89 @@ peel_buf_t peel_sit15(const uint8_t *src, size_t len, size_t uncomp_len, peel_er
     // Clean up decoder state
     free_buffers(s);
     free(s);
+    return true;
+}
+
+// Decompress method-15 data into a freshly allocated buffer.
+peel_buf_t peel_sit15(const uint8_t *src, size_t len, size_t uncomp_len, peel_err_t **err) {
+    *err = NULL;
+
+    // Handle degenerate case: zero-length output
+    if (uncomp_len == 0) {
+        return (peel_buf_t){.data = NULL, .size = 0, .owned = false};
+    }
 
-    return (peel_buf_t){.data = out, .size = uncomp_len, .owned = true};
+    // Allocate the output buffer up front (known size from container metadata)
+    size_t out_cap;
+    uint8_t *out = buf_alloc(uncomp_len, &out_cap);
+    if (!out) {
+        *err = make_err("sit15: out of memory allocating %zu-byte output buffer", uncomp_len);
+        return (peel_buf_t){0};
+    }
+    if (!sit15_decode_into(src, len, out, uncomp_len, err)) {
+        buf_release(out, out_cap);
+        return (peel_buf_t){0};
+    }
+    return (peel_buf_t){.data = out, .size = uncomp_len, .owned = true, .cap = out_cap};
+}
+
+// Decode method-15 data like peel_sit15(), but hand the output to fn in
+// VERIFY_CHUNK pieces instead of keeping it (peel_verify()).  fn may be NULL:
+// the container stores no CRC for method 15, so decoding is the whole check.
+bool sit15_stream(const uint8_t *src, size_t len, size_t uncomp_len, chunk_fn fn, void *ctx,
+                  peel_err_t **err) {
+    *err = NULL;
+    if (uncomp_len == 0) {
+        return true;
+    }
+
+    arsenic_state *s = calloc(1, sizeof *s);
+    if (!s) {
+        *err = make_err("sit15: out of memory allocating decoder state");
+        return false;
+    }
+    decode_ctx_t dctx;
+    if (setjmp(dctx.jmp) != 0) {
+        free_buffers(s);
+        free(s);
+        *err = make_err("%s", dctx.errmsg);
+        return false;
+    }
+    s->ctx = &dctx;
+    bs_init(&s->bits, src, len);
+    parse_header(s);
+
+    uint8_t chunk[VERIFY_CHUNK];
+    size_t n = 0;
+    for (size_t i = 0; i < uncomp_len; i++) {
+        chunk[n++] = produce_byte(s);
+        if (n == sizeof(chunk) || i + 1 == uncomp_len) {
+            if (fn) fn(chunk, n, ctx);
+            n = 0;
+        }
+    }
+
+    free_buffers(s);
+    free(s);
+    return true;
+}
+
+// Working memory peel_sit15() needs for this stream beyond its output: the
+// decoder state plus blk_buf and lf_map (sit15.md §11.2), sized from the
+// block-size exponent in the stream header.  Only the header is decoded.  An
+// unreadable header is charged the largest block size, B = 15.
+size_t sit15_work_size(const uint8_t *src, size_t len) {
+    int exp = 15;
+    arsenic_state *s = calloc(1, sizeof *s);
+    if (s) {
+        decode_ctx_t dctx;
+        s->ctx = &dctx;
+        if (setjmp(dctx.jmp) == 0) {
+            bs_init(&s->bits, src, len);
+            read_header(s);
+            exp = s->block_exp;
+        }
+        free(s);
+    }
+    return sizeof(arsenic_state) + 5 * ((size_t)1 << (exp + 9));
 }
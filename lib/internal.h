@@ -58,6 +58,11 @@ static inline uint32_t rd32be(const uint8_t *p) {
     return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
 }
 
+// Read a big-endian 64-bit unsigned integer from a byte pointer.
+static inline uint64_t rd64be(const uint8_t *p) {
+    return (uint64_t)rd32be(p) << 32 | rd32be(p + 4);
+}
+
 // ============================================================================
 // Big-Endian Write Helpers
 // ============================================================================
@@ -76,6 +81,12 @@ static inline void wr32be(uint8_t *p, uint32_t v) {
     p[3] = (uint8_t)(v);
 }
 
+// Write a 64-bit value in big-endian byte order.
+static inline void wr64be(uint8_t *p, uint64_t v) {
+    wr32be(p, (uint32_t)(v >> 32));
+    wr32be(p + 4, (uint32_t)v);
+}
+
 // ============================================================================
 // CRC Routines
 // ============================================================================
@@ -86,6 +97,79 @@ uint16_t crc16_ccitt(const uint8_t *data, size_t len);
 // Update a running CRC-16/CCITT with additional data.
 uint16_t crc16_ccitt_update(uint16_t crc, const uint8_t *data, size_t len);
 
+// ============================================================================
+// Hashing
+// ============================================================================
+
+// 64-bit FNV-1a hash of a byte range, continuing from seed (use
+// FNV1A64_INIT for a fresh hash).
+#define FNV1A64_INIT 0xcbf29ce484222325ULL
+uint64_t fnv1a64(uint64_t seed, const void *data, size_t len);
+
+// SHA-256 of a byte range, for identities that must not collide.
+#define SHA256_LEN 32
+void sha256(const void *data, size_t len, uint8_t out[SHA256_LEN]);
+
+// ============================================================================
+// Timing
+// ============================================================================
+
+// Monotonic clock reading in nanoseconds, for peel_trace_t decode times.
+uint64_t clock_ns(void);
+
+// ============================================================================
+// Buffer Allocation — pool.c
+// ============================================================================
+
+// Allocate at least n bytes for an owned output buffer.  *cap receives the
+// real capacity, which is rounded up to a size class while the pool is on.
+// Returns NULL on allocation failure.
+uint8_t *buf_alloc(size_t n, size_t *cap);
+
+// Release a buffer obtained from buf_alloc() (or any malloc block of
+// capacity cap), recycling it into the pool when possible.
+void buf_release(uint8_t *data, size_t cap);
+
+// Round a capacity up to its pool size class (identity when the pool is off).
+size_t buf_class_size(size_t n);
+
+// ============================================================================
+// Shared Buffers
+// ============================================================================
+
+// Reference-counted backing store behind one or more shared peel_buf_t.
+struct peel_ref {
+    size_t refs; // Live references
+    void (*destroy)(peel_ref_t *r); // Releases base/len when refs reaches 0
+    void *base; // Start of the backing allocation or mapping
+    size_t len; // Size of the backing allocation or mapping
+};
+
+// Create a reference (count 1) over base/len, released by destroy().
+// Returns NULL on allocation failure.
+peel_ref_t *ref_new(void (*destroy)(peel_ref_t *r), void *base, size_t len);
+
+// Add a reference.
+void ref_retain(peel_ref_t *r);
+
+// Drop a reference, destroying the backing store with the last one.
+void ref_drop(peel_ref_t *r);
+
+// Convert an exclusively owned buffer into a shared one (count 1) in place.
+// Returns false (leaving *buf unchanged) on allocation failure.
+bool buf_make_shared(peel_buf_t *buf);
+
+// Return another handle to a shared buffer, adding a reference.
+peel_buf_t buf_share(const peel_buf_t *buf);
+
+// Map fd read-only into a shared buffer, unmapped with its last reference.
+// An empty file yields an empty buffer.  Sets *err on failure.
+peel_buf_t buf_map_fd(int fd, peel_err_t **err);
+
+// Read fd into a shared heap buffer instead (pread(), so the file position
+// is untouched).  A file that shrinks while being read fails with *err set.
+peel_buf_t buf_read_fd(int fd, peel_err_t **err);
+
 // ============================================================================
 // Growable Buffer
 // ============================================================================
@@ -113,6 +197,152 @@ peel_buf_t grow_finish(grow_buf_t *g);
 // Release a growable buffer without producing a peel_buf_t (for error paths).
 void grow_free(grow_buf_t *g);
 
+// ============================================================================
+// File List Builder
+// ============================================================================
+
+// A peel_file_list_t under construction, fed one file at a time (typically
+// from a peel_each_fn callback, which cannot return an error itself).
+typedef struct {
+    peel_file_list_t list; // Files appended so far
+    size_t cap; // Allocated slots in list.files
+    peel_err_t *err; // First allocation failure, if any
+} file_list_builder_t;
+
+// Initialise an empty builder.
+void file_list_builder_init(file_list_builder_t *b);
+
+// Move *f into the list (zeroing *f).  On allocation failure, frees the
+// file's forks, records the error in b->err, and returns false.
+bool file_list_push(file_list_builder_t *b, peel_file_t *f);
+
+// peel_each_fn that pushes each file onto the file_list_builder_t in ctx.
+bool file_list_collect(peel_file_t *file, void *ctx);
+
+// Return the finished list.  If *err is already set, or the builder hit an
+// allocation failure, frees everything collected and returns an empty list.
+peel_file_list_t file_list_builder_finish(file_list_builder_t *b, peel_err_t **err);
+
+// ============================================================================
+// Entry Scanning — lazy access to archive members
+// ============================================================================
+
+// Where one compressed fork lives inside an archive blob and how to decode
+// it.  Recorded by a format's scan pass so the fork can be decoded later.
+typedef struct {
+    size_t offset; // Offset of the packed bytes within the archive blob
+    uint32_t packed_len; // Compressed length
+    uint32_t raw_len; // Uncompressed length (0 = empty fork)
+    uint32_t crc; // Stored checksum, format-specific (0 if none)
+    uint8_t method; // Format-specific compression method ID
+} fork_ref_t;
+
+// One archive member discovered by a scan pass, before any decoding.
+typedef struct {
+    peel_file_meta_t meta;
+    fork_ref_t data_fork;
+    fork_ref_t rsrc_fork;
+} entry_ref_t;
+
+// Receives each scanned member in archive order.  Return false to stop.
+typedef bool (*entry_scan_fn)(const entry_ref_t *ent, void *ctx);
+
+// Predicted resources for decoding one fork (peel_estimate()).
+typedef struct {
+    uint64_t work_bytes; // Decoder working memory beyond the output buffer
+    uint64_t cpu_ns; // Approximate decode time
+} fork_cost_t;
+
+// ============================================================================
+// Verification — verify.c
+// ============================================================================
+
+// Size of the buffer a verify pass decodes each fork through.
+#define VERIFY_CHUNK 4096
+
+// Receives each chunk of output decoded by a verify pass.
+typedef void (*chunk_fn)(const uint8_t *data, size_t len, void *ctx);
+
+// ============================================================================
+// Dedupe Cache — dedupe.c
+// ============================================================================
+
+// Identity of a compressed fork: identical keys decode to identical bytes.
+typedef struct {
+    uint8_t digest[SHA256_LEN]; // SHA-256 of the packed bytes
+    uint32_t packed_len;
+    uint32_t raw_len;
+    uint32_t crc; // Stored checksum from the archive
+    uint8_t method; // Format-specific method ID
+    char format; // Format tag ('s' = StuffIt, 'c' = Compact Pro)
+} dedupe_key_t;
+
+// True when the cache is enabled and a fork of raw_len bytes is worth caching.
+// Callers only ask about forks they will decode whole.
+bool dedupe_wanted(size_t raw_len);
+
+// Build the key for a fork whose packed bytes start at packed.
+dedupe_key_t dedupe_key(char format, const fork_ref_t *ref, const uint8_t *packed);
+
+// On a hit, store a shared reference to the decoded fork in *out.
+bool dedupe_lookup(const dedupe_key_t *key, peel_buf_t *out);
+
+// Cache a freshly decoded, owned fork.  *buf becomes a shared buffer the
+// caller still owns a reference to.  Returns false if it was not cached.
+bool dedupe_store(const dedupe_key_t *key, peel_buf_t *buf);
+
+// ============================================================================
+// Packed File Lists — pack.c
+// ============================================================================
+
+// Alignment of every fork inside a packed list (relative to its start).
+#define PACK_ALIGN 64
+
+// Size of the header plus metadata table for a list of count files.
+size_t pack_table_size(size_t count);
+
+// Write the header and metadata table for list into dst (pack_table_size()
+// bytes) and return the total packed size.  Fork offsets are recorded in the
+// table; the bytes between forks are padding.
+size_t pack_write_table(const peel_file_list_t *list, uint8_t *dst);
+
+// Total packed size of a file list.
+size_t pack_size(const peel_file_list_t *list);
+
+// Write the complete packed list into dst, which holds pack_size() bytes.
+void pack_into(const peel_file_list_t *list, uint8_t *dst);
+
+// Serialize a file list into one owned buffer.
+peel_buf_t pack_file_list(const peel_file_list_t *list, peel_err_t **err);
+
+// Rebuild a file list whose forks point into *blob.  An owned blob is made
+// shared so every fork holds a reference; a borrowed blob yields borrowed
+// forks.  The caller still releases *blob itself with peel_free().
+peel_file_list_t unpack_file_list(peel_buf_t *blob, peel_err_t **err);
+
+// ============================================================================
+// Result Cache — cache.c
+// ============================================================================
+
+// Identity of one peel_path() input.
+typedef struct {
+    uint8_t digest[SHA256_LEN]; // SHA-256 of the input bytes
+    uint64_t len; // Input length
+    char name[128]; // Backend key: digest, length and library version
+} result_key_t;
+
+// True when a result cache backend is installed.
+bool result_cache_active(void);
+
+// Compute the cache key for an input buffer.
+result_key_t result_cache_key(const uint8_t *src, size_t len);
+
+// On a hit, store the cached file list in *out and return true.
+bool result_cache_lookup(const result_key_t *key, peel_file_list_t *out);
+
+// Save a freshly peeled file list (best-effort).
+void result_cache_store(const result_key_t *key, const peel_file_list_t *list);
+
 // ============================================================================
 // Format Handler Registration — architecture.md § "Format Handler Registration"
 // ============================================================================
@@ -123,15 +353,60 @@ typedef enum {
     PEEL_FMT_ARCHIVE, // One buffer in, file list out  (e.g. StuffIt, CPT)
 } peel_fmt_kind_t;
 
+// How an archive's each hook hands out forks (NULL: as peel() would).
+typedef struct {
+    bool views; // A fork stored verbatim may be a view into src, valid only while src is
+    const peel_sink_t *sink; // Decode data forks into memory from sink when it supplies some
+    // Non-NULL when the sink traces: before handing out each member, set
+    // its methods and crc_checked, and the time its forks took as the ns of
+    // the last layer (the archive's own, added by the caller)
+    peel_trace_t *trace;
+    // Most bytes to decode per fork: peel_prefix()'s max_bytes, else SIZE_MAX
+    // (also when opts is NULL).  A fork cut short skips its checksum, is
+    // marked partial and is never sunk, shown as a view or cached.
+    size_t limit;
+} each_opts_t;
+
+// Release a fork handed out by an each hook: a sunk fork goes back through
+// sink->discard(), anything else to peel_free().  peeler.c
+void fork_release(const peel_sink_t *sink, peel_buf_t *b);
+
 // A registered format handler entry in the detection table.
 typedef struct {
     const char *name;
     peel_fmt_kind_t kind;
     bool (*detect)(const uint8_t *src, size_t len);
     peel_buf_t (*peel_wrapper)(const uint8_t *src, size_t len, peel_err_t **err);
-    peel_file_list_t (*peel_archive)(const uint8_t *src, size_t len, peel_err_t **err);
+    // Archives only: extract every member, handing each file to fn as soon
+    // as its forks are decoded, in the way opts asks for
+    void (*each)(const uint8_t *src, size_t len, const each_opts_t *opts, peel_each_fn fn,
+                 void *ctx, peel_err_t **err);
+    // Archives only: enumerate members without decoding, decode one fork
+    void (*scan)(const uint8_t *src, size_t len, entry_scan_fn fn, void *ctx, peel_err_t **err);
+    peel_buf_t (*decode_fork)(const uint8_t *src, size_t len, const fork_ref_t *ref, peel_err_t **err);
+    // Archives only: predict the cost of decode_fork() from headers alone
+    fork_cost_t (*fork_cost)(const uint8_t *src, size_t len, const fork_ref_t *ref);
+    // Wrappers only: locate the payload peel_wrapper() would return without
+    // decoding all of it.  Points *payload into src, or decodes up to cap
+    // bytes into scratch.  Returns the bytes available at *payload and sets
+    // *full_len to the payload's declared length; (size_t)-1 if unreadable.
+    size_t (*probe)(const uint8_t *src, size_t len, const uint8_t **payload, uint8_t *scratch,
+                    size_t cap, uint64_t *full_len);
+    // Wrappers only: approximate decode cost per output byte, in picoseconds
+    uint32_t ps_per_byte;
+    // Wrappers only: peel_wrapper() checks the payload against a stored checksum
+    bool checks_payload;
+    // peel_verify(): decode and check without keeping output.  Wrappers check
+    // the whole file and fill *meta; archives check one scanned member.
+    peel_verify_status_t (*verify)(const uint8_t *src, size_t len, peel_file_meta_t *meta,
+                                   peel_err_t **err);
+    peel_verify_status_t (*verify_entry)(const uint8_t *src, size_t len, const entry_ref_t *ent,
+                                         peel_err_t **err);
 } peel_format_t;
 
+// Return the first registered format whose detect() matches, or NULL.
+const peel_format_t *detect_format(const uint8_t *src, size_t len);
+
 // ============================================================================
 // Per-Format Detect Functions
 // ============================================================================
@@ -146,4 +421,59 @@ bool sit_detect(const uint8_t *src, size_t len);
 
 bool cpt_detect(const uint8_t *src, size_t len);
 
+// ============================================================================
+// Per-Format Probe Functions
+// ============================================================================
+
+size_t hqx_probe(const uint8_t *src, size_t len, const uint8_t **payload, uint8_t *scratch,
+                 size_t cap, uint64_t *full_len);
+
+size_t bin_probe(const uint8_t *src, size_t len, const uint8_t **payload, uint8_t *scratch,
+                 size_t cap, uint64_t *full_len);
+
+// "sit" or "sit5" for whichever StuffIt signature occurs first, else NULL.
+const char *sit_flavor(const uint8_t *src, size_t len);
+
+// ============================================================================
+// Per-Format Scan and Fork Decode Functions
+// ============================================================================
+
+void sit_each(const uint8_t *src, size_t len, const each_opts_t *opts, peel_each_fn fn,
+              void *ctx, peel_err_t **err);
+
+void cpt_each(const uint8_t *src, size_t len, const each_opts_t *opts, peel_each_fn fn,
+              void *ctx, peel_err_t **err);
+
+void sit_scan(const uint8_t *src, size_t len, entry_scan_fn fn, void *ctx, peel_err_t **err);
+
+peel_buf_t sit_decode_fork(const uint8_t *src, size_t len, const fork_ref_t *ref, peel_err_t **err);
+
+void cpt_scan(const uint8_t *src, size_t len, entry_scan_fn fn, void *ctx, peel_err_t **err);
+
+peel_buf_t cpt_decode_fork(const uint8_t *src, size_t len, const fork_ref_t *ref, peel_err_t **err);
+
+// ============================================================================
+// Per-Format Cost Functions
+// ============================================================================
+
+fork_cost_t sit_fork_cost(const uint8_t *src, size_t len, const fork_ref_t *ref);
+
+fork_cost_t cpt_fork_cost(const uint8_t *src, size_t len, const fork_ref_t *ref);
+
+// ============================================================================
+// Per-Format Verify Functions
+// ============================================================================
+
+peel_verify_status_t hqx_verify(const uint8_t *src, size_t len, peel_file_meta_t *meta,
+                                peel_err_t **err);
+
+peel_verify_status_t bin_verify(const uint8_t *src, size_t len, peel_file_meta_t *meta,
+                                peel_err_t **err);
+
+peel_verify_status_t sit_verify_entry(const uint8_t *src, size_t len, const entry_ref_t *ent,
+                                      peel_err_t **err);
+
+peel_verify_status_t cpt_verify_entry(const uint8_t *src, size_t len, const entry_ref_t *ent,
+                                      peel_err_t **err);
+
 #endif // PEELER_INTERNAL_H
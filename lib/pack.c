@@ -0,0 +1,313 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) pappadf
+
+// pack.c
+// Flat serialization of a peel_file_list_t.
+//
+// A packed list is a fixed header, a table with one fixed-size metadata
+// record per file, and the fork bytes, each starting on a PACK_ALIGN
+// boundary.  All integers are big-endian.  Because forks are stored
+// verbatim, a packed list that has been mapped into memory can be turned
+// back into a file list without copying: the forks simply point into it.
+//
+//   Header (32 bytes)
+//     0  "PEELPAK1"
+//     8  u32 file count
+//    12  u32 table record size (PACK_ENTRY_SIZE)
+//    16  u64 total packed size
+//    24  u64 reserved (0)
+//
+//   Table record (PACK_ENTRY_SIZE bytes)
+//     0  name[256], NUL-terminated
+//   256  u32 mac_type, u32 mac_creator, u16 finder_flags, 6 bytes reserved
+//   272  u64 data fork offset, u64 data fork size
+//   288  u64 resource fork offset, u64 resource fork size
+//
+// peel_pack() writes this layout to a file or memfd and peel_unpack_view()
+// maps it back, so extraction results can be handed between processes
+// without copying forks through a pipe.
+
+#ifdef __linux__
+#define _GNU_SOURCE // memfd_create, file sealing
+#else
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// ============================================================================
+// Constants and Macros
+// ============================================================================
+
+#define PACK_MAGIC      "PEELPAK1"
+#define PACK_HDR_SIZE   32
+#define PACK_ENTRY_SIZE 304
+
+// Round n up to the fork alignment.
+#define PACK_ROUND(n) (((n) + (PACK_ALIGN - 1)) & ~(size_t)(PACK_ALIGN - 1))
+
+// ============================================================================
+// Static Helpers
+// ============================================================================
+
+// Validate one fork record and build a view of it inside blob.
+static bool fork_view(const peel_buf_t *blob, size_t data_start, const uint8_t *rec,
+                      peel_buf_t *out) {
+    uint64_t off = rd64be(rec);
+    uint64_t size = rd64be(rec + 8);
+    if (size == 0) {
+        *out = (peel_buf_t){0};
+        return true;
+    }
+    if (off < data_start || off > blob->size || size > blob->size - off) {
+        return false;
+    }
+    *out = (peel_buf_t){.data = blob->data + off, .size = (size_t)size, .ref = blob->ref};
+    if (blob->ref) {
+        ref_retain(blob->ref);
+    }
+    return true;
+}
+
+// Write all of buf at offset, retrying short writes.
+static bool pwrite_all(int fd, const void *buf, size_t len, size_t offset) {
+    const uint8_t *p = buf;
+    while (len) {
+        ssize_t n = pwrite(fd, p, len, (off_t)offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+        offset += (size_t)n;
+    }
+    return true;
+}
+
+// ============================================================================
+// Operations (Internal)
+// ============================================================================
+
+// Size of the header plus metadata table.
+size_t pack_table_size(size_t count) {
+    return PACK_ROUND(PACK_HDR_SIZE + count * PACK_ENTRY_SIZE);
+}
+
+// Lay out the forks after the table and write header + table into dst.
+size_t pack_write_table(const peel_file_list_t *list, uint8_t *dst) {
+    size_t table = pack_table_size(list->count);
+    memset(dst, 0, table);
+
+    size_t pos = table;
+    for (size_t i = 0; i < list->count; i++) {
+        const peel_file_t *f = &list->files[i];
+        uint8_t *rec = dst + PACK_HDR_SIZE + i * PACK_ENTRY_SIZE;
+        memcpy(rec, f->meta.name, sizeof(f->meta.name) - 1);
+        wr32be(rec + 256, f->meta.mac_type);
+        wr32be(rec + 260, f->meta.mac_creator);
+        wr16be(rec + 264, f->meta.finder_flags);
+
+        const peel_buf_t *forks[2] = {&f->data_fork, &f->resource_fork};
+        for (int k = 0; k < 2; k++) {
+            size_t size = forks[k]->size;
+            wr64be(rec + 272 + k * 16, size ? pos : 0);
+            wr64be(rec + 280 + k * 16, size);
+            pos = PACK_ROUND(pos + size);
+        }
+    }
+
+    memcpy(dst, PACK_MAGIC, 8);
+    wr32be(dst + 8, (uint32_t)list->count);
+    wr32be(dst + 12, PACK_ENTRY_SIZE);
+    wr64be(dst + 16, pos);
+    return pos;
+}
+
+// Total packed size of a file list.
+size_t pack_size(const peel_file_list_t *list) {
+    size_t pos = pack_table_size(list->count);
+    for (size_t i = 0; i < list->count; i++) {
+        pos = PACK_ROUND(pos + list->files[i].data_fork.size);
+        pos = PACK_ROUND(pos + list->files[i].resource_fork.size);
+    }
+    return pos;
+}
+
+// Write the complete packed list into dst (pack_size() bytes).
+void pack_into(const peel_file_list_t *list, uint8_t *dst) {
+    pack_write_table(list, dst);
+    size_t pos = pack_table_size(list->count);
+    for (size_t i = 0; i < list->count; i++) {
+        const peel_buf_t *forks[2] = {&list->files[i].data_fork, &list->files[i].resource_fork};
+        for (int k = 0; k < 2; k++) {
+            size_t size = forks[k]->size;
+            size_t next = PACK_ROUND(pos + size);
+            if (size) {
+                memcpy(dst + pos, forks[k]->data, size);
+            }
+            memset(dst + pos + size, 0, next - pos - size);
+            pos = next;
+        }
+    }
+}
+
+// Serialize a file list into one owned buffer.
+peel_buf_t pack_file_list(const peel_file_list_t *list, peel_err_t **err) {
+    *err = NULL;
+    if (list->count > UINT32_MAX) {
+        *err = make_err("pack: too many files (%zu)", list->count);
+        return (peel_buf_t){0};
+    }
+    size_t total = pack_size(list);
+    size_t cap;
+    uint8_t *out = buf_alloc(total, &cap);
+    if (!out) {
+        *err = make_err("pack: out of memory allocating %zu bytes", total);
+        return (peel_buf_t){0};
+    }
+    pack_into(list, out);
+    return (peel_buf_t){.data = out, .size = total, .owned = true, .cap = cap};
+}
+
+// Rebuild a file list whose forks are views into *blob.
+peel_file_list_t unpack_file_list(peel_buf_t *blob, peel_err_t **err) {
+    *err = NULL;
+    const uint8_t *p = blob->data;
+    if (blob->size < PACK_HDR_SIZE || memcmp(p, PACK_MAGIC, 8) != 0) {
+        *err = make_err("pack: not a packed file list");
+        return (peel_file_list_t){0};
+    }
+    size_t count = rd32be(p + 8);
+    size_t table = pack_table_size(count);
+    if (rd32be(p + 12) != PACK_ENTRY_SIZE || rd64be(p + 16) != blob->size ||
+        table > blob->size) {
+        *err = make_err("pack: corrupt header");
+        return (peel_file_list_t){0};
+    }
+    if (blob->owned && !buf_make_shared(blob)) {
+        *err = make_err("pack: out of memory");
+        return (peel_file_list_t){0};
+    }
+
+    peel_file_list_t list = {0};
+    if (count) {
+        list.files = calloc(count, sizeof(peel_file_t));
+        if (!list.files) {
+            *err = make_err("pack: out of memory");
+            return (peel_file_list_t){0};
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *rec = p + PACK_HDR_SIZE + i * PACK_ENTRY_SIZE;
+        peel_file_t *f = &list.files[i];
+        memcpy(f->meta.name, rec, sizeof(f->meta.name) - 1);
+        f->meta.mac_type = rd32be(rec + 256);
+        f->meta.mac_creator = rd32be(rec + 260);
+        f->meta.finder_flags = rd16be(rec + 264);
+        list.count = i + 1;
+        if (!fork_view(blob, table, rec + 272, &f->data_fork) ||
+            !fork_view(blob, table, rec + 288, &f->resource_fork)) {
+            peel_file_list_free(&list);
+            *err = make_err("pack: fork %zu extends past end of data", i);
+            return (peel_file_list_t){0};
+        }
+    }
+    return list;
+}
+
+// ============================================================================
+// Operations (Public API)
+// ============================================================================
+
+// Replace the contents of fd with the packed form of list.
+bool peel_pack(const peel_file_list_t *list, int fd, peel_err_t **err) {
+    *err = NULL;
+    if (list->count > UINT32_MAX) {
+        *err = make_err("pack: too many files (%zu)", list->count);
+        return false;
+    }
+    size_t table = pack_table_size(list->count);
+    uint8_t *hdr = malloc(table);
+    if (!hdr) {
+        *err = make_err("pack: out of memory");
+        return false;
+    }
+    size_t total = pack_write_table(list, hdr);
+
+    // Size the file first so the padding between forks reads back as zeros
+    if (ftruncate(fd, 0) != 0 || ftruncate(fd, (off_t)total) != 0) {
+        free(hdr);
+        *err = make_err("pack: cannot resize output (%s)", strerror(errno));
+        return false;
+    }
+    bool ok = pwrite_all(fd, hdr, table, 0);
+    for (size_t i = 0; ok && i < list->count; i++) {
+        const peel_file_t *f = &list->files[i];
+        const uint8_t *rec = hdr + PACK_HDR_SIZE + i * PACK_ENTRY_SIZE;
+        if (f->data_fork.size) {
+            ok = pwrite_all(fd, f->data_fork.data, f->data_fork.size, rd64be(rec + 272));
+        }
+        if (ok && f->resource_fork.size) {
+            ok = pwrite_all(fd, f->resource_fork.data, f->resource_fork.size, rd64be(rec + 288));
+        }
+    }
+    free(hdr);
+    if (!ok) {
+        *err = make_err("pack: write failed (%s)", strerror(errno));
+    }
+    return ok;
+}
+
+// Pack list into a fresh anonymous file and return its descriptor.
+int peel_pack_memfd(const peel_file_list_t *list, peel_err_t **err) {
+    *err = NULL;
+#ifdef __linux__
+    int fd = memfd_create("peel-pack", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+    char path[] = "/tmp/peel-pack-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+        unlink(path);
+    }
+#endif
+    if (fd < 0) {
+        *err = make_err("pack: cannot create memory file (%s)", strerror(errno));
+        return -1;
+    }
+    if (!peel_pack(list, fd, err)) {
+        close(fd);
+        return -1;
+    }
+#ifdef __linux__
+    // Receivers may map it without fearing later truncation or rewrites
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+#endif
+    return fd;
+}
+
+// Map a packed result and return a file list of views into the mapping.
+// Only a file sealed against shrinking and writes is mapped; any other is
+// read into memory, since its sender could still truncate it under us.
+peel_file_list_t peel_unpack_view(int fd, peel_err_t **err) {
+    bool sealed = false;
+#ifdef __linux__
+    int seals = fcntl(fd, F_GET_SEALS);
+    sealed = seals >= 0 && (seals & (F_SEAL_SHRINK | F_SEAL_WRITE)) ==
+                               (F_SEAL_SHRINK | F_SEAL_WRITE);
+#endif
+    peel_buf_t blob = sealed ? buf_map_fd(fd, err) : buf_read_fd(fd, err);
+    if (*err) {
+        return (peel_file_list_t){0};
+    }
+    peel_file_list_t list = unpack_file_list(&blob, err);
+    peel_free(&blob);
+    return list;
+}
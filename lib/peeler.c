@@ -17,6 +17,20 @@
 // degenerate or malicious inputs that detect as wrappers in a loop).
 #define MAX_PEEL_DEPTH 32
 
+// peel_probe_chain(): bytes of each layer scanned for signatures, and bytes
+// of a wrapper's payload decoded to identify the next layer.
+#define PROBE_WINDOW (64 * 1024)
+#define PROBE_PREFIX 4096
+
+// Wrapper decode cost per output byte, in picoseconds, for peel_estimate()
+// (-O2, ~3 GHz x86-64 core).  MacBinary is a single copy.
+#define HQX_PS_PER_BYTE 8600
+#define BIN_PS_PER_BYTE 100
+
+// Inputs that cannot report their size up front (pipes, FIFOs, standard
+// input) are read in chunks of this size into a geometrically growing buffer.
+#define READ_CHUNK (64 * 1024)
+
 // ============================================================================
 // Format Handler Table — architecture.md § "Static Registration"
 // ============================================================================
@@ -24,20 +38,42 @@
 // Detection order matters: wrappers first so outer encodings are stripped
 // before probing for archive signatures buried inside.
 static const peel_format_t g_formats[] = {
-    {"hqx", PEEL_FMT_WRAPPER, hqx_detect, peel_hqx, NULL    },
-    {"bin", PEEL_FMT_WRAPPER, bin_detect, peel_bin, NULL    },
-    {"sit", PEEL_FMT_ARCHIVE, sit_detect, NULL,     peel_sit},
-    {"cpt", PEEL_FMT_ARCHIVE, cpt_detect, NULL,     peel_cpt},
+    {.name = "hqx", .kind = PEEL_FMT_WRAPPER, .detect = hqx_detect, .peel_wrapper = peel_hqx,
+     .probe = hqx_probe, .ps_per_byte = HQX_PS_PER_BYTE, .checks_payload = true,
+     .verify = hqx_verify},
+    {.name = "bin", .kind = PEEL_FMT_WRAPPER, .detect = bin_detect, .peel_wrapper = peel_bin,
+     .probe = bin_probe, .ps_per_byte = BIN_PS_PER_BYTE, .verify = bin_verify},
+    {.name = "sit", .kind = PEEL_FMT_ARCHIVE, .detect = sit_detect, .each = sit_each,
+     .scan = sit_scan, .decode_fork = sit_decode_fork, .fork_cost = sit_fork_cost,
+     .verify_entry = sit_verify_entry},
+    {.name = "cpt", .kind = PEEL_FMT_ARCHIVE, .detect = cpt_detect, .each = cpt_each,
+     .scan = cpt_scan, .decode_fork = cpt_decode_fork, .fork_cost = cpt_fork_cost,
+     .verify_entry = cpt_verify_entry},
 };
 
 static const int g_num_formats = (int)(sizeof(g_formats) / sizeof(g_formats[0]));
 
 // ============================================================================
-// Static Helpers
+// Type Definitions (Private)
+// ============================================================================
+
+// peel_each(): the caller's callback, wrapped by each_forward().
+typedef struct {
+    peel_each_fn fn;
+    void *ctx;
+    const uint8_t *file; // peel_fd_each_extents(): the input read into memory, else NULL
+    size_t file_len;
+    const peel_sink_t *sink; // peel_fd_each_into(): where data forks may be decoded
+    peel_trace_t trace; // sink->trace(): how the file being delivered was produced
+    peel_err_t *err; // Out of memory settling a view
+} each_state_t;
+
+// ============================================================================
+// Operations (Internal)
 // ============================================================================
 
 // Walk the handler table and return the first format whose detect() matches.
-static const peel_format_t *detect_format(const uint8_t *src, size_t len) {
+const peel_format_t *detect_format(const uint8_t *src, size_t len) {
     for (int i = 0; i < g_num_formats; i++) {
         if (g_formats[i].detect(src, len)) {
             return &g_formats[i];
@@ -46,10 +82,66 @@ static const peel_format_t *detect_format(const uint8_t *src, size_t len) {
     return NULL;
 }
 
+// Hand a sunk fork back to its sink, or free any other fork.
+void fork_release(const peel_sink_t *sink, peel_buf_t *b) {
+    if (b->sunk && sink) {
+        sink->discard(sink->ctx, b->data, b->cap);
+        memset(b, 0, sizeof(*b));
+        return;
+    }
+    peel_free(b);
+}
+
+// ============================================================================
+// Static Helpers
+// ============================================================================
+
+// Append a layer to t (NULL is ignored); layers past PEEL_PROBE_MAX are
+// dropped.
+static void trace_layer(peel_trace_t *t, const char *format, uint64_t ns) {
+    if (t && t->count < PEEL_PROBE_MAX) {
+        t->layers[t->count++] = (peel_trace_layer_t){.format = format, .ns = ns};
+    }
+}
+
+// peel_prefix(): decode a wrapper payload only as far as limit when it ends
+// the chain.  Payloads that fit, or whose first PROBE_WINDOW bytes hold
+// another recognised format, are decoded in full by peel_wrapper().
+static peel_buf_t peel_wrapper_prefix(const peel_format_t *fmt, const uint8_t *src, size_t len,
+                                      size_t limit, peel_err_t **err) {
+    *err = NULL;
+    size_t want = limit > PROBE_WINDOW ? limit : PROBE_WINDOW;
+    const uint8_t *payload = NULL;
+    uint64_t full_len = 0;
+    if (fmt->probe(src, len, &payload, NULL, 0, &full_len) == (size_t)-1 || full_len <= want) {
+        return fmt->peel_wrapper(src, len, err);
+    }
+
+    size_t cap;
+    uint8_t *buf = buf_alloc(want, &cap);
+    if (!buf) {
+        *err = make_err("out of memory decoding %s prefix", fmt->name);
+        return (peel_buf_t){0};
+    }
+    size_t n = fmt->probe(src, len, &payload, buf, want, &full_len);
+    if (n != (size_t)-1) {
+        n = n < want ? n : want;
+        if (payload != buf) {
+            memcpy(buf, payload, n);
+        }
+    }
+    if (n == (size_t)-1 || detect_format(buf, n)) {
+        buf_release(buf, cap);
+        return fmt->peel_wrapper(src, len, err);
+    }
+    n = n < limit ? n : limit;
+    return (peel_buf_t){.data = buf, .size = n, .owned = true, .cap = cap, .partial = n < full_len};
+}
+
 // Wrap a raw buffer as a single-file result with no metadata.
-// If `owned_data` is non-NULL, ownership of that allocation is transferred
+// If `owned` holds data, ownership of that allocation is transferred
 // into the result.  Otherwise the data at `src` is copied.
-static peel_file_list_t wrap_single_file(const uint8_t *src, size_t len, uint8_t *owned_data, peel_err_t **err) {
+static peel_file_list_t wrap_single_file(const uint8_t *src, size_t len, peel_buf_t *owned, peel_err_t **err) {
     peel_file_t *files = calloc(1, sizeof(peel_file_t));
     if (!files) {
         *err = make_err("out of memory allocating single-file result");
@@ -57,9 +149,10 @@ static peel_file_list_t wrap_single_file(const uint8_t *src, size_t len, uint8_t
         return (peel_file_list_t){0};
     }
 
-    if (owned_data) {
+    if (owned && owned->data) {
         // Transfer ownership of the existing allocation
-        files[0].data_fork = (peel_buf_t){.data = owned_data, .size = len, .owned = true};
+        files[0].data_fork = *owned;
+        memset(owned, 0, sizeof(*owned));
     } else {
         // Copy the borrowed input into a fresh buffer
         files[0].data_fork = peel_buf_copy(src, len, err);
@@ -72,6 +165,40 @@ static peel_file_list_t wrap_single_file(const uint8_t *src, size_t len, uint8_t
     return (peel_file_list_t){.files = files, .count = 1};
 }
 
+// Read fp until end of file into an owned buffer that grows by half again
+// whenever it fills.  For inputs whose size is unknown until they end.
+static peel_buf_t read_stream(FILE *fp, const char *name, peel_err_t **err) {
+    grow_buf_t g = {0};
+    decode_ctx_t ctx;
+    if (setjmp(ctx.jmp) != 0) {
+        grow_free(&g);
+        *err = make_err("reading '%s': %s", name, ctx.errmsg);
+        return (peel_buf_t){0};
+    }
+
+    uint8_t chunk[READ_CHUNK];
+    grow_init(&g, READ_CHUNK * 4, &ctx);
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        grow_append(&g, chunk, n, &ctx);
+    }
+    if (ferror(fp)) {
+        *err = make_err("read error on '%s': %s", name, strerror(errno));
+        grow_free(&g);
+        return (peel_buf_t){0};
+    }
+    return grow_finish(&g);
+}
+
+// ============================================================================
+// Operations (Public API) — Version
+// ============================================================================
+
+// Version string this library was built as.
+const char *peel_version(void) {
+    return PEEL_VERSION;
+}
+
 // ============================================================================
 // Operations (Public API) — Format Detection
 // ============================================================================
@@ -82,42 +209,88 @@ const char *peel_detect(const uint8_t *src, size_t len) {
     return fmt ? fmt->name : NULL;
 }
 
+// Identify every layer from headers and payload prefixes alone.  Each layer
+// is scanned over at most PROBE_WINDOW bytes, so the cost does not grow with
+// the input size.
+size_t peel_probe_chain(const uint8_t *src, size_t len, peel_chain_t *out) {
+    memset(out, 0, sizeof(*out));
+
+    // Decoded prefixes alternate between two buffers: a wrapper's probe reads
+    // the previous prefix while writing the next one
+    uint8_t scratch[2][PROBE_PREFIX];
+    int which = 0;
+    const uint8_t *cur = src;
+    size_t cur_len = len;
+    uint64_t size = len;
+
+    while (out->count < PEEL_PROBE_MAX && cur_len > 0) {
+        size_t window = cur_len < PROBE_WINDOW ? cur_len : PROBE_WINDOW;
+        const peel_format_t *fmt = detect_format(cur, window);
+        if (!fmt) {
+            break;
+        }
+        const char *name = fmt->name;
+        if (strcmp(name, "sit") == 0) {
+            name = sit_flavor(cur, window);
+        }
+        out->layers[out->count++] = (peel_layer_t){.format = name, .size = size};
+        if (fmt->kind != PEEL_FMT_WRAPPER || !fmt->probe) {
+            break;
+        }
+
+        const uint8_t *next = NULL;
+        uint64_t next_size = 0;
+        size_t n = fmt->probe(cur, cur_len, &next, scratch[which], PROBE_PREFIX, &next_size);
+        if (n == (size_t)-1) {
+            break; // Header unreadable; the layer itself is still reported
+        }
+        cur = next;
+        cur_len = n;
+        size = next_size;
+        which ^= 1;
+    }
+    return out->count;
+}
+
 // ============================================================================
 // Operations (Public API) — Main Entry Points
 // ============================================================================
 
 // Forward declaration for recursive peeling.
-static peel_file_list_t peel_depth(const uint8_t *src, size_t len, int depth, peel_err_t **err);
+static peel_file_list_t peel_depth(const uint8_t *src, size_t len, int depth, size_t limit,
+                                   peel_err_t **err);
 
 // Recursively peel extracted files whose data forks contain recognized
 // formats.  This handles archives-inside-archives (e.g. .sit containing
 // a .sit.hqx file).
 // architecture.md § "Recursive Peeling"
-static peel_file_list_t recursive_peel_files(peel_file_list_t list, int depth, peel_err_t **err) {
+static peel_file_list_t recursive_peel_files(peel_file_list_t list, int depth, size_t limit,
+                                             peel_err_t **err) {
     if (list.count == 0) {
         return list;
     }
 
     // Collect results in a new list.  Most files will pass through unchanged,
     // but some may expand into multiple files.
-    int result_cap = list.count;
-    int result_count = 0;
-    peel_file_t *result = calloc((size_t)result_cap, sizeof(peel_file_t));
+    size_t result_cap = list.count;
+    size_t result_count = 0;
+    peel_file_t *result = calloc(result_cap, sizeof(peel_file_t));
     if (!result) {
         *err = make_err("out of memory in recursive peel");
         peel_file_list_free(&list);
         return (peel_file_list_t){0};
     }
 
-    for (int i = 0; i < list.count; i++) {
+    for (size_t i = 0; i < list.count; i++) {
         peel_file_t *f = &list.files[i];
 
         // Check if this file's data fork is itself a recognized wrapper or
         // archive format.  Only peel further through WRAPPER formats to
         // avoid false positives on large binary files (e.g. disk images)
-        // that may incidentally contain archive signatures.
+        // that may incidentally contain archive signatures.  A partial fork
+        // (peel_prefix()) is a preview, not something to decode further.
         const peel_format_t *fmt = NULL;
-        if (f->data_fork.data && f->data_fork.size > 0) {
+        if (f->data_fork.data && f->data_fork.size > 0 && !f->data_fork.partial) {
             fmt = detect_format(f->data_fork.data, f->data_fork.size);
             if (fmt && fmt->kind != PEEL_FMT_WRAPPER) {
                 fmt = NULL; // Only recurse through wrappers
@@ -128,7 +301,7 @@ static peel_file_list_t recursive_peel_files(peel_file_list_t list, int depth, p
             // Grow result if needed
             if (result_count >= result_cap) {
                 result_cap = result_cap * 2;
-                peel_file_t *tmp = realloc(result, (size_t)result_cap * sizeof(peel_file_t));
+                peel_file_t *tmp = realloc(result, result_cap * sizeof(peel_file_t));
                 if (!tmp) {
                     *err = make_err("out of memory growing recursive peel list");
                     goto fail;
@@ -143,13 +316,14 @@ static peel_file_list_t recursive_peel_files(peel_file_list_t list, int depth, p
 
         // Recursively peel this file's data fork
         peel_err_t *sub_err = NULL;
-        peel_file_list_t sub = peel_depth(f->data_fork.data, f->data_fork.size, depth + 1, &sub_err);
+        peel_file_list_t sub =
+            peel_depth(f->data_fork.data, f->data_fork.size, depth + 1, limit, &sub_err);
         if (sub_err) {
             // Recursive peel failed — keep the original file as-is
             peel_err_free(sub_err);
             if (result_count >= result_cap) {
                 result_cap = result_cap * 2;
-                peel_file_t *tmp = realloc(result, (size_t)result_cap * sizeof(peel_file_t));
+                peel_file_t *tmp = realloc(result, result_cap * sizeof(peel_file_t));
                 if (!tmp) {
                     *err = make_err("out of memory growing recursive peel list");
                     goto fail;
@@ -162,10 +336,10 @@ static peel_file_list_t recursive_peel_files(peel_file_list_t list, int depth, p
         }
 
         // Replace this file with the sub-results
-        int need = result_count + sub.count;
+        size_t need = result_count + sub.count;
         if (need > result_cap) {
             result_cap = need * 2;
-            peel_file_t *tmp = realloc(result, (size_t)result_cap * sizeof(peel_file_t));
+            peel_file_t *tmp = realloc(result, result_cap * sizeof(peel_file_t));
             if (!tmp) {
                 *err = make_err("out of memory growing recursive peel list");
                 peel_file_list_free(&sub);
@@ -173,7 +347,7 @@ static peel_file_list_t recursive_peel_files(peel_file_list_t list, int depth, p
             }
             result = tmp;
         }
-        for (int j = 0; j < sub.count; j++) {
+        for (size_t j = 0; j < sub.count; j++) {
             result[result_count++] = sub.files[j];
         }
         // Free the sub-list array (but not the individual file buffers,
@@ -191,7 +365,7 @@ static peel_file_list_t recursive_peel_files(peel_file_list_t list, int depth, p
 
 fail:
     // Clean up partial results and original list
-    for (int j = 0; j < result_count; j++) {
+    for (size_t j = 0; j < result_count; j++) {
         peel_free(&result[j].data_fork);
         peel_free(&result[j].resource_fork);
     }
@@ -203,11 +377,91 @@ fail:
 // Detect all layers, peel wrappers, then extract the archive.
 // architecture.md § "peel Implementation Sketch"
 peel_file_list_t peel(const uint8_t *src, size_t len, peel_err_t **err) {
-    return peel_depth(src, len, 0, err);
+    return peel_depth(src, len, 0, SIZE_MAX, err);
+}
+
+// Peel with every extracted fork cut to its first max_bytes.
+peel_file_list_t peel_prefix(const uint8_t *src, size_t len, size_t max_bytes, peel_err_t **err) {
+    return peel_depth(src, len, 0, max_bytes, err);
+}
+
+// Repeatedly strip wrapper layers until an archive or unknown data is found.
+// On return *cur/*cur_len is the innermost layer, held in *owned if any
+// wrapper was decoded, and the archive handler (or NULL) is returned.
+// With views, a payload stored in place in the caller's buffer (MacBinary)
+// is used where it lies instead of being copied out.  Below a limit other
+// than SIZE_MAX (peel_prefix()), a payload ending the chain is decoded only
+// that far.  With trace, each wrapper is recorded as a layer with the time
+// it took.
+static const peel_format_t *strip_wrappers(const uint8_t **cur, size_t *cur_len, peel_buf_t *owned,
+                                           bool views, size_t limit, peel_trace_t *trace,
+                                           peel_err_t **err) {
+    for (int wrap_depth = 0; wrap_depth < MAX_PEEL_DEPTH; wrap_depth++) {
+        const peel_format_t *fmt = detect_format(*cur, *cur_len);
+        if (!fmt || fmt->kind == PEEL_FMT_ARCHIVE) {
+            return fmt; // Terminal: an archive, or nothing recognised
+        }
+        uint64_t start = trace ? clock_ns() : 0;
+        if (trace) {
+            trace->crc_checked = fmt->checks_payload; // The innermost wrapper's say
+        }
+
+        if (views && !owned->data && limit == SIZE_MAX) {
+            const uint8_t *payload = NULL;
+            uint64_t full_len = 0;
+            size_t n = fmt->probe(*cur, *cur_len, &payload, NULL, 0, &full_len);
+            if (n != (size_t)-1 && n == full_len) {
+                *cur = payload;
+                *cur_len = n;
+                trace_layer(trace, fmt->name, trace ? clock_ns() - start : 0);
+                continue;
+            }
+        }
+
+        // Peel one wrapper layer and replace the working buffer
+        peel_buf_t decoded = limit == SIZE_MAX
+                                 ? fmt->peel_wrapper(*cur, *cur_len, err)
+                                 : peel_wrapper_prefix(fmt, *cur, *cur_len, limit, err);
+        if (*err) {
+            return NULL;
+        }
+        trace_layer(trace, fmt->name, trace ? clock_ns() - start : 0);
+        peel_free(owned); // Release previous intermediate (empty-safe)
+        *owned = decoded;
+        *cur = owned->data;
+        *cur_len = owned->size;
+    }
+    return NULL;
+}
+
+// No archive found.  Wrap whatever we have (cut to limit) as a single
+// unnamed file, transferring ownership of `owned` if we peeled any wrappers.
+static peel_file_list_t wrap_payload(const uint8_t *cur, size_t cur_len, peel_buf_t *owned,
+                                     size_t limit, peel_err_t **err) {
+    bool clipped = cur_len > limit;
+    if (clipped) {
+        cur_len = limit;
+        if (owned->data) {
+            owned->size = cur_len;
+        }
+    }
+    peel_file_list_t result = wrap_single_file(cur, cur_len, owned, err);
+    if (*err) {
+        // wrap_single_file failed; it did NOT take ownership on failure
+        peel_free(owned);
+        return (peel_file_list_t){0};
+    }
+    if (clipped) {
+        result.files[0].data_fork.partial = true;
+    }
+    // `owned` buffer is now inside the result — do not free it
+    return result;
 }
 
 // Internal implementation with depth tracking for recursion limiting.
-static peel_file_list_t peel_depth(const uint8_t *src, size_t len, int depth, peel_err_t **err) {
+// Every fork is decoded to at most limit bytes (SIZE_MAX: in full).
+static peel_file_list_t peel_depth(const uint8_t *src, size_t len, int depth, size_t limit,
+                                   peel_err_t **err) {
     *err = NULL;
 
     if (depth >= MAX_PEEL_DEPTH) {
@@ -216,55 +470,164 @@ static peel_file_list_t peel_depth(const uint8_t *src, size_t len, int depth, pe
     }
 
     // `owned` holds the most recent intermediate buffer (heap-allocated by a
-    // wrapper peeler).  NULL while we are still working from the caller's
+    // wrapper peeler).  Empty while we are still working from the caller's
     // original input pointer.
-    uint8_t *owned = NULL;
+    peel_buf_t owned = {0};
     const uint8_t *cur = src;
     size_t cur_len = len;
 
-    // Repeatedly strip wrapper layers until an archive or unknown data is found.
-    for (int wrap_depth = 0; wrap_depth < MAX_PEEL_DEPTH; wrap_depth++) {
-        const peel_format_t *fmt = detect_format(cur, cur_len);
-        if (!fmt) {
-            break; // Nothing recognised — fall through to single-file wrap
-        }
+    const peel_format_t *fmt = strip_wrappers(&cur, &cur_len, &owned, false, limit, NULL, err);
+    if (*err) {
+        peel_free(&owned);
+        return (peel_file_list_t){0};
+    }
 
-        if (fmt->kind == PEEL_FMT_WRAPPER) {
-            // Peel one wrapper layer and replace the working buffer
-            peel_buf_t decoded = fmt->peel_wrapper(cur, cur_len, err);
-            if (*err) {
-                free(owned);
-                return (peel_file_list_t){0};
-            }
-            free(owned); // Release previous intermediate (NULL-safe)
-            owned = decoded.data;
-            cur = owned;
-            cur_len = decoded.size;
-            continue;
+    if (fmt) {
+        // Terminal format — extract files and return
+        each_opts_t opts = {.limit = limit};
+        file_list_builder_t b;
+        file_list_builder_init(&b);
+        fmt->each(cur, cur_len, &opts, file_list_collect, &b, err);
+        peel_file_list_t result = file_list_builder_finish(&b, err);
+        peel_free(&owned);
+        if (*err) {
+            return (peel_file_list_t){0};
         }
+        // Recursively peel extracted files that contain nested archives
+        return recursive_peel_files(result, depth, limit, err);
+    }
+    return wrap_payload(cur, cur_len, &owned, limit, err);
+}
 
-        if (fmt->kind == PEEL_FMT_ARCHIVE) {
-            // Terminal format — extract files and return
-            peel_file_list_t result = fmt->peel_archive(cur, cur_len, err);
-            free(owned);
-            if (*err) {
-                return (peel_file_list_t){0};
-            }
-            // Recursively peel extracted files that contain nested archives
-            return recursive_peel_files(result, depth, err);
+// Make a view fork safe to hand out: bytes lying in the input file
+// become an extent, anything else (a view into a decoded wrapper payload)
+// an owned copy.  Returns false when out of memory.
+static bool settle_view(each_state_t *st, peel_buf_t *b) {
+    if (!b->data || b->owned || b->ref || b->sunk) {
+        return true;
+    }
+    uintptr_t at = (uintptr_t)b->data, base = (uintptr_t)st->file;
+    if (st->file && at >= base && at - base <= st->file_len &&
+        b->size <= st->file_len - (at - base)) {
+        *b = (peel_buf_t){.size = b->size, .extent = true, .offset = at - base};
+        return true;
+    }
+    peel_buf_t copy = peel_buf_copy(b->data, b->size, &st->err);
+    if (st->err) {
+        return false;
+    }
+    *b = copy;
+    return true;
+}
+
+// Pass f to the caller, telling the sink first how it was produced.
+static bool each_emit(each_state_t *st, peel_file_t *f, const peel_trace_t *trace) {
+    if (st->sink && st->sink->trace) {
+        st->sink->trace(st->sink->ctx, f, trace);
+    }
+    return st->fn(f, st->ctx);
+}
+
+// Settle both forks of f and pass it to the caller.  On failure f is
+// released and iteration stops.
+static bool each_deliver(each_state_t *st, peel_file_t *f) {
+    if (!settle_view(st, &f->data_fork) || !settle_view(st, &f->resource_fork)) {
+        fork_release(st->sink, &f->data_fork);
+        peel_free(&f->resource_fork);
+        return false;
+    }
+    return each_emit(st, f, &st->trace);
+}
+
+// peel_each_fn between an archive handler and the caller: peels a file
+// further when its data fork is a wrapper, exactly as recursive_peel_files()
+// would, then forwards the result.
+static bool each_forward(peel_file_t *f, void *ctx) {
+    each_state_t *st = ctx;
+    const peel_format_t *fmt = NULL;
+    if (f->data_fork.data && f->data_fork.size > 0) {
+        fmt = detect_format(f->data_fork.data, f->data_fork.size);
+    }
+    if (!fmt || fmt->kind != PEEL_FMT_WRAPPER) {
+        return each_deliver(st, f);
+    }
+
+    // Files found inside report one more layer for all of that decoding
+    peel_err_t *sub_err = NULL;
+    uint64_t start = clock_ns();
+    peel_file_list_t sub = peel_depth(f->data_fork.data, f->data_fork.size, 1, SIZE_MAX, &sub_err);
+    peel_trace_t trace = st->trace;
+    trace_layer(&trace, fmt->name, clock_ns() - start);
+    trace.data_method = trace.rsrc_method = NULL;
+    trace.crc_checked = false;
+    if (sub_err) {
+        // Recursive peel failed — pass the original file on as-is
+        peel_err_free(sub_err);
+        return each_deliver(st, f);
+    }
+    fork_release(st->sink, &f->data_fork);
+    peel_free(&f->resource_fork);
+
+    // Forward each sub-result; after a stop the rest are just released
+    bool more = true;
+    for (size_t i = 0; i < sub.count; i++) {
+        if (more) {
+            more = each_emit(st, &sub.files[i], &trace);
+        } else {
+            peel_free(&sub.files[i].data_fork);
+            peel_free(&sub.files[i].resource_fork);
         }
     }
+    free(sub.files);
+    return more;
+}
 
-    // No archive found.  Wrap whatever we have as a single unnamed file.
-    // Transfer ownership of `owned` if we peeled any wrappers.
-    peel_file_list_t result = wrap_single_file(cur, cur_len, owned, err);
+// peel_each() body.  With st->file set, forks stored verbatim are handed
+// out as extents of that mapped file instead of copies; with st->sink set,
+// archive data forks may be decoded into the caller's memory.
+static void each_run(const uint8_t *src, size_t len, each_state_t *st, peel_err_t **err) {
+    *err = NULL;
+    bool views = st->file != NULL;
+    peel_trace_t *trace = st->sink && st->sink->trace ? &st->trace : NULL;
+    each_opts_t opts = {.views = views, .sink = st->sink, .trace = trace, .limit = SIZE_MAX};
+    peel_buf_t owned = {0};
+    const uint8_t *cur = src;
+    size_t cur_len = len;
+
+    const peel_format_t *fmt = strip_wrappers(&cur, &cur_len, &owned, views, SIZE_MAX, trace, err);
     if (*err) {
-        // wrap_single_file failed; it did NOT take ownership on failure
-        free(owned);
-        return (peel_file_list_t){0};
+        peel_free(&owned);
+        return;
     }
-    // `owned` pointer is now inside the result — do not free it
-    return result;
+
+    if (fmt) {
+        // The handler fills in this layer's time for each member
+        trace_layer(trace, strcmp(fmt->name, "sit") == 0 ? sit_flavor(cur, cur_len) : fmt->name,
+                    0);
+        fmt->each(cur, cur_len, &opts, each_forward, st, err);
+        peel_free(&owned);
+    } else if (views && !owned.data) {
+        // Unwrapped payload still lying in the input: hand it out in place
+        peel_file_t single = {.data_fork = peel_buf_wrap(cur, cur_len)};
+        each_deliver(st, &single);
+    } else {
+        peel_file_list_t single = wrap_payload(cur, cur_len, &owned, SIZE_MAX, err);
+        if (!*err) {
+            each_emit(st, &single.files[0], &st->trace);
+            free(single.files);
+        }
+    }
+    if (!*err && st->err) {
+        *err = st->err;
+        st->err = NULL;
+    }
+    peel_err_free(st->err);
+}
+
+// Peel every layer and hand each file to fn as soon as it is decoded.
+void peel_each(const uint8_t *src, size_t len, peel_each_fn fn, void *ctx, peel_err_t **err) {
+    each_state_t st = {.fn = fn, .ctx = ctx};
+    each_run(src, len, &st, err);
 }
 
 // Read a file from disk, then peel() its contents.
@@ -277,14 +640,69 @@ peel_file_list_t peel_path(const char *path, peel_err_t **err) {
         return (peel_file_list_t){0};
     }
 
+    // An unchanged input peels to the same result; reuse it if cached
+    peel_file_list_t result;
+    bool cache = result_cache_active();
+    result_key_t key;
+    if (cache) {
+        key = result_cache_key(file_buf.data, file_buf.size);
+        if (result_cache_lookup(&key, &result)) {
+            peel_free(&file_buf);
+            return result;
+        }
+    }
+
     // Run the main peeling loop
-    peel_file_list_t result = peel(file_buf.data, file_buf.size, err);
+    result = peel(file_buf.data, file_buf.size, err);
+    if (cache && !*err) {
+        result_cache_store(&key, &result);
+    }
 
     // Release the input buffer regardless of success
     peel_free(&file_buf);
     return result;
 }
 
+// Read a file from disk, then peel_each() its contents.  The result cache
+// is not consulted: files are handed out as they are decoded.
+void peel_path_each(const char *path, peel_each_fn fn, void *ctx, peel_err_t **err) {
+    peel_buf_t file_buf = peel_read_file(path, err);
+    if (*err) {
+        return;
+    }
+    peel_each(file_buf.data, file_buf.size, fn, ctx, err);
+    peel_free(&file_buf);
+}
+
+// peel_each() with sink hooks.
+void peel_each_into(const uint8_t *src, size_t len, const peel_sink_t *sink, peel_each_fn fn,
+                    void *ctx, peel_err_t **err) {
+    each_state_t st = {.fn = fn, .ctx = ctx, .sink = sink};
+    each_run(src, len, &st, err);
+}
+
+// Read the file on fd and peel_each() it, handing out stored forks as
+// extents of the file rather than copies.
+void peel_fd_each_extents(int fd, peel_each_fn fn, void *ctx, peel_err_t **err) {
+    peel_fd_each_into(fd, NULL, fn, ctx, err);
+}
+
+// peel_fd_each_extents(), with data forks decoded into memory from sink.
+void peel_fd_each_into(int fd, const peel_sink_t *sink, peel_each_fn fn, void *ctx,
+                       peel_err_t **err) {
+    // Read, not mapped: the file may be truncated while it is peeled, and
+    // a mapping would then fault instead of failing a read
+    peel_buf_t in = buf_read_fd(fd, err);
+    if (*err) {
+        return;
+    }
+    each_state_t st = {.fn = fn, .ctx = ctx, .file = in.data, .file_len = in.size,
+                       .sink = sink};
+    static const uint8_t empty[1];
+    each_run(in.data ? in.data : empty, in.size, &st, err);
+    peel_free(&in);
+}
+
 // ============================================================================
 // Operations (Public API) — Buffer Lifecycle
 // ============================================================================
@@ -294,8 +712,12 @@ void peel_free(peel_buf_t *buf) {
     if (!buf) {
         return;
     }
-    if (buf->owned) {
-        free(buf->data);
+    if (buf->ref) {
+        // Shared backing store — released with its last reference
+        ref_drop(buf->ref);
+    } else if (buf->owned) {
+        // Hand the allocation to the pool (or free() when pooling is off)
+        buf_release(buf->data, buf->cap);
     }
     memset(buf, 0, sizeof(*buf));
 }
@@ -305,7 +727,7 @@ void peel_file_list_free(peel_file_list_t *list) {
     if (!list) {
         return;
     }
-    for (int i = 0; i < list->count; i++) {
+    for (size_t i = 0; i < list->count; i++) {
         peel_free(&list->files[i].data_fork);
         peel_free(&list->files[i].resource_fork);
     }
@@ -317,7 +739,8 @@ void peel_file_list_free(peel_file_list_t *list) {
 // Operations (Public API) — Input Helpers
 // ============================================================================
 
-// Read an entire file into an owned buffer.
+// Read an entire file into an owned buffer.  Pipes, FIFOs and other inputs
+// that cannot seek are read until end of file.
 peel_buf_t peel_read_file(const char *path, peel_err_t **err) {
     *err = NULL;
 
@@ -327,25 +750,22 @@ peel_buf_t peel_read_file(const char *path, peel_err_t **err) {
         return (peel_buf_t){0};
     }
 
-    // Determine file size by seeking to the end
-    if (fseek(fp, 0, SEEK_END) != 0) {
-        *err = make_err("cannot seek in '%s': %s", path, strerror(errno));
+    // Determine file size by seeking to the end; an input that cannot seek
+    // (or reports no size, like /proc files) is read incrementally instead
+    long raw_size = fseek(fp, 0, SEEK_END) == 0 ? ftell(fp) : -1;
+    if (raw_size <= 0) {
+        clearerr(fp);
+        peel_buf_t buf = read_stream(fp, path, err);
         fclose(fp);
-        return (peel_buf_t){0};
-    }
-
-    long raw_size = ftell(fp);
-    if (raw_size < 0) {
-        *err = make_err("cannot determine size of '%s': %s", path, strerror(errno));
-        fclose(fp);
-        return (peel_buf_t){0};
+        return buf;
     }
     size_t size = (size_t)raw_size;
 
     // Rewind and read the entire file
     rewind(fp);
 
-    uint8_t *data = malloc(size);
+    size_t cap;
+    uint8_t *data = buf_alloc(size, &cap);
     if (!data) {
         *err = make_err("out of memory reading '%s' (%zu bytes)", path, size);
         fclose(fp);
@@ -357,11 +777,11 @@ peel_buf_t peel_read_file(const char *path, peel_err_t **err) {
 
     if (nread != size) {
         *err = make_err("short read on '%s': expected %zu bytes, got %zu", path, size, nread);
-        free(data);
+        buf_release(data, cap);
         return (peel_buf_t){0};
     }
 
-    return (peel_buf_t){.data = data, .size = size, .owned = true};
+    return (peel_buf_t){.data = data, .size = size, .owned = true, .cap = cap};
 }
 
 // Copy caller-supplied bytes into a new owned buffer.
@@ -372,14 +792,15 @@ peel_buf_t peel_buf_copy(const void *src, size_t len, peel_err_t **err) {
         return (peel_buf_t){0};
     }
 
-    uint8_t *data = malloc(len);
+    size_t cap;
+    uint8_t *data = buf_alloc(len, &cap);
     if (!data) {
         *err = make_err("out of memory (%zu bytes)", len);
         return (peel_buf_t){0};
     }
     memcpy(data, src, len);
 
-    return (peel_buf_t){.data = data, .size = len, .owned = true};
+    return (peel_buf_t){.data = data, .size = len, .owned = true, .cap = cap};
 }
 
 // Create a non-owning view of caller data.  peel_free() on this buffer
@@ -0,0 +1,232 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) pappadf
+
+// pool.c
+// Opt-in size-classed free lists for fork and input buffers.
+//
+// When enabled, peel_free() and peel_file_list_free() hand buffers whose
+// capacity matches a size class back to a per-class free list instead of
+// calling free().  Later decodes that need a buffer of similar size pop it
+// from the list, so a steady-state workload stops round-tripping large
+// allocations through malloc.  The pool is disabled by default; while it is
+// disabled every helper here degrades to plain malloc/free.  One mutex
+// guards the free lists and counters, so any thread may allocate and free.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "internal.h"
+
+#include <pthread.h>
+
+// ============================================================================
+// Constants and Macros
+// ============================================================================
+
+// Smallest pooled class is 4 KiB (2^12); smaller buffers go straight to malloc.
+#define POOL_MIN_EXP 12
+
+// Largest pooled class is 1 GiB (2^30); larger buffers are never cached.
+#define POOL_MAX_EXP 30
+
+// Classes per power-of-two octave: sizes 1.25x, 1.5x, 1.75x, 2x of 2^e,
+// which bounds rounding waste at 25%.
+#define POOL_STEPS 4
+
+// Class 0 is exactly 2^POOL_MIN_EXP; each octave above it adds POOL_STEPS.
+#define POOL_NUM_CLASSES (1 + (POOL_MAX_EXP - POOL_MIN_EXP) * POOL_STEPS)
+
+// ============================================================================
+// Type Definitions (Private)
+// ============================================================================
+
+// Free-list link stored in the first bytes of a cached buffer.
+typedef struct pool_block {
+    struct pool_block *next;
+} pool_block_t;
+
+// Process-wide pool state.  Every field is read and written under lock.
+typedef struct {
+    pthread_mutex_t lock;
+    bool enabled;
+    size_t max_cached; // Upper bound on cached_bytes
+    size_t cached_bytes; // Bytes currently parked on free lists
+    size_t cached_buffers; // Buffers currently parked on free lists
+    uint64_t hits; // Allocations satisfied from a free list
+    uint64_t misses; // Allocations that fell through to malloc
+    pool_block_t *lists[POOL_NUM_CLASSES];
+    size_t counts[POOL_NUM_CLASSES];
+} pool_state_t;
+
+// ============================================================================
+// Static Helpers
+// ============================================================================
+
+static pool_state_t g_pool = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+// Byte size of class index c.
+static size_t pool_class_size(int c) {
+    if (c == 0) {
+        return (size_t)1 << POOL_MIN_EXP;
+    }
+    // Class c > 0 lives in octave e and is the k-th quarter step above 2^e
+    int e = POOL_MIN_EXP + (c - 1) / POOL_STEPS;
+    size_t k = (size_t)((c - 1) % POOL_STEPS + 1);
+    return ((size_t)1 << e) + k * ((size_t)1 << (e - 2));
+}
+
+// Smallest class whose size is >= n, or -1 if n is too large to pool.
+static int pool_class_of(size_t n) {
+    if (n <= ((size_t)1 << POOL_MIN_EXP)) {
+        return 0;
+    }
+    if (n > ((size_t)1 << POOL_MAX_EXP)) {
+        return -1;
+    }
+    // e = floor(log2(n - 1)), so n - 1 lies in [2^e, 2^(e+1))
+    size_t m = n - 1;
+    int e = 0;
+    while ((m >> e) > 1) {
+        e++;
+    }
+    // Quarter step within the octave that covers n (1..POOL_STEPS)
+    size_t step = (size_t)1 << (e - 2);
+    int k = (int)((m - ((size_t)1 << e)) / step) + 1;
+    return (e - POOL_MIN_EXP) * POOL_STEPS + k;
+}
+
+// Class index whose size is exactly cap, or -1 if cap is not a class size.
+static int pool_class_exact(size_t cap) {
+    int c = pool_class_of(cap);
+    if (c < 0 || pool_class_size(c) != cap) {
+        return -1;
+    }
+    return c;
+}
+
+// Pop and free cached buffers, largest classes first, until at most
+// keep_bytes remain cached.  Returns the number of bytes released.  The
+// caller holds g_pool.lock.
+static size_t pool_release_until(size_t keep_bytes) {
+    size_t released = 0;
+    for (int c = POOL_NUM_CLASSES - 1; c >= 0 && g_pool.cached_bytes > keep_bytes; c--) {
+        size_t sz = pool_class_size(c);
+        while (g_pool.lists[c] && g_pool.cached_bytes > keep_bytes) {
+            pool_block_t *b = g_pool.lists[c];
+            g_pool.lists[c] = b->next;
+            g_pool.counts[c]--;
+            g_pool.cached_bytes -= sz;
+            g_pool.cached_buffers--;
+            released += sz;
+            free(b);
+        }
+    }
+    return released;
+}
+
+// ============================================================================
+// Operations (Internal)
+// ============================================================================
+
+// Round a capacity up to its size class while the pool is enabled, so the
+// buffer can be recycled when freed.  Returns n unchanged otherwise.
+size_t buf_class_size(size_t n) {
+    pthread_mutex_lock(&g_pool.lock);
+    bool enabled = g_pool.enabled;
+    pthread_mutex_unlock(&g_pool.lock);
+    int c = enabled ? pool_class_of(n) : -1;
+    return c < 0 ? n : pool_class_size(c);
+}
+
+// Allocate at least n bytes, preferring a cached buffer of the matching class.
+uint8_t *buf_alloc(size_t n, size_t *cap) {
+    pthread_mutex_lock(&g_pool.lock);
+    int c = g_pool.enabled ? pool_class_of(n) : -1;
+    if (c >= 0) {
+        size_t sz = pool_class_size(c);
+        pool_block_t *b = g_pool.lists[c];
+        if (b) {
+            // Reuse a parked buffer of the same class
+            g_pool.lists[c] = b->next;
+            g_pool.counts[c]--;
+            g_pool.cached_bytes -= sz;
+            g_pool.cached_buffers--;
+            g_pool.hits++;
+        } else {
+            g_pool.misses++;
+        }
+        pthread_mutex_unlock(&g_pool.lock);
+        // Allocate the full class size so the buffer can be recycled later
+        uint8_t *p = b ? (uint8_t *)b : malloc(sz);
+        *cap = p ? sz : 0;
+        return p;
+    }
+    pthread_mutex_unlock(&g_pool.lock);
+    // malloc(0) may return NULL legitimately; request one byte instead
+    uint8_t *p = malloc(n ? n : 1);
+    *cap = p ? n : 0;
+    return p;
+}
+
+// Return a buffer to its class free list, or free() it if it cannot be pooled.
+void buf_release(uint8_t *data, size_t cap) {
+    if (!data) {
+        return;
+    }
+    pthread_mutex_lock(&g_pool.lock);
+    int c = g_pool.enabled ? pool_class_exact(cap) : -1;
+    if (c >= 0 && g_pool.cached_bytes + cap <= g_pool.max_cached) {
+        pool_block_t *b = (pool_block_t *)(void *)data;
+        b->next = g_pool.lists[c];
+        g_pool.lists[c] = b;
+        g_pool.counts[c]++;
+        g_pool.cached_bytes += cap;
+        g_pool.cached_buffers++;
+        pthread_mutex_unlock(&g_pool.lock);
+        return;
+    }
+    pthread_mutex_unlock(&g_pool.lock);
+    free(data);
+}
+
+// ============================================================================
+// Operations (Public API)
+// ============================================================================
+
+// Turn on buffer recycling, caching at most max_cached bytes of freed buffers.
+void peel_pool_enable(size_t max_cached) {
+    pthread_mutex_lock(&g_pool.lock);
+    g_pool.enabled = true;
+    g_pool.max_cached = max_cached;
+    // Shrinking the limit on an already-enabled pool drops the excess now
+    pool_release_until(max_cached);
+    pthread_mutex_unlock(&g_pool.lock);
+}
+
+// Turn off buffer recycling and release every cached buffer.
+void peel_pool_disable(void) {
+    pthread_mutex_lock(&g_pool.lock);
+    pool_release_until(0);
+    g_pool.enabled = false;
+    pthread_mutex_unlock(&g_pool.lock);
+}
+
+// Release cached buffers until at most keep_bytes remain cached.
+size_t peel_pool_trim(size_t keep_bytes) {
+    pthread_mutex_lock(&g_pool.lock);
+    size_t released = pool_release_until(keep_bytes);
+    pthread_mutex_unlock(&g_pool.lock);
+    return released;
+}
+
+// Snapshot the pool counters.
+void peel_pool_stats(peel_pool_stats_t *out) {
+    if (!out) {
+        return;
+    }
+    pthread_mutex_lock(&g_pool.lock);
+    out->cached_bytes = g_pool.cached_bytes;
+    out->cached_buffers = g_pool.cached_buffers;
+    out->hits = g_pool.hits;
+    out->misses = g_pool.misses;
+    pthread_mutex_unlock(&g_pool.lock);
+}
@@ -2,10 +2,20 @@
 // Copyright (c) pappadf
 
 // util.c
-// Shared utility implementations: CRC routines and growable output buffers.
+// Shared utility implementations: CRC routines, growable output buffers,
+// hashing, timing, mapped files, and the file list builder.
+
+#define _POSIX_C_SOURCE 200809L
 
 #include "internal.h"
 
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
 // ============================================================================
 // Constants and Macros
 // ============================================================================
@@ -85,6 +95,8 @@ static void grow_ensure(grow_buf_t *g, size_t extra, decode_ctx_t *ctx) {
     if (new_cap < needed) {
         new_cap = needed;
     }
+    // Land on a pool size class so the finished buffer stays recyclable
+    new_cap = buf_class_size(new_cap);
     uint8_t *new_data = realloc(g->data, new_cap);
     if (!new_data) {
         decode_abort(ctx, "out of memory (grow_buf realloc to %zu bytes)", new_cap);
@@ -98,12 +110,11 @@ void grow_init(grow_buf_t *g, size_t initial_cap, decode_ctx_t *ctx) {
     if (initial_cap == 0) {
         initial_cap = GROW_DEFAULT_CAP;
     }
-    g->data = malloc(initial_cap);
+    g->data = buf_alloc(initial_cap, &g->cap);
     if (!g->data) {
         decode_abort(ctx, "out of memory (grow_buf init %zu bytes)", initial_cap);
     }
     g->len = 0;
-    g->cap = initial_cap;
 }
 
 // Append n bytes from src to the growable buffer.
@@ -124,11 +135,14 @@ void grow_push(grow_buf_t *g, uint8_t byte, decode_ctx_t *ctx) {
 
 // Hand ownership of the buffer data to an owned peel_buf_t, then zero g.
 peel_buf_t grow_finish(grow_buf_t *g) {
-    // Shrink to exact size to avoid wasting memory
-    if (g->len < g->cap && g->len > 0) {
-        uint8_t *shrunk = realloc(g->data, g->len);
+    // Shrink to exact size (or the pool class of that size) to avoid
+    // wasting memory
+    size_t target = buf_class_size(g->len);
+    if (target < g->cap && g->len > 0) {
+        uint8_t *shrunk = realloc(g->data, target);
         if (shrunk) {
             g->data = shrunk;
+            g->cap = target;
         }
         // If realloc fails, keep the oversized buffer — still valid
     }
@@ -136,6 +150,7 @@ peel_buf_t grow_finish(grow_buf_t *g) {
         .data = g->data,
         .size = g->len,
         .owned = true,
+        .cap = g->cap,
     };
     // Zero the grow_buf so it cannot be reused
     memset(g, 0, sizeof(*g));
@@ -144,6 +159,306 @@ peel_buf_t grow_finish(grow_buf_t *g) {
 
 // Release a growable buffer without producing a result (error cleanup).
 void grow_free(grow_buf_t *g) {
-    free(g->data);
+    buf_release(g->data, g->cap);
     memset(g, 0, sizeof(*g));
 }
+
+// ============================================================================
+// Shared Buffers
+// ============================================================================
+
+// Destroy callback for heap-backed shared buffers.
+static void heap_ref_destroy(peel_ref_t *r) {
+    buf_release(r->base, r->len);
+}
+
+// Create a reference with count 1.
+peel_ref_t *ref_new(void (*destroy)(peel_ref_t *r), void *base, size_t len) {
+    peel_ref_t *r = malloc(sizeof(*r));
+    if (!r) {
+        return NULL;
+    }
+    r->refs = 1;
+    r->destroy = destroy;
+    r->base = base;
+    r->len = len;
+    return r;
+}
+
+// Guards every reference count: a fork shared by the dedupe cache may be
+// retained and dropped on several threads at once.
+static pthread_mutex_t g_ref_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Add a reference.
+void ref_retain(peel_ref_t *r) {
+    pthread_mutex_lock(&g_ref_lock);
+    r->refs++;
+    pthread_mutex_unlock(&g_ref_lock);
+}
+
+// Drop a reference; the last one releases the backing store.
+void ref_drop(peel_ref_t *r) {
+    pthread_mutex_lock(&g_ref_lock);
+    size_t left = --r->refs;
+    pthread_mutex_unlock(&g_ref_lock);
+    if (left == 0) {
+        r->destroy(r);
+        free(r);
+    }
+}
+
+// Wrap an owned heap buffer in a reference so it can be handed out many times.
+bool buf_make_shared(peel_buf_t *buf) {
+    if (buf->ref) {
+        return true;
+    }
+    peel_ref_t *r = ref_new(heap_ref_destroy, buf->data, buf->cap ? buf->cap : buf->size);
+    if (!r) {
+        return false;
+    }
+    buf->ref = r;
+    buf->owned = true;
+    return true;
+}
+
+// Return another handle to the same shared bytes.
+peel_buf_t buf_share(const peel_buf_t *buf) {
+    ref_retain(buf->ref);
+    return *buf;
+}
+
+// ============================================================================
+// Mapped Files
+// ============================================================================
+
+// Destroy callback for mmap-backed shared buffers.
+static void map_ref_destroy(peel_ref_t *r) {
+    munmap(r->base, r->len);
+}
+
+// Map fd read-only; the mapping lives until the last reference is dropped.
+peel_buf_t buf_map_fd(int fd, peel_err_t **err) {
+    *err = NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        *err = make_err("cannot stat file descriptor %d", fd);
+        return (peel_buf_t){0};
+    }
+    if (st.st_size <= 0) {
+        return (peel_buf_t){0};
+    }
+    size_t len = (size_t)st.st_size;
+    void *base = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        *err = make_err("cannot map %zu bytes from file descriptor %d", len, fd);
+        return (peel_buf_t){0};
+    }
+    peel_ref_t *r = ref_new(map_ref_destroy, base, len);
+    if (!r) {
+        munmap(base, len);
+        *err = make_err("out of memory mapping file descriptor %d", fd);
+        return (peel_buf_t){0};
+    }
+    return (peel_buf_t){.data = base, .size = len, .ref = r};
+}
+
+// Read fd into a shared heap buffer with pread(), for files another process
+// may still truncate or rewrite: a copy cannot fault the way a mapping can.
+peel_buf_t buf_read_fd(int fd, peel_err_t **err) {
+    *err = NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        *err = make_err("cannot stat file descriptor %d", fd);
+        return (peel_buf_t){0};
+    }
+    if (st.st_size <= 0) {
+        return (peel_buf_t){0};
+    }
+    size_t len = (size_t)st.st_size, cap;
+    uint8_t *data = buf_alloc(len, &cap);
+    if (!data) {
+        *err = make_err("out of memory reading %zu bytes from file descriptor %d", len, fd);
+        return (peel_buf_t){0};
+    }
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = pread(fd, data + got, len - got, (off_t)got);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        got += (size_t)n;
+    }
+    peel_buf_t buf = {.data = data, .size = len, .owned = true, .cap = cap};
+    if (got < len) {
+        *err = make_err("short read from file descriptor %d: expected %zu bytes, got %zu", fd,
+                        len, got);
+    } else if (!buf_make_shared(&buf)) {
+        *err = make_err("out of memory reading file descriptor %d", fd);
+    }
+    if (*err) {
+        buf_release(data, cap);
+        return (peel_buf_t){0};
+    }
+    return buf;
+}
+
+// ============================================================================
+// Hashing
+// ============================================================================
+
+// 64-bit FNV-1a over len bytes, continuing from seed.
+uint64_t fnv1a64(uint64_t seed, const void *data, size_t len) {
+    const uint8_t *p = data;
+    uint64_t h = seed;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// SHA-256 round constants (FIPS 180-4 § 4.2.2).
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4,
+    0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe,
+    0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f,
+    0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+    0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116,
+    0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7,
+    0xc67178f2,
+};
+
+static inline uint32_t rotr32(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+// Run the SHA-256 compression function over one 64-byte block.
+static void sha256_block(uint32_t st[8], const uint8_t *blk) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = rd32be(blk + 4 * i);
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = st[0], b = st[1], c = st[2], d = st[3];
+    uint32_t e = st[4], f = st[5], g = st[6], h = st[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) +
+                      sha256_k[i] + w[i];
+        uint32_t t2 =
+            (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    st[0] += a;
+    st[1] += b;
+    st[2] += c;
+    st[3] += d;
+    st[4] += e;
+    st[5] += f;
+    st[6] += g;
+    st[7] += h;
+}
+
+// SHA-256 of len bytes into out.
+void sha256(const void *data, size_t len, uint8_t out[SHA256_LEN]) {
+    uint32_t st[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                      0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    const uint8_t *p = data;
+    size_t left = len;
+    for (; left >= 64; p += 64, left -= 64) {
+        sha256_block(st, p);
+    }
+
+    // Pad the tail: 0x80, zeros, then the bit length in the last 8 bytes
+    uint8_t tail[128] = {0};
+    if (left) {
+        memcpy(tail, p, left);
+    }
+    tail[left] = 0x80;
+    size_t tail_len = left < 56 ? 64 : 128;
+    wr64be(tail + tail_len - 8, (uint64_t)len * 8);
+    sha256_block(st, tail);
+    if (tail_len == 128) {
+        sha256_block(st, tail + 64);
+    }
+    for (int i = 0; i < 8; i++) {
+        wr32be(out + 4 * i, st[i]);
+    }
+}
+
+// ============================================================================
+// Timing
+// ============================================================================
+
+// Monotonic clock in nanoseconds.
+uint64_t clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// ============================================================================
+// File List Builder
+// ============================================================================
+
+// Initialise an empty builder.
+void file_list_builder_init(file_list_builder_t *b) {
+    memset(b, 0, sizeof(*b));
+}
+
+// Append a file, doubling the backing array as needed.
+bool file_list_push(file_list_builder_t *b, peel_file_t *f) {
+    if (b->list.count == b->cap) {
+        size_t new_cap = b->cap ? b->cap * 2 : 16;
+        peel_file_t *tmp = realloc(b->list.files, new_cap * sizeof(peel_file_t));
+        if (!tmp) {
+            b->err = make_err("out of memory growing file list (%zu files)", new_cap);
+            peel_free(&f->data_fork);
+            peel_free(&f->resource_fork);
+            return false;
+        }
+        b->list.files = tmp;
+        b->cap = new_cap;
+    }
+    b->list.files[b->list.count++] = *f;
+    memset(f, 0, sizeof(*f));
+    return true;
+}
+
+// peel_each_fn that pushes each file onto the builder in ctx.
+bool file_list_collect(peel_file_t *file, void *ctx) {
+    return file_list_push(ctx, file);
+}
+
+// Hand back the collected list, or discard it if anything failed.
+peel_file_list_t file_list_builder_finish(file_list_builder_t *b, peel_err_t **err) {
+    if (!*err && b->err) {
+        *err = b->err;
+        b->err = NULL;
+    }
+    peel_err_free(b->err);
+    if (*err) {
+        peel_file_list_free(&b->list);
+        memset(b, 0, sizeof(*b));
+        return (peel_file_list_t){0};
+    }
+    peel_file_list_t result = b->list;
+    memset(b, 0, sizeof(*b));
+    return result;
+}
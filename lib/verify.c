@@ -0,0 +1,182 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) pappadf
+
+// verify.c
+// Integrity checking without extraction.
+//
+// peel_verify() follows the layers peel() would, but hands each archive
+// member to its format's verify_entry hook instead of decoding it into
+// memory.  The hooks run the same decoders through a VERIFY_CHUNK-sized
+// buffer and feed the output straight into the stored checksum, so memory
+// stays flat no matter how large the forks are.  Wrapper layers in front of
+// an archive are decoded whole, because archive catalogs need random access;
+// a wrapper that ends the chain is checked by its verify hook instead.
+
+#include "internal.h"
+
+// ============================================================================
+// Constants and Macros
+// ============================================================================
+
+// Maximum wrapper layers followed, matching peel()'s limit.
+#define VERIFY_MAX_DEPTH 32
+
+// Bytes of a wrapper payload decoded to decide whether another format
+// follows (the window peel_probe_chain() scans).
+#define VERIFY_SNIFF (64 * 1024)
+
+// ============================================================================
+// Type Definitions (Private)
+// ============================================================================
+
+// Scan callback state: the report being filled and the archive it checks.
+typedef struct {
+    peel_verify_report_t *report;
+    const peel_format_t *fmt;
+    const uint8_t *src;
+    size_t len;
+    size_t cap; // Allocated slots in report->entries
+    bool oom;
+} verify_scan_t;
+
+// ============================================================================
+// Static Helpers
+// ============================================================================
+
+// Append a blank entry to the report.  Returns NULL when out of memory.
+static peel_verify_entry_t *add_entry(peel_verify_report_t *r, size_t *cap) {
+    if (r->count == *cap) {
+        size_t n = *cap ? *cap * 2 : 16;
+        peel_verify_entry_t *tmp = realloc(r->entries, n * sizeof(*tmp));
+        if (!tmp) {
+            return NULL;
+        }
+        r->entries = tmp;
+        *cap = n;
+    }
+    peel_verify_entry_t *e = &r->entries[r->count++];
+    memset(e, 0, sizeof(*e));
+    return e;
+}
+
+// Record a status, and the error behind it, in an entry.
+static void set_status(peel_verify_report_t *r, peel_verify_entry_t *e,
+                       peel_verify_status_t status, peel_err_t *err) {
+    e->status = status;
+    if (status == PEEL_VERIFY_FAILED) {
+        snprintf(e->message, sizeof(e->message), "%s", err ? peel_err_msg(err) : "failed");
+        r->failed++;
+    }
+    peel_err_free(err);
+}
+
+// Check one scanned member.
+static bool verify_member(const entry_ref_t *ent, void *ctx) {
+    verify_scan_t *s = ctx;
+    peel_verify_entry_t *e = add_entry(s->report, &s->cap);
+    if (!e) {
+        s->oom = true;
+        return false;
+    }
+    e->meta = ent->meta;
+    peel_err_t *err = NULL;
+    peel_verify_status_t status = s->fmt->verify_entry(s->src, s->len, ent, &err);
+    set_status(s->report, e, status, err);
+    return true;
+}
+
+// True if the wrapper's payload begins with another recognised format, so
+// it has to be decoded whole rather than just checked.
+static bool payload_continues(const peel_format_t *fmt, const uint8_t *src, size_t len) {
+    const uint8_t *payload = NULL;
+    uint64_t full_len = 0;
+    if (fmt->probe(src, len, &payload, NULL, 0, &full_len) == (size_t)-1) {
+        return true; // Let peel_wrapper() report the damage
+    }
+    size_t want = full_len < VERIFY_SNIFF ? (size_t)full_len : VERIFY_SNIFF;
+    uint8_t *scratch = malloc(want ? want : 1);
+    if (!scratch) {
+        return true;
+    }
+    size_t n = fmt->probe(src, len, &payload, scratch, want, &full_len);
+    bool more = n == (size_t)-1 || detect_format(payload, n < want ? n : want) != NULL;
+    free(scratch);
+    return more;
+}
+
+// ============================================================================
+// Operations (Public API)
+// ============================================================================
+
+// Decode and check every member of src without keeping any output.
+bool peel_verify(const uint8_t *src, size_t len, peel_verify_report_t *out, peel_err_t **err) {
+    *err = NULL;
+    memset(out, 0, sizeof(*out));
+
+    // `owned` holds the most recent decoded wrapper payload
+    peel_buf_t owned = {0};
+    const uint8_t *cur = src;
+    size_t cur_len = len;
+
+    for (int depth = 0; depth < VERIFY_MAX_DEPTH; depth++) {
+        const peel_format_t *fmt = detect_format(cur, cur_len);
+        if (!fmt) {
+            if (depth == 0) {
+                // Nothing to check at all; do not report an empty success
+                *err = make_err("not an archive");
+                return false;
+            }
+            break; // Plain data: nothing stores a checksum for it
+        }
+
+        if (fmt->kind == PEEL_FMT_ARCHIVE) {
+            verify_scan_t s = {.report = out, .fmt = fmt, .src = cur, .len = cur_len};
+            fmt->scan(cur, cur_len, verify_member, &s, err);
+            peel_free(&owned);
+            if (!*err && s.oom) {
+                *err = make_err("out of memory verifying archive");
+            }
+            if (*err) {
+                peel_verify_free(out);
+                return false;
+            }
+            return true;
+        }
+
+        // A wrapper that ends the chain is checked in place
+        if (!payload_continues(fmt, cur, cur_len)) {
+            size_t cap = 0;
+            peel_verify_entry_t *e = add_entry(out, &cap);
+            if (!e) {
+                peel_free(&owned);
+                *err = make_err("out of memory verifying %s", fmt->name);
+                return false;
+            }
+            peel_err_t *verr = NULL;
+            peel_verify_status_t status = fmt->verify(cur, cur_len, &e->meta, &verr);
+            set_status(out, e, status, verr);
+            break;
+        }
+
+        peel_buf_t decoded = fmt->peel_wrapper(cur, cur_len, err);
+        peel_free(&owned);
+        if (*err) {
+            return false;
+        }
+        owned = decoded;
+        cur = owned.data;
+        cur_len = owned.size;
+    }
+
+    peel_free(&owned);
+    return true;
+}
+
+// Free the entries of a report and zero it.
+void peel_verify_free(peel_verify_report_t *report) {
+    if (!report) {
+        return;
+    }
+    free(report->entries);
+    memset(report, 0, sizeof(*report));
+}
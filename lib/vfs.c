@@ -0,0 +1,595 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) pappadf
+
+// vfs.c
+// Lazy, filesystem-style view of an archive: stat, readdir, open and pread.
+//
+// peel_vfs_open() strips wrapper layers (BinHex, MacBinary) eagerly, then
+// only scans the archive directory.  Forks are decoded the first time they
+// are read and kept in a byte-bounded LRU cache shared by every layer of
+// the VFS.  A member whose data fork is itself a recognized format can be
+// entered like a directory ("outer.sit/inner.sit.hqx/file"); its layer is
+// opened on first access.
+
+#include "internal.h"
+
+// ============================================================================
+// Constants and Macros
+// ============================================================================
+
+// Maximum wrapper layers stripped per VFS layer, and maximum nesting of
+// archive-in-archive layers along one path.
+#define VFS_MAX_DEPTH 32
+
+// Name of the single entry exposed when a layer holds unrecognized data.
+#define VFS_PLAIN_NAME "data"
+
+// Initial slot count of a layer's path index (power of two).
+#define VFS_INDEX_INIT 64
+
+// Longest path within one layer (matches peel_file_meta_t.name).
+#define VFS_PATH_MAX 256
+
+// ============================================================================
+// Type Definitions (Private)
+// ============================================================================
+
+struct vfs_layer;
+
+// One decoded fork in the cache.
+typedef struct vfs_slot {
+    peel_buf_t buf; // Decoded fork contents
+    bool resident; // buf holds the decoded fork and the slot is on the LRU list
+    int pins; // Open files and nested layers currently using buf
+    struct vfs_slot *prev; // LRU neighbour towards most recently used
+    struct vfs_slot *next; // LRU neighbour towards least recently used
+} vfs_slot_t;
+
+// A file or directory in one layer's tree.
+typedef struct vfs_node {
+    char *path; // Path within the layer ("" for the root)
+    const char *name; // Last component (points into path)
+    bool is_dir;
+    size_t entry; // Index into layer->entries (files only)
+    struct vfs_node **children; // Directory contents, in archive order
+    size_t n_children;
+    size_t children_cap;
+    struct vfs_layer *nested; // Inner layer opened from this file's data fork
+    bool probed; // True once the data fork has been checked for a format
+} vfs_node_t;
+
+// One archive (or plain blob) in the VFS, with its member tree.
+typedef struct vfs_layer {
+    peel_buf_t blob; // Unwrapped bytes the entries point into
+    vfs_slot_t *pin; // Parent-layer fork pinned to keep blob alive
+    const peel_format_t *fmt; // Archive handler, or NULL for plain data
+    entry_ref_t *entries; // Members reported by fmt->scan
+    size_t n_entries;
+    size_t entries_cap;
+    vfs_slot_t *slots; // Two per entry: data fork, then resource fork
+    vfs_node_t *root;
+    vfs_node_t **index; // Open-addressed path → node map
+    size_t index_cap;
+    size_t index_count;
+    bool oom; // An allocation failed while collecting entries
+} vfs_layer_t;
+
+// A VFS handle.
+struct peel_vfs {
+    vfs_layer_t *top;
+    size_t cache_limit; // Upper bound on resident decoded bytes
+    size_t cache_bytes; // Decoded bytes currently resident
+    vfs_slot_t *lru_head; // Most recently used resident slot
+    vfs_slot_t *lru_tail; // Least recently used resident slot
+};
+
+// An open fork.
+struct peel_vfs_file {
+    peel_vfs_t *vfs;
+    vfs_slot_t *slot; // Pinned cache slot (NULL for plain layers)
+    const uint8_t *data;
+    size_t size;
+};
+
+// ============================================================================
+// Static Helpers — LRU Cache
+// ============================================================================
+
+// Unlink a resident slot from the LRU list.
+static void lru_unlink(peel_vfs_t *vfs, vfs_slot_t *s) {
+    if (s->prev) s->prev->next = s->next;
+    else vfs->lru_head = s->next;
+    if (s->next) s->next->prev = s->prev;
+    else vfs->lru_tail = s->prev;
+    s->prev = s->next = NULL;
+}
+
+// Insert a resident slot at the most-recently-used end.
+static void lru_push_front(peel_vfs_t *vfs, vfs_slot_t *s) {
+    s->prev = NULL;
+    s->next = vfs->lru_head;
+    if (vfs->lru_head) vfs->lru_head->prev = s;
+    vfs->lru_head = s;
+    if (!vfs->lru_tail) vfs->lru_tail = s;
+}
+
+// Drop a resident slot's buffer and account for it.
+static void slot_evict(peel_vfs_t *vfs, vfs_slot_t *s) {
+    lru_unlink(vfs, s);
+    vfs->cache_bytes -= s->buf.size;
+    peel_free(&s->buf);
+    s->resident = false;
+}
+
+// Evict unpinned slots, least recently used first, until the cache fits.
+static void cache_shrink(peel_vfs_t *vfs) {
+    vfs_slot_t *s = vfs->lru_tail;
+    while (s && vfs->cache_bytes > vfs->cache_limit) {
+        vfs_slot_t *prev = s->prev;
+        if (s->pins == 0) slot_evict(vfs, s);
+        s = prev;
+    }
+}
+
+// Make a fork resident (decoding on a miss), mark it most recently used,
+// and pin it.  The caller must unpin with slot_unpin().
+static vfs_slot_t *slot_acquire(peel_vfs_t *vfs, vfs_layer_t *layer, size_t entry,
+                                peel_fork_t fork, peel_err_t **err) {
+    vfs_slot_t *s = &layer->slots[entry * 2 + (fork == PEEL_FORK_RESOURCE)];
+    if (s->resident) {
+        lru_unlink(vfs, s);
+    } else {
+        const entry_ref_t *ent = &layer->entries[entry];
+        const fork_ref_t *ref = fork == PEEL_FORK_RESOURCE ? &ent->rsrc_fork : &ent->data_fork;
+        if (ref->raw_len > 0) {
+            s->buf = layer->fmt->decode_fork(layer->blob.data, layer->blob.size, ref, err);
+            if (*err) return NULL;
+        }
+        s->resident = true;
+        vfs->cache_bytes += s->buf.size;
+    }
+    lru_push_front(vfs, s);
+    s->pins++;
+    cache_shrink(vfs);
+    return s;
+}
+
+// Release a pin taken by slot_acquire().
+static void slot_unpin(peel_vfs_t *vfs, vfs_slot_t *s) {
+    s->pins--;
+    cache_shrink(vfs);
+}
+
+// ============================================================================
+// Static Helpers — Layer Tree
+// ============================================================================
+
+// Slot for path in the index (existing node or the empty slot to fill).
+static size_t index_slot(vfs_node_t **index, size_t cap, const char *path) {
+    size_t i = (size_t)fnv1a64(FNV1A64_INIT, path, strlen(path)) & (cap - 1);
+    while (index[i] && strcmp(index[i]->path, path) != 0) i = (i + 1) & (cap - 1);
+    return i;
+}
+
+// Look up a node by its path within the layer.
+static vfs_node_t *layer_find(const vfs_layer_t *layer, const char *path) {
+    if (!layer->index_cap) return NULL;
+    return layer->index[index_slot(layer->index, layer->index_cap, path)];
+}
+
+// Add a node to the path index, doubling it at 3/4 load.
+static bool index_add(vfs_layer_t *layer, vfs_node_t *node) {
+    if ((layer->index_count + 1) * 4 > layer->index_cap * 3) {
+        size_t cap = layer->index_cap ? layer->index_cap * 2 : VFS_INDEX_INIT;
+        vfs_node_t **index = calloc(cap, sizeof(*index));
+        if (!index) return false;
+        for (size_t i = 0; i < layer->index_cap; i++) {
+            vfs_node_t *n = layer->index[i];
+            if (n) index[index_slot(index, cap, n->path)] = n;
+        }
+        free(layer->index);
+        layer->index = index;
+        layer->index_cap = cap;
+    }
+    size_t i = index_slot(layer->index, layer->index_cap, node->path);
+    if (!layer->index[i]) {
+        // Keep the first node for a duplicated path so lookups are stable
+        layer->index[i] = node;
+        layer->index_count++;
+    }
+    return true;
+}
+
+// Free a node subtree.  Nested layers must already be closed.
+static void node_free(vfs_node_t *n) {
+    if (!n) return;
+    for (size_t i = 0; i < n->n_children; i++) node_free(n->children[i]);
+    free(n->children);
+    free(n->path);
+    free(n);
+}
+
+// Allocate a node for path (copied) and append it to parent's children.
+static vfs_node_t *node_new(vfs_layer_t *layer, vfs_node_t *parent, const char *path,
+                            size_t path_len, bool is_dir) {
+    vfs_node_t *n = calloc(1, sizeof(*n));
+    if (!n) return NULL;
+    n->path = malloc(path_len + 1);
+    if (!n->path) {
+        free(n);
+        return NULL;
+    }
+    memcpy(n->path, path, path_len);
+    n->path[path_len] = '\0';
+    const char *slash = strrchr(n->path, '/');
+    n->name = slash ? slash + 1 : n->path;
+    n->is_dir = is_dir;
+
+    if (parent) {
+        if (parent->n_children == parent->children_cap) {
+            size_t cap = parent->children_cap ? parent->children_cap * 2 : 8;
+            vfs_node_t **tmp = realloc(parent->children, cap * sizeof(*tmp));
+            if (!tmp) {
+                free(n->path);
+                free(n);
+                return NULL;
+            }
+            parent->children = tmp;
+            parent->children_cap = cap;
+        }
+        parent->children[parent->n_children++] = n;
+    }
+    if (!index_add(layer, n)) {
+        // A child stays reachable through parent->children and is freed
+        // with the tree; a parentless root must be freed here
+        if (!parent) node_free(n);
+        return NULL;
+    }
+    return n;
+}
+
+// Insert a file node for entry `idx`, creating intermediate directories.
+static bool layer_add_file(vfs_layer_t *layer, size_t idx) {
+    const char *path = layer->entries[idx].meta.name;
+    vfs_node_t *dir = layer->root;
+
+    // Create (or find) a directory node for every prefix ending at '/'
+    for (const char *p = strchr(path, '/'); p; p = strchr(p + 1, '/')) {
+        size_t plen = (size_t)(p - path);
+        char prefix[VFS_PATH_MAX];
+        memcpy(prefix, path, plen);
+        prefix[plen] = '\0';
+        vfs_node_t *d = layer_find(layer, prefix);
+        if (!d || !d->is_dir) {
+            d = node_new(layer, dir, prefix, plen, true);
+            if (!d) return false;
+        }
+        dir = d;
+    }
+
+    vfs_node_t *f = node_new(layer, dir, path, strlen(path), false);
+    if (!f) return false;
+    f->entry = idx;
+    return true;
+}
+
+// entry_scan_fn that appends a scanned member to the layer's entry array.
+static bool collect_entry(const entry_ref_t *ent, void *ctx) {
+    vfs_layer_t *layer = ctx;
+    if (layer->n_entries == layer->entries_cap) {
+        size_t cap = layer->entries_cap ? layer->entries_cap * 2 : 16;
+        entry_ref_t *tmp = realloc(layer->entries, cap * sizeof(*tmp));
+        if (!tmp) {
+            layer->oom = true;
+            return false;
+        }
+        layer->entries = tmp;
+        layer->entries_cap = cap;
+    }
+    layer->entries[layer->n_entries++] = *ent;
+    return true;
+}
+
+// Close a layer, its nested layers, and its cached forks.
+static void layer_free(peel_vfs_t *vfs, vfs_layer_t *layer) {
+    if (!layer) return;
+    // Nested layers pin our slots, so close them first
+    for (size_t i = 0; i < layer->index_cap; i++) {
+        vfs_node_t *n = layer->index[i];
+        if (n && n->nested) layer_free(vfs, n->nested);
+    }
+    for (size_t i = 0; i < layer->n_entries * 2 && layer->slots; i++) {
+        vfs_slot_t *s = &layer->slots[i];
+        if (s->resident) slot_evict(vfs, s);
+    }
+    node_free(layer->root);
+    free(layer->index);
+    free(layer->slots);
+    free(layer->entries);
+    peel_free(&layer->blob);
+    if (layer->pin) slot_unpin(vfs, layer->pin);
+    free(layer);
+}
+
+// Open a layer over *blob (ownership transferred, even on failure).
+// Wrappers are stripped eagerly; the final archive is only scanned.  When
+// require_format is set, unrecognized data is an error rather than a
+// single-file layer.  pin, if non-NULL, is released when the layer closes.
+static vfs_layer_t *layer_open(peel_vfs_t *vfs, peel_buf_t *blob, vfs_slot_t *pin,
+                               bool require_format, peel_err_t **err) {
+    vfs_layer_t *layer = calloc(1, sizeof(*layer));
+    if (!layer) {
+        *err = make_err("out of memory opening VFS layer");
+        peel_free(blob);
+        if (pin) slot_unpin(vfs, pin);
+        return NULL;
+    }
+    layer->blob = *blob;
+    layer->pin = pin;
+    memset(blob, 0, sizeof(*blob));
+
+    // Strip wrapper layers until an archive or unknown data is found
+    const peel_format_t *fmt = NULL;
+    for (int depth = 0; depth < VFS_MAX_DEPTH; depth++) {
+        fmt = detect_format(layer->blob.data, layer->blob.size);
+        if (!fmt || fmt->kind != PEEL_FMT_WRAPPER) break;
+        require_format = false;
+        peel_buf_t decoded = fmt->peel_wrapper(layer->blob.data, layer->blob.size, err);
+        if (*err) {
+            layer_free(vfs, layer);
+            return NULL;
+        }
+        peel_free(&layer->blob);
+        layer->blob = decoded;
+        fmt = NULL;
+    }
+    if (!fmt && require_format) {
+        *err = make_err("not an archive");
+        layer_free(vfs, layer);
+        return NULL;
+    }
+
+    if (fmt && fmt->kind == PEEL_FMT_ARCHIVE) {
+        layer->fmt = fmt;
+        fmt->scan(layer->blob.data, layer->blob.size, collect_entry, layer, err);
+        if (!*err && layer->oom) *err = make_err("out of memory scanning archive");
+        if (*err) {
+            layer_free(vfs, layer);
+            return NULL;
+        }
+    } else {
+        // Plain data: expose the unwrapped bytes as a single file
+        entry_ref_t plain;
+        memset(&plain, 0, sizeof(plain));
+        strcpy(plain.meta.name, VFS_PLAIN_NAME);
+        plain.data_fork.raw_len = (uint32_t)layer->blob.size;
+        if (!collect_entry(&plain, layer)) {
+            *err = make_err("out of memory opening VFS layer");
+            layer_free(vfs, layer);
+            return NULL;
+        }
+    }
+
+    layer->slots = calloc(layer->n_entries * 2 + 1, sizeof(vfs_slot_t));
+    layer->root = node_new(layer, NULL, "", 0, true);
+    bool ok = layer->slots && layer->root;
+    for (size_t i = 0; ok && i < layer->n_entries; i++) ok = layer_add_file(layer, i);
+    if (!ok) {
+        *err = make_err("out of memory building VFS tree");
+        layer_free(vfs, layer);
+        return NULL;
+    }
+    return layer;
+}
+
+// Return the nested layer for a file node, opening it on first use.
+// Returns NULL with *err set if the file is not a recognized format.
+static vfs_layer_t *node_enter(peel_vfs_t *vfs, vfs_layer_t *layer, vfs_node_t *n,
+                               peel_err_t **err) {
+    if (n->nested) return n->nested;
+    if (n->probed || !layer->fmt) {
+        *err = make_err("'%s' is not a directory", n->path);
+        return NULL;
+    }
+    n->probed = true;
+
+    vfs_slot_t *s = slot_acquire(vfs, layer, n->entry, PEEL_FORK_DATA, err);
+    if (!s) return NULL;
+    if (!detect_format(s->buf.data, s->buf.size)) {
+        slot_unpin(vfs, s);
+        *err = make_err("'%s' is not a directory", n->path);
+        return NULL;
+    }
+    // The inner layer borrows the decoded fork and keeps it pinned
+    peel_buf_t inner = peel_buf_wrap(s->buf.data, s->buf.size);
+    peel_err_t *sub = NULL;
+    n->nested = layer_open(vfs, &inner, s, true, &sub);
+    if (sub) {
+        *err = make_err("'%s': %s", n->path, peel_err_msg(sub));
+        peel_err_free(sub);
+        return NULL;
+    }
+    return n->nested;
+}
+
+// Resolve a VFS path to a node, descending into nested layers as needed.
+static vfs_node_t *resolve(peel_vfs_t *vfs, const char *path, vfs_layer_t **layer_out,
+                           peel_err_t **err) {
+    vfs_layer_t *layer = vfs->top;
+    vfs_node_t *node = layer->root;
+    char rel[VFS_PATH_MAX] = "";
+    size_t rel_len = 0;
+    int depth = 0;
+
+    while (*path) {
+        // Next component
+        while (*path == '/') path++;
+        if (!*path) break;
+        const char *end = strchr(path, '/');
+        size_t clen = end ? (size_t)(end - path) : strlen(path);
+
+        // Crossing a file means entering its nested layer
+        if (!node->is_dir) {
+            if (++depth > VFS_MAX_DEPTH) {
+                *err = make_err("VFS: nesting too deep");
+                return NULL;
+            }
+            layer = node_enter(vfs, layer, node, err);
+            if (!layer) return NULL;
+            node = layer->root;
+            rel_len = 0;
+        }
+
+        size_t need = rel_len + (rel_len ? 1 : 0) + clen;
+        if (need >= sizeof(rel)) {
+            *err = make_err("VFS: path too long");
+            return NULL;
+        }
+        if (rel_len) rel[rel_len++] = '/';
+        memcpy(rel + rel_len, path, clen);
+        rel_len += clen;
+        rel[rel_len] = '\0';
+
+        node = layer_find(layer, rel);
+        if (!node) {
+            *err = make_err("VFS: no such file or directory: '%s'", rel);
+            return NULL;
+        }
+        path += clen;
+    }
+    *layer_out = layer;
+    return node;
+}
+
+// ============================================================================
+// Operations (Public API)
+// ============================================================================
+
+// Open a lazy VFS over an archive buffer (ownership transferred).
+peel_vfs_t *peel_vfs_open(peel_buf_t *archive, size_t cache_bytes, peel_err_t **err) {
+    *err = NULL;
+    peel_vfs_t *vfs = calloc(1, sizeof(*vfs));
+    if (!vfs) {
+        *err = make_err("out of memory opening VFS");
+        peel_free(archive);
+        return NULL;
+    }
+    vfs->cache_limit = cache_bytes;
+    vfs->top = layer_open(vfs, archive, NULL, false, err);
+    if (!vfs->top) {
+        free(vfs);
+        return NULL;
+    }
+    return vfs;
+}
+
+// Read the file at path and open a VFS over it.
+peel_vfs_t *peel_vfs_open_path(const char *path, size_t cache_bytes, peel_err_t **err) {
+    peel_buf_t buf = peel_read_file(path, err);
+    if (*err) return NULL;
+    return peel_vfs_open(&buf, cache_bytes, err);
+}
+
+// Close the VFS and release every cached fork.  Open files must be closed first.
+void peel_vfs_close(peel_vfs_t *vfs) {
+    if (!vfs) return;
+    layer_free(vfs, vfs->top);
+    free(vfs);
+}
+
+// Describe the file or directory at path.
+bool peel_vfs_stat(peel_vfs_t *vfs, const char *path, peel_vfs_stat_t *st, peel_err_t **err) {
+    *err = NULL;
+    vfs_layer_t *layer;
+    vfs_node_t *n = resolve(vfs, path, &layer, err);
+    if (!n) return false;
+
+    memset(st, 0, sizeof(*st));
+    st->is_dir = n->is_dir;
+    if (n->is_dir) {
+        strncpy(st->meta.name, n->name, sizeof(st->meta.name) - 1);
+        return true;
+    }
+    const entry_ref_t *ent = &layer->entries[n->entry];
+    st->meta = ent->meta;
+    memset(st->meta.name, 0, sizeof(st->meta.name));
+    strncpy(st->meta.name, n->name, sizeof(st->meta.name) - 1);
+    st->data_size = layer->fmt ? ent->data_fork.raw_len : layer->blob.size;
+    st->rsrc_size = ent->rsrc_fork.raw_len;
+    return true;
+}
+
+// Return the index-th entry of the directory at path.
+bool peel_vfs_readdir(peel_vfs_t *vfs, const char *path, size_t index,
+                      peel_vfs_dirent_t *out, peel_err_t **err) {
+    *err = NULL;
+    vfs_layer_t *layer;
+    vfs_node_t *n = resolve(vfs, path, &layer, err);
+    if (!n) return false;
+    if (!n->is_dir) {
+        // Listing a file lists the archive it contains
+        vfs_layer_t *inner = node_enter(vfs, layer, n, err);
+        if (!inner) return false;
+        n = inner->root;
+    }
+    if (index >= n->n_children) return false;
+
+    const vfs_node_t *c = n->children[index];
+    memset(out, 0, sizeof(*out));
+    strncpy(out->name, c->name, sizeof(out->name) - 1);
+    out->is_dir = c->is_dir;
+    return true;
+}
+
+// Open one fork of the file at path, decoding it if it is not cached.
+peel_vfs_file_t *peel_vfs_open_file(peel_vfs_t *vfs, const char *path, peel_fork_t fork,
+                                    peel_err_t **err) {
+    *err = NULL;
+    vfs_layer_t *layer;
+    vfs_node_t *n = resolve(vfs, path, &layer, err);
+    if (!n) return NULL;
+    if (n->is_dir) {
+        *err = make_err("VFS: '%s' is a directory", n->path);
+        return NULL;
+    }
+
+    peel_vfs_file_t *f = calloc(1, sizeof(*f));
+    if (!f) {
+        *err = make_err("out of memory opening VFS file");
+        return NULL;
+    }
+    f->vfs = vfs;
+    if (!layer->fmt) {
+        // Plain layer: the unwrapped blob is the data fork itself
+        if (fork == PEEL_FORK_DATA) {
+            f->data = layer->blob.data;
+            f->size = layer->blob.size;
+        }
+        return f;
+    }
+    f->slot = slot_acquire(vfs, layer, n->entry, fork, err);
+    if (!f->slot) {
+        free(f);
+        return NULL;
+    }
+    f->data = f->slot->buf.data;
+    f->size = f->slot->buf.size;
+    return f;
+}
+
+// Copy up to n bytes starting at offset.  Returns the number of bytes copied
+// (0 at or past end of fork).
+size_t peel_vfs_pread(peel_vfs_file_t *f, void *buf, size_t n, uint64_t offset) {
+    if (offset >= f->size) return 0;
+    size_t avail = f->size - (size_t)offset;
+    if (n > avail) n = avail;
+    memcpy(buf, f->data + offset, n);
+    return n;
+}
+
+// Close an open fork; its decoded bytes stay cached until evicted.
+void peel_vfs_close_file(peel_vfs_file_t *f) {
+    if (!f) return;
+    if (f->slot) slot_unpin(f->vfs, f->slot);
+    free(f);
+}
@@ -0,0 +1,600 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) pappadf
+
+// api_test.c
+// Library API checks for libpeeler (`make test`).
+//
+// run_tests.sh covers what the CLI writes.  The library's other entry
+// points and opt-in caches are checked here, each against plain peel() on
+// the same input: every check must yield the same files, in the same
+// order, with the same metadata and fork bytes, or state outright how it
+// differs.
+//
+// Usage: api_test <input>...
+//
+// Each input is checked in turn; a line is printed per check and the exit
+// status is 1 if any failed.
+
+#define _POSIX_C_SOURCE 200809L // mkdtemp, mkstemp
+
+#include "peeler.h"
+
+#include <dirent.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// ============================================================================
+// Constants
+// ============================================================================
+
+// Pool and cache limits: far more than any test input decodes to
+#define API_CACHE_BYTES (64u << 20)
+
+// Longest path checked in a VFS: that of peel_file_meta_t's name, which
+// holds peel()'s paths
+#define API_PATH_MAX 256
+
+// Prefix lengths peel_prefix() is checked with: nothing, a magic number's
+// worth, more than one decoder block, and everything
+static const size_t api_prefixes[] = {0, 16, 70000, SIZE_MAX};
+
+// Bytes read per peel_vfs_pread() call; small, so reads cross chunks
+#define API_READ_CHUNK 1000
+
+// ============================================================================
+// Type Definitions (Private)
+// ============================================================================
+
+// One input and what peel() made of it.
+typedef struct {
+    const char *path;
+    const uint8_t *src;
+    size_t len;
+    const peel_file_list_t *ref;
+} api_input_t;
+
+// Result cache backend holding one entry in memory.
+typedef struct {
+    char key[128];
+    peel_buf_t entry;
+} api_memory_cache_t;
+
+// A check: returns false and describes the first difference in why.
+typedef bool (*api_check_fn)(const api_input_t *in, char *why, size_t why_size);
+
+// ============================================================================
+// Static Helpers
+// ============================================================================
+
+// snprintf() into why and return false, for a failing check.
+static bool failed(char *why, size_t why_size, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(why, why_size, fmt, ap);
+    va_end(ap);
+    return false;
+}
+
+// True if fork got matches fork want.
+static bool same_fork(const peel_buf_t *got, const peel_buf_t *want) {
+    return got->size == want->size &&
+           (want->size == 0 || memcmp(got->data, want->data, want->size) == 0);
+}
+
+// True if metadata got matches want.
+static bool same_meta(const peel_file_meta_t *got, const peel_file_meta_t *want) {
+    return strcmp(got->name, want->name) == 0 && got->mac_type == want->mac_type &&
+           got->mac_creator == want->mac_creator && got->finder_flags == want->finder_flags;
+}
+
+// True if file got matches file want in metadata and both forks.
+static bool same_file(const peel_file_t *got, const peel_file_t *want) {
+    return same_meta(&got->meta, &want->meta) && same_fork(&got->data_fork, &want->data_fork) &&
+           same_fork(&got->resource_fork, &want->resource_fork);
+}
+
+// Compare list against what peel() returned.
+static bool same_list(const peel_file_list_t *list, const peel_file_list_t *ref, char *why,
+                      size_t why_size) {
+    if (list->count != ref->count) {
+        return failed(why, why_size, "%zu files, expected %zu", list->count, ref->count);
+    }
+    for (size_t i = 0; i < ref->count; i++) {
+        if (!same_file(&list->files[i], &ref->files[i])) {
+            return failed(why, why_size, "'%s' differs", ref->files[i].meta.name);
+        }
+    }
+    return true;
+}
+
+// Decode in and compare the result with peel()'s.
+static bool peel_again(const api_input_t *in, char *why, size_t why_size) {
+    peel_err_t *err = NULL;
+    peel_file_list_t list = peel(in->src, in->len, &err);
+    bool ok = err ? failed(why, why_size, "%s", peel_err_msg(err))
+                  : same_list(&list, in->ref, why, why_size);
+    peel_err_free(err);
+    peel_file_list_free(&list);
+    return ok;
+}
+
+// Create an empty scratch directory from template (ending in XXXXXX).
+// Returns false and describes why if it cannot be made.
+static bool scratch_dir(char *template, char *why, size_t why_size) {
+    if (!mkdtemp(template)) {
+        return failed(why, why_size, "cannot create '%s'", template);
+    }
+    return true;
+}
+
+// Remove a scratch directory and the files in it.
+static void scratch_remove(const char *dir) {
+    DIR *d = opendir(dir);
+    if (d) {
+        struct dirent *de;
+        while ((de = readdir(d)) != NULL) {
+            char path[API_PATH_MAX];
+            if (strcmp(de->d_name, ".") != 0 && strcmp(de->d_name, "..") != 0 &&
+                snprintf(path, sizeof(path), "%s/%s", dir, de->d_name) < (int)sizeof(path)) {
+                unlink(path);
+            }
+        }
+        closedir(d);
+    }
+    rmdir(dir);
+}
+
+// peel_cache_backend_t load() for api_memory_cache_t.
+static peel_buf_t memory_load(void *ctx, const char *key) {
+    api_memory_cache_t *mc = ctx;
+    peel_err_t *err = NULL;
+    if (strcmp(key, mc->key) != 0) {
+        return (peel_buf_t){0};
+    }
+    peel_buf_t buf = peel_buf_copy(mc->entry.data, mc->entry.size, &err);
+    peel_err_free(err);
+    return buf;
+}
+
+// peel_cache_backend_t store() for api_memory_cache_t.
+static void memory_store(void *ctx, const char *key, const uint8_t *data, size_t len) {
+    api_memory_cache_t *mc = ctx;
+    peel_err_t *err = NULL;
+    peel_free(&mc->entry);
+    snprintf(mc->key, sizeof(mc->key), "%s", key);
+    mc->entry = peel_buf_copy(data, len, &err);
+    peel_err_free(err);
+}
+
+// peel_path() twice with the result cache enabled: the first call decodes
+// and stores, the second is answered from the cache, and both match peel().
+static bool cached_twice(const api_input_t *in, char *why, size_t why_size) {
+    bool ok = true;
+    for (int pass = 0; ok && pass < 2; pass++) {
+        peel_err_t *err = NULL;
+        peel_file_list_t list = peel_path(in->path, &err);
+        ok = err ? failed(why, why_size, "%s", peel_err_msg(err))
+                 : same_list(&list, in->ref, why, why_size);
+        peel_err_free(err);
+        peel_file_list_free(&list);
+    }
+    peel_cache_stats_t st;
+    peel_cache_stats(&st);
+    peel_cache_disable();
+    if (ok && (st.misses != 1 || st.stores != 1 || st.hits != 1)) {
+        return failed(why, why_size, "%llu misses, %llu stores, %llu hits; expected one each",
+                      (unsigned long long)st.misses, (unsigned long long)st.stores,
+                      (unsigned long long)st.hits);
+    }
+    return ok;
+}
+
+// Unpack the packed result in fd, close fd, and compare the files with
+// peel()'s.  The views must outlive the descriptor.
+static bool unpacked(int fd, const api_input_t *in, char *why, size_t why_size) {
+    peel_err_t *err = NULL;
+    peel_file_list_t list = peel_unpack_view(fd, &err);
+    close(fd);
+    bool ok = err ? failed(why, why_size, "%s", peel_err_msg(err))
+                  : same_list(&list, in->ref, why, why_size);
+    peel_err_free(err);
+    peel_file_list_free(&list);
+    return ok;
+}
+
+// True if got is the first max bytes of want, marked partial if that is
+// not all of it.
+static bool same_prefix(const peel_buf_t *got, const peel_buf_t *want, size_t max) {
+    size_t size = want->size < max ? want->size : max;
+    return got->size == size && got->partial == (want->size > max) &&
+           (size == 0 || memcmp(got->data, want->data, size) == 0);
+}
+
+// ============================================================================
+// Checks
+// ============================================================================
+
+// peel_pool_enable(): decoding into recycled buffers changes nothing, and
+// the second decode is served from the free lists.
+static bool check_pool(const api_input_t *in, char *why, size_t why_size) {
+    peel_pool_enable(API_CACHE_BYTES);
+    bool ok = peel_again(in, why, why_size) && peel_again(in, why, why_size);
+    peel_pool_stats_t st;
+    peel_pool_stats(&st);
+    peel_pool_disable();
+    if (ok && in->ref->count > 0 && st.hits == 0) {
+        return failed(why, why_size, "no buffer was reused");
+    }
+    return ok;
+}
+
+// Read one fork of the file at path in vfs in small chunks and compare it
+// with want.
+static bool vfs_fork(peel_vfs_t *vfs, const char *path, peel_fork_t fork, const peel_buf_t *want,
+                     char *why, size_t why_size) {
+    peel_err_t *err = NULL;
+    peel_vfs_file_t *f = peel_vfs_open_file(vfs, path, fork, &err);
+    if (!f) {
+        bool ok = failed(why, why_size, "%s: %s", path, peel_err_msg(err));
+        peel_err_free(err);
+        return ok;
+    }
+    uint8_t chunk[API_READ_CHUNK];
+    uint64_t at = 0;
+    size_t n;
+    bool ok = true;
+    while (ok && (n = peel_vfs_pread(f, chunk, sizeof(chunk), at)) > 0) {
+        ok = at + n <= want->size && memcmp(chunk, want->data + at, n) == 0;
+        at += n;
+    }
+    peel_vfs_close_file(f);
+    if (!ok || at != want->size) {
+        return failed(why, why_size, "%s: %s fork differs", path,
+                      fork == PEEL_FORK_DATA ? "data" : "resource");
+    }
+    return true;
+}
+
+// Walk the directory at dir in vfs depth first, comparing each file with
+// the next one peel() returned.  A file that holds an archive is entered,
+// as peel() does.
+static bool vfs_walk(peel_vfs_t *vfs, const char *dir, const api_input_t *in, size_t *next,
+                     char *why, size_t why_size) {
+    peel_err_t *err = NULL;
+    peel_vfs_dirent_t de;
+    for (size_t i = 0; peel_vfs_readdir(vfs, dir, i, &de, &err); i++) {
+        char path[API_PATH_MAX];
+        if (snprintf(path, sizeof(path), "%s%s%s", dir, dir[0] ? "/" : "", de.name) >=
+            (int)sizeof(path)) {
+            return failed(why, why_size, "%s/%s: path too long", dir, de.name);
+        }
+        peel_vfs_dirent_t inner;
+        if (de.is_dir || peel_vfs_readdir(vfs, path, 0, &inner, &err)) {
+            if (!vfs_walk(vfs, path, in, next, why, why_size)) {
+                return false;
+            }
+            continue;
+        }
+        peel_err_free(err); // Not an archive: compare it as a file
+        err = NULL;
+        if (*next >= in->ref->count) {
+            return failed(why, why_size, "%s: not listed by peel()", path);
+        }
+        const peel_file_t *want = &in->ref->files[(*next)++];
+        peel_vfs_stat_t st;
+        if (!peel_vfs_stat(vfs, path, &st, &err)) {
+            bool ok = failed(why, why_size, "%s: %s", path, peel_err_msg(err));
+            peel_err_free(err);
+            return ok;
+        }
+        snprintf(st.meta.name, sizeof(st.meta.name), "%s", path); // peel() names the path
+        if (!same_meta(&st.meta, &want->meta) || st.data_size != want->data_fork.size ||
+            st.rsrc_size != want->resource_fork.size) {
+            return failed(why, why_size, "%s: stat differs from '%s'", path, want->meta.name);
+        }
+        if (!vfs_fork(vfs, path, PEEL_FORK_DATA, &want->data_fork, why, why_size) ||
+            !vfs_fork(vfs, path, PEEL_FORK_RESOURCE, &want->resource_fork, why, why_size)) {
+            return false;
+        }
+    }
+    if (err) {
+        bool ok = failed(why, why_size, "%s: %s", dir, peel_err_msg(err));
+        peel_err_free(err);
+        return ok;
+    }
+    return true;
+}
+
+// peel_vfs_open(): walking the tree and reading every fork gives the files
+// peel() returned, in the same order.  The cache is kept small, so forks
+// are evicted and decoded again along the way.
+static bool check_vfs(const api_input_t *in, char *why, size_t why_size) {
+    peel_err_t *err = NULL;
+    peel_buf_t archive = peel_buf_wrap(in->src, in->len);
+    peel_vfs_t *vfs = peel_vfs_open(&archive, API_READ_CHUNK, &err);
+    if (!vfs) {
+        bool ok = failed(why, why_size, "%s", peel_err_msg(err));
+        peel_err_free(err);
+        return ok;
+    }
+    size_t next = 0;
+    bool ok = vfs_walk(vfs, "", in, &next, why, why_size);
+    peel_vfs_close(vfs);
+    if (ok && next != in->ref->count) {
+        return failed(why, why_size, "%zu files, expected %zu", next, in->ref->count);
+    }
+    return ok;
+}
+
+// peel_dedupe_enable(): forks served from the cache match decoding them
+// afresh, both while resident and when read back from the spill directory
+// after a one-byte budget evicted them.
+static bool check_dedupe(const api_input_t *in, char *why, size_t why_size) {
+    peel_err_t *err = NULL;
+    peel_dedupe_stats_t st;
+    peel_dedupe_enable(API_CACHE_BYTES, NULL, &err);
+    bool ok = peel_again(in, why, why_size) && peel_again(in, why, why_size);
+    peel_dedupe_stats(&st);
+    peel_dedupe_disable();
+    if (ok && st.misses > 0 && st.hits == 0) {
+        return failed(why, why_size, "no fork was served from the cache");
+    }
+
+    char dir[] = "/tmp/peeler-api-XXXXXX";
+    if (!ok || !scratch_dir(dir, why, why_size)) {
+        return false;
+    }
+    if (!peel_dedupe_enable(1, dir, &err)) {
+        ok = failed(why, why_size, "%s", peel_err_msg(err));
+        peel_err_free(err);
+    } else {
+        ok = peel_again(in, why, why_size) && peel_again(in, why, why_size);
+        peel_dedupe_stats(&st);
+        peel_dedupe_disable();
+        if (ok && st.spills > 0 && st.spill_hits == 0) {
+            ok = failed(why, why_size, "no fork was read back from the spill directory");
+        }
+    }
+    scratch_remove(dir);
+    return ok;
+}
+
+// peel_cache_enable(): a result stored and loaded again, through the
+// built-in directory backend and through a caller's backend, matches
+// decoding afresh.
+static bool check_cache(const api_input_t *in, char *why, size_t why_size) {
+    peel_err_t *err = NULL;
+    char dir[] = "/tmp/peeler-api-XXXXXX";
+    if (!scratch_dir(dir, why, why_size)) {
+        return false;
+    }
+    bool ok;
+    if (!peel_cache_enable_dir(dir, &err)) {
+        ok = failed(why, why_size, "%s", peel_err_msg(err));
+        peel_err_free(err);
+    } else {
+        ok = cached_twice(in, why, why_size);
+    }
+    scratch_remove(dir);
+    if (!ok) {
+        return false;
+    }
+
+    api_memory_cache_t mc = {.key = ""};
+    peel_cache_backend_t backend = {.load = memory_load, .store = memory_store, .ctx = &mc};
+    peel_cache_enable(&backend);
+    ok = cached_twice(in, why, why_size);
+    peel_free(&mc.entry);
+    return ok;
+}
+
+// peel_pack() and peel_unpack_view(): a result packed into a sealed memfd
+// (mapped on unpacking) or a plain file (read into memory) comes back as
+// peel() returned it.
+static bool check_pack(const api_input_t *in, char *why, size_t why_size) {
+    peel_err_t *err = NULL;
+    int fd = peel_pack_memfd(in->ref, &err);
+    if (fd < 0) {
+        bool ok = failed(why, why_size, "%s", peel_err_msg(err));
+        peel_err_free(err);
+        return ok;
+    }
+    if (!unpacked(fd, in, why, why_size)) {
+        return false;
+    }
+
+    char path[] = "/tmp/peeler-api-XXXXXX";
+    fd = mkstemp(path);
+    if (fd < 0) {
+        return failed(why, why_size, "cannot create '%s'", path);
+    }
+    unlink(path);
+    if (!peel_pack(in->ref, fd, &err)) {
+        bool ok = failed(why, why_size, "%s", peel_err_msg(err));
+        peel_err_free(err);
+        close(fd);
+        return ok;
+    }
+    return unpacked(fd, in, why, why_size);
+}
+
+// peel_probe_chain(): peeling the reported wrappers one at a time finds the
+// same format at each layer with the declared size, and the innermost
+// layer is an archive that peels to what peel() returned.
+static bool check_probe(const api_input_t *in, char *why, size_t why_size) {
+    peel_chain_t chain;
+    if (peel_probe_chain(in->src, in->len, &chain) == 0) {
+        return failed(why, why_size, "no layer found");
+    }
+    peel_buf_t layer = peel_buf_wrap(in->src, in->len);
+    bool ok = true;
+    for (size_t i = 0; ok && i < chain.count; i++) {
+        const peel_layer_t *l = &chain.layers[i];
+        const char *format = peel_detect(layer.data, layer.size);
+        if (!format || strncmp(l->format, format, strlen(format)) != 0) {
+            ok = failed(why, why_size, "layer %zu is %s, probed as %s", i,
+                        format ? format : "unknown", l->format);
+        } else if (l->size != layer.size) {
+            ok = failed(why, why_size, "layer %zu holds %zu bytes, probed as %llu", i,
+                        layer.size, (unsigned long long)l->size);
+        } else if (i + 1 < chain.count) {
+            // A wrapper: its data fork is the next layer
+            peel_err_t *err = NULL;
+            peel_buf_t inner = {0};
+            if (strcmp(format, "hqx") == 0) {
+                inner = peel_hqx(layer.data, layer.size, &err);
+            } else if (strcmp(format, "bin") == 0) {
+                inner = peel_bin(layer.data, layer.size, &err);
+            }
+            if (err || !inner.data) {
+                ok = failed(why, why_size, "layer %zu (%s) did not peel: %s", i, format,
+                            err ? peel_err_msg(err) : "not a wrapper");
+            }
+            peel_err_free(err);
+            peel_free(&layer);
+            layer = inner;
+        }
+    }
+    if (ok) {
+        const char *last = chain.layers[chain.count - 1].format;
+        peel_err_t *err = NULL;
+        peel_file_list_t list = peel(layer.data, layer.size, &err);
+        if (strcmp(last, "hqx") == 0 || strcmp(last, "bin") == 0) {
+            ok = failed(why, why_size, "innermost layer is %s, not an archive", last);
+        } else {
+            ok = err ? failed(why, why_size, "%s", peel_err_msg(err))
+                     : same_list(&list, in->ref, why, why_size);
+        }
+        peel_err_free(err);
+        peel_file_list_free(&list);
+    }
+    peel_free(&layer);
+    return ok;
+}
+
+// peel_estimate(): the members predicted from the catalog are the files
+// peel() returned, with their exact decoded sizes, and the peak covers the
+// output.
+static bool check_estimate(const api_input_t *in, char *why, size_t why_size) {
+    peel_err_t *err = NULL;
+    peel_estimate_t est;
+    if (!peel_estimate(in->src, in->len, &est, &err)) {
+        bool ok = failed(why, why_size, "%s", peel_err_msg(err));
+        peel_err_free(err);
+        return ok;
+    }
+    bool ok = true;
+    uint64_t total = 0;
+    if (est.count != in->ref->count) {
+        ok = failed(why, why_size, "%zu members, expected %zu", est.count, in->ref->count);
+    }
+    for (size_t i = 0; ok && i < est.count; i++) {
+        const peel_entry_cost_t *e = &est.entries[i];
+        const peel_file_t *want = &in->ref->files[i];
+        uint64_t raw = (uint64_t)want->data_fork.size + want->resource_fork.size;
+        if (!same_meta(&e->meta, &want->meta) || e->raw_bytes != raw) {
+            ok = failed(why, why_size, "'%s' predicted as '%s', %llu bytes", want->meta.name,
+                        e->meta.name, (unsigned long long)e->raw_bytes);
+        }
+        total += raw;
+    }
+    if (ok && est.output_bytes != total) {
+        ok = failed(why, why_size, "%llu output bytes, expected %llu",
+                    (unsigned long long)est.output_bytes, (unsigned long long)total);
+    } else if (ok && est.peak_bytes < total) {
+        ok = failed(why, why_size, "peak of %llu bytes is below the output",
+                    (unsigned long long)est.peak_bytes);
+    }
+    peel_estimate_free(&est);
+    return ok;
+}
+
+// peel_prefix(): each fork comes back as the start of the fork peel()
+// returned, marked partial exactly when it was cut short.
+static bool check_prefix(const api_input_t *in, char *why, size_t why_size) {
+    bool ok = true;
+    for (size_t p = 0; ok && p < sizeof(api_prefixes) / sizeof(api_prefixes[0]); p++) {
+        size_t max = api_prefixes[p];
+        peel_err_t *err = NULL;
+        peel_file_list_t list = peel_prefix(in->src, in->len, max, &err);
+        if (err) {
+            ok = failed(why, why_size, "%s", peel_err_msg(err));
+        } else if (list.count != in->ref->count) {
+            ok = failed(why, why_size, "%zu files, expected %zu", list.count, in->ref->count);
+        }
+        for (size_t i = 0; ok && i < list.count; i++) {
+            const peel_file_t *got = &list.files[i], *want = &in->ref->files[i];
+            if (!same_meta(&got->meta, &want->meta) ||
+                !same_prefix(&got->data_fork, &want->data_fork, max) ||
+                !same_prefix(&got->resource_fork, &want->resource_fork, max)) {
+                ok = failed(why, why_size, "'%s' differs with a %zu-byte prefix", want->meta.name,
+                            max);
+            }
+        }
+        peel_err_free(err);
+        peel_file_list_free(&list);
+    }
+    return ok;
+}
+
+// Every check, in the order they run.
+static const struct {
+    const char *name;
+    api_check_fn fn;
+} api_checks[] = {
+    {"pool", check_pool},
+    {"vfs", check_vfs},
+    {"dedupe", check_dedupe},
+    {"cache", check_cache},
+    {"pack", check_pack},
+    {"probe", check_probe},
+    {"estimate", check_estimate},
+    {"prefix", check_prefix},
+};
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <input>...\n", argv[0]);
+        return 1;
+    }
+    size_t passed = 0, failures = 0;
+    for (int i = 1; i < argc; i++) {
+        peel_err_t *err = NULL;
+        peel_buf_t buf = peel_read_file(argv[i], &err);
+        peel_file_list_t ref = {0};
+        if (!err) {
+            ref = peel(buf.data, buf.size, &err);
+        }
+        if (err) {
+            printf("  FAIL: %s — %s\n", argv[i], peel_err_msg(err));
+            peel_err_free(err);
+            peel_free(&buf);
+            failures++;
+            continue;
+        }
+        api_input_t in = {.path = argv[i], .src = buf.data, .len = buf.size, .ref = &ref};
+        const char *leaf = strrchr(argv[i], '/');
+        leaf = leaf ? leaf + 1 : argv[i];
+        for (size_t c = 0; c < sizeof(api_checks) / sizeof(api_checks[0]); c++) {
+            char why[256] = "";
+            if (api_checks[c].fn(&in, why, sizeof(why))) {
+                printf("  PASS: %s [%s]\n", leaf, api_checks[c].name);
+                passed++;
+            } else {
+                printf("  FAIL: %s [%s] — %s\n", leaf, api_checks[c].name, why);
+                failures++;
+            }
+        }
+        peel_file_list_free(&ref);
+        peel_free(&buf);
+    }
+    printf("\n[api] %zu/%zu passed\n", passed, passed + failures);
+    return failures > 0;
+}
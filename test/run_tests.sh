@@ -9,7 +9,10 @@
 #   md5sums.txt  — expected checksums of extracted files
 #
 # The runner invokes the `peeler` CLI on the input, then validates the
-# output with md5sum -c.
+# output with md5sum -c.  Each case is then re-run in each of the CLI's
+# other modes listed in MODES, against the same md5sums.txt.
+# Each suite also runs once more as a single multi-input -j invocation,
+# and its inputs go through a `peeler watch` and a `peeler serve` process.
 #
 # Usage:
 #   ./run_tests.sh                       Run all tests with auto-detected defaults
@@ -145,6 +148,224 @@ done
 
 mkdir -p "$OUTPUT_DIR"
 
+# ============================================================================
+# Helpers
+# ============================================================================
+
+# Modes every test case is re-run in after the plain extraction
+MODES=(stdin tar xattr durable incremental verify manifest mapped)
+
+# Record the outcome of one check.  Uses the suite's passed/failed counters.
+pass() {
+    echo -e "${GREEN}  PASS: $1${NC}"
+    ((passed++))
+}
+
+fail() {
+    echo -e "${RED}  FAIL: $1 — $2${NC}"
+    ((failed++))
+    failed_tests+=("$1: $2")
+}
+
+# True if the tree in <dir> matches <md5sums.txt>.
+checksums_match() {
+    (cd "$1" && md5sum -c "$2" >/dev/null 2>&1)
+}
+
+# Paths listed in <md5sums.txt>, one per line, sorted.
+expected_files() {
+    grep -v '^#' "$1" | sed 's/^[0-9a-f]*  //; s|^\./||' | sort
+}
+
+# Every regular file under <dir>, one per line, sorted.
+actual_files() {
+    (cd "$1" && find . -type f -printf '%P\n' | sort)
+}
+
+# Inode and mtime of every output file under <dir>, to spot rewrites.
+snapshot() {
+    (cd "$1" && find . -type f ! -name .peeler-manifest -printf '%P\t%i %T@\n' | sort)
+}
+
+# True if <file> carries extended attribute <name>.  Passes when neither
+# getfattr nor python3 is around to read it.
+has_xattr() {
+    if command -v getfattr >/dev/null; then
+        getfattr --only-values -n "$2" "$1" >/dev/null 2>&1
+    elif command -v python3 >/dev/null; then
+        python3 -c 'import os, sys; os.getxattr(sys.argv[1], sys.argv[2])' "$1" "$2" 2>/dev/null
+    else
+        return 0
+    fi
+}
+
+# True once the tree in <dir> matches <md5sums.txt>, waiting up to 30 s.
+appears() {
+    local i
+    for ((i = 0; i < 150; i++)); do
+        checksums_match "$1" "$2" 2>/dev/null && return 0
+        sleep 0.2
+    done
+    return 1
+}
+
+# Ask the server on <socket> to list <input>, get every data fork in
+# <md5sums.txt>, extract into <out> and verify, over one connection while
+# another sits idle.  Prints the reason and returns 1 on failure.
+serve_check() {
+    python3 - "$@" <<'EOF' || return 1
+import hashlib, socket, sys
+sock, archive, sums, out = sys.argv[1:5]
+expect = {}
+for line in open(sums):
+    if line.strip() and not line.startswith('#'):
+        md5, path = line.rstrip('\n').split('  ', 1)
+        expect[path[2:] if path.startswith('./') else path] = md5
+idle = socket.socket(socket.AF_UNIX)
+idle.connect(sock)  # Must not keep the request below waiting
+s = socket.socket(socket.AF_UNIX)
+s.connect(sock)
+s.settimeout(60)
+f = s.makefile('rb')
+def ask(*fields):
+    s.sendall('\t'.join(fields).encode() + b'\n')
+    status, n = f.readline().decode().rstrip('\n').split('\t')
+    if status != 'ok':
+        sys.exit(fields[0] + ' failed')
+    return int(n)
+def lines(n):
+    return [f.readline().decode().rstrip('\n') for _ in range(n)]
+try:
+    listed = {e.split('\t', 3)[3] for e in lines(ask('list', archive)) if e.startswith('file\t')}
+    for path, md5 in expect.items():
+        if path.split('/')[-1].startswith('._'):
+            continue
+        if path not in listed:
+            sys.exit("'%s' not listed" % path)
+        if hashlib.md5(f.read(ask('get', archive, path))).hexdigest() != md5:
+            sys.exit("get of '%s' returned the wrong bytes" % path)
+    lines(ask('extract', archive, out))
+    lines(ask('verify', archive))
+except OSError as e:
+    sys.exit('no answer: %s' % (e.strerror or 'timed out'))
+EOF
+    checksums_match "$4" "$3" || { echo "extract: checksum mismatch"; return 1; }
+}
+
+# Run <input> in <mode> into <out>, checking it against <md5sums.txt>.
+# Prints the reason and returns 1 on failure.
+check_mode() {
+    local mode=$1 input=$2 sums=$3 out=$4
+    local output
+    case $mode in
+        stdin)
+            output=$("$PEELER" -o "$out" - <"$input" 2>&1) ||
+                { echo "peeler exited with error"; return 1; }
+            ;;
+        tar)
+            output=$("$PEELER" --tar - "$input" 2>/dev/null | tar -x -C "$out" 2>&1) ||
+                { echo "tar stream did not extract"; return 1; }
+            ;;
+        xattr)
+            output=$("$PEELER" --xattr -o "$out" "$input" 2>&1) ||
+                { echo "peeler exited with error"; return 1; }
+            # Sidecars are replaced by attributes on the data file, unless
+            # the filesystem refused them
+            local f
+            while IFS= read -r f; do
+                local leaf=${f##*/}
+                if [[ $leaf != ._* ]]; then
+                    [[ -f "$out/$f" ]] || { echo "'$f' missing"; return 1; }
+                elif [[ ! -f "$out/$f" ]]; then
+                    local data=${f%"$leaf"}${leaf#._}
+                    has_xattr "$out/$data" user.com.apple.FinderInfo ||
+                        { echo "'$data' has neither sidecar nor Finder info"; return 1; }
+                fi
+            done < <(expected_files "$sums")
+            (cd "$out" && md5sum -c --ignore-missing "$sums" >/dev/null 2>&1) ||
+                { echo "checksum mismatch"; return 1; }
+            return 0
+            ;;
+        durable)
+            output=$("$PEELER" --durable -o "$out" "$input" 2>&1) ||
+                { echo "peeler exited with error"; return 1; }
+            # Every staged file was published; sidecars may be unlisted
+            [[ -z $(comm -13 <(expected_files "$sums") <(actual_files "$out") |
+                    grep -v '\(^\|/\)\._') ]] ||
+                { echo "stray files left behind"; return 1; }
+            # A directory blocked by a plain file fails its members, and
+            # then nothing else of the input may be published either
+            local top blocked left
+            top=$(expected_files "$sums" | grep -m1 / | cut -d/ -f1)
+            if [[ -n $top ]]; then
+                blocked="$out.blocked"
+                mkdir -p "$blocked"
+                : >"$blocked/$top"
+                "$PEELER" --durable -o "$blocked" "$input" >/dev/null 2>&1 &&
+                    { echo "blocked '$top' was not reported"; rm -rf "$blocked"; return 1; }
+                left=$(actual_files "$blocked")
+                rm -rf "$blocked"
+                [[ $left == "$top" ]] ||
+                    { echo "files published despite a failed write"; return 1; }
+            fi
+            ;;
+        incremental)
+            "$PEELER" --incremental -o "$out" "$input" >/dev/null 2>&1 ||
+                { echo "first run failed"; return 1; }
+            # Remove one output; the second run must restore it and rewrite
+            # nothing else except members no stored checksum covers
+            local before removed
+            before=$(snapshot "$out")
+            removed=$(expected_files "$sums" | grep -v '\(^\|/\)\._' | head -1)
+            rm -f "$out/$removed"
+            "$PEELER" --incremental -o "$out" "$input" >/dev/null 2>&1 ||
+                { echo "second run failed"; return 1; }
+            checksums_match "$out" "$sums" || { echo "checksum mismatch"; return 1; }
+            local unchecked rewritten expect
+            unchecked=$("$PEELER" --verify "$input" | sed -n 's/^unchecked *//p')
+            rewritten=$(diff <(echo "$before") <(snapshot "$out") | sed -n 's/^> //p' |
+                cut -f1 | grep -vc '\(^\|/\)\._')
+            expect=$(grep -c . <<<"$unchecked")
+            grep -qxF "${removed##*/}" <<<"$unchecked" || ((expect++))
+            [[ $rewritten -eq $expect ]] ||
+                { echo "second run rewrote $rewritten file(s), expected $expect"; return 1; }
+            return 0
+            ;;
+        verify)
+            output=$("$PEELER" --verify "$input" 2>&1) ||
+                { echo "verify reported a failure"; return 1; }
+            [[ $(tail -1 <<<"$output") == *" checked, 0 failed" ]] ||
+                { echo "unexpected summary"; return 1; }
+            "$PEELER" --verify "$sums" >/dev/null 2>&1 &&
+                { echo "verify accepted md5sums.txt"; return 1; }
+            return 0
+            ;;
+        manifest)
+            output=$("$PEELER" --manifest=json -o "$out" "$input" 2>/dev/null) ||
+                { echo "peeler exited with error"; return 1; }
+            [[ ${output:0:1} == "[" && ${output: -1} == "]" ]] ||
+                { echo "manifest is not a JSON array"; return 1; }
+            local paths members p
+            paths=$(grep -o '"path": "[^"]*"' <<<"$output" | sed 's/^"path": "//; s/"$//')
+            members=$(expected_files "$sums" | grep -vc '\(^\|/\)\._')
+            [[ $(grep -c . <<<"$paths") -eq $members ]] ||
+                { echo "manifest does not list $members members"; return 1; }
+            while IFS= read -r p; do
+                [[ -f "$p" ]] || { echo "manifest path '$p' missing"; return 1; }
+            done <<<"$paths"
+            ;;
+        mapped)
+            # Every data fork is decoded straight into its output file
+            output=$(PEELER_MAP_MIN=1 "$PEELER" -o "$out" "$input" 2>&1) ||
+                { echo "peeler exited with error"; return 1; }
+            [[ -z $(comm -13 <(expected_files "$sums") <(actual_files "$out") |
+                    grep -v '\(^\|/\)\._') ]] ||
+                { echo "stray files left behind"; return 1; }
+            ;;
+    esac
+    checksums_match "$out" "$sums" || { echo "checksum mismatch"; return 1; }
+}
+
 # ============================================================================
 # Run all test suites
 # ============================================================================
@@ -208,6 +429,7 @@ echo "[$suite_label] Running ${#test_cases[@]} test(s)..."
 passed=0
 failed=0
 declare -a failed_tests=()
+declare -a inputs=() sums=()
 
 for name in "${test_cases[@]}"; do
     test_src="$TEST_DIR/$name"
@@ -271,8 +493,158 @@ for name in "${test_cases[@]}"; do
     if ! $KEEP_FILES; then
         rm -rf "$test_out"
     fi
+
+    inputs+=("$input_file")
+    sums+=("$test_src/md5sums.txt")
+
+    # The same case through the CLI's other modes
+    for mode in "${MODES[@]}"; do
+        mode_out="$OUTPUT_DIR/$name.$mode"
+        rm -rf "$mode_out"
+        mkdir -p "$mode_out"
+        if reason=$(check_mode "$mode" "$input_file" "$test_src/md5sums.txt" "$mode_out"); then
+            pass "$name [$mode]"
+        else
+            fail "$name [$mode]" "$reason"
+        fi
+        if ! $KEEP_FILES; then
+            rm -rf "$mode_out"
+        fi
+    done
 done
 
+# ============================================================================
+# Multiple Inputs
+# ============================================================================
+
+# Every case in one invocation with parallel jobs; each input extracts into
+# a directory named after it (a lone input straight into the output dir)
+if [[ ${#inputs[@]} -gt 0 ]]; then
+    multi_out="$OUTPUT_DIR/$suite_label.multi"
+    rm -rf "$multi_out"
+    if ! output=$("$PEELER" -j 4 -o "$multi_out" "${inputs[@]}" 2>&1); then
+        fail "$suite_label [-j 4]" "peeler exited with error"
+        $VERBOSE && echo "$output"
+    else
+        bad=""
+        for i in "${!inputs[@]}"; do
+            dir="$multi_out/$(basename "${inputs[$i]}")"
+            [[ ${#inputs[@]} -eq 1 ]] && dir="$multi_out"
+            checksums_match "$dir" "${sums[$i]}" || bad="$(basename "${inputs[$i]}")"
+        done
+        if [[ -z "$bad" ]]; then
+            pass "$suite_label [-j 4]"
+        else
+            fail "$suite_label [-j 4]" "checksum mismatch in $bad"
+        fi
+    fi
+    if ! $KEEP_FILES; then
+        rm -rf "$multi_out"
+    fi
+fi
+
+# Two inputs that share a name must not share an output directory
+if [[ ${#inputs[@]} -gt 1 ]]; then
+    dup_src="$OUTPUT_DIR/$suite_label.same-src"
+    dup_out="$OUTPUT_DIR/$suite_label.same"
+    rm -rf "$dup_src" "$dup_out"
+    mkdir -p "$dup_src/a" "$dup_src/b"
+    ln -s "${inputs[0]}" "$dup_src/a/archive"
+    ln -s "${inputs[1]}" "$dup_src/b/archive"
+    if ! "$PEELER" -o "$dup_out" "$dup_src/a/archive" "$dup_src/b/archive" >/dev/null 2>&1; then
+        fail "$suite_label [same name]" "peeler exited with error"
+    elif checksums_match "$dup_out/archive" "${sums[0]}" &&
+         checksums_match "$dup_out/archive-2" "${sums[1]}"; then
+        pass "$suite_label [same name]"
+    else
+        fail "$suite_label [same name]" "checksum mismatch"
+    fi
+    if ! $KEEP_FILES; then
+        rm -rf "$dup_src" "$dup_out"
+    fi
+fi
+
+# ============================================================================
+# Daemons
+# ============================================================================
+
+# peeler watch: the first input is there at startup, the rest are dropped
+# in once it is out, one written in place and the others renamed in from a
+# hidden name
+if [[ ${#inputs[@]} -gt 0 ]]; then
+    watch_in="$OUTPUT_DIR/$suite_label.watch-in"
+    watch_out="$OUTPUT_DIR/$suite_label.watch-out"
+    rm -rf "$watch_in" "$watch_out"
+    mkdir -p "$watch_in" "$watch_out"
+    cp "${inputs[0]}" "$watch_in/"
+    "$PEELER" watch -j 2 "$watch_in" "$watch_out" >/dev/null 2>&1 &
+    watch_pid=$!
+    bad=""
+    if appears "$watch_out/$(basename "${inputs[0]}")" "${sums[0]}"; then
+        for i in "${!inputs[@]}"; do
+            [[ $i -eq 0 ]] && continue
+            leaf=$(basename "${inputs[$i]}")
+            if [[ $i -eq 1 ]]; then
+                cp "${inputs[$i]}" "$watch_in/"
+            else
+                cp "${inputs[$i]}" "$watch_in/.$leaf" && mv "$watch_in/.$leaf" "$watch_in/$leaf"
+            fi
+        done
+        for i in "${!inputs[@]}"; do
+            leaf=$(basename "${inputs[$i]}")
+            appears "$watch_out/$leaf" "${sums[$i]}" || { bad=$leaf; break; }
+        done
+    else
+        bad=$(basename "${inputs[0]}")
+    fi
+    kill -TERM "$watch_pid" 2>/dev/null
+    if ! wait "$watch_pid"; then
+        fail "$suite_label [watch]" "peeler watch did not exit cleanly"
+    elif [[ -n "$bad" ]]; then
+        fail "$suite_label [watch]" "'$bad' was not extracted"
+    else
+        pass "$suite_label [watch]"
+    fi
+    if ! $KEEP_FILES; then
+        rm -rf "$watch_in" "$watch_out"
+    fi
+fi
+
+# peeler serve: a round trip per input against one server with one worker
+if [[ ${#inputs[@]} -gt 0 ]] && ! command -v python3 >/dev/null; then
+    echo -e "${YELLOW}  SKIP: $suite_label [serve] — needs python3${NC}"
+elif [[ ${#inputs[@]} -gt 0 ]]; then
+    serve_sock="$OUTPUT_DIR/$suite_label.sock"
+    serve_out="$OUTPUT_DIR/$suite_label.serve"
+    rm -rf "$serve_sock" "$serve_out"
+    "$PEELER" serve -j 1 "$serve_sock" >/dev/null 2>&1 &
+    serve_pid=$!
+    for ((i = 0; i < 50; i++)); do
+        [[ -S "$serve_sock" ]] && break
+        sleep 0.1
+    done
+    reason=""
+    for i in "${!inputs[@]}"; do
+        dir="$serve_out/$(basename "${inputs[$i]}")"
+        mkdir -p "$dir"
+        if ! why=$(serve_check "$serve_sock" "${inputs[$i]}" "${sums[$i]}" "$dir" 2>&1); then
+            reason="$(basename "${inputs[$i]}"): $why"
+            break
+        fi
+    done
+    kill -TERM "$serve_pid" 2>/dev/null
+    if ! wait "$serve_pid"; then
+        fail "$suite_label [serve]" "peeler serve did not exit cleanly"
+    elif [[ -n "$reason" ]]; then
+        fail "$suite_label [serve]" "$reason"
+    else
+        pass "$suite_label [serve]"
+    fi
+    if ! $KEEP_FILES; then
+        rm -rf "$serve_out"
+    fi
+fi
+
 # ============================================================================
 # Suite Summary
 # ============================================================================